@@ -6,36 +6,329 @@
 #include <string>
 #include "rotateBST.h"
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include "thread_pool.h"
+#include "frozen_avlbst.h"
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+/**
+* Augments add data to every AVLNode that summarizes the node's subtree. The node inherits from its
+* augment, and the tree calls pull() on a node whenever its children change, right after its height is
+* recomputed, so pull() may rely on the children being up to date already.
+*/
+
+/**
+* The default augment, which adds nothing.
+*/
+struct NoAugment
+{
+    template<typename NodeType>
+    void pull(const NodeType&) {}
+};
+
+/**
+* Keeps the number of nodes in each subtree, for select(), rank() and O(log n) iterator arithmetic.
+*/
+class SubtreeSize
+{
+public:
+    SubtreeSize();
+
+    std::size_t getSize() const;
+    template<typename NodeType>
+    void pull(const NodeType& node);
+
+protected:
+    std::size_t mSize;
+};
+
+/**
+* Keeps an aggregate of every subtree under a monoid, for O(log n) range aggregates through
+* AVLTree::aggregate(). A Monoid provides value_type, identity(), lift(key, value), which turns one
+* item into an aggregate, and an associative combine(a, b). combine() is always given its arguments in key
+* order, so it does not need to be commutative. Base is another augment to keep alongside, e.g. SubtreeSize.
+* Values changed in place through an iterator are not seen by the aggregates, use insert() to update them.
+*/
+template <typename Monoid, typename Base = NoAugment>
+class MonoidAugment : public Base
+{
+public:
+    typedef Monoid MonoidType;
+    typedef typename Monoid::value_type AggregateType;
+
+    const AggregateType& getAggregate() const;
+    template<typename NodeType>
+    void pull(const NodeType& node);
+
+protected:
+    AggregateType mAggregate;
+};
+
+/**
+* Monoids over the values of a tree, for use with MonoidAugment.
+*/
+template <typename T>
+struct SumOfValues
+{
+    typedef T value_type;
+    static T identity() {return T();}
+    template<typename Key, typename Value>
+    static T lift(const Key&, const Value& value) {return T(value);}
+    static T combine(const T& a, const T& b) {return a + b;}
+};
+
+template <typename T>
+struct MinOfValues
+{
+    typedef T value_type;
+    static T identity() {return std::numeric_limits<T>::max();}
+    template<typename Key, typename Value>
+    static T lift(const Key&, const Value& value) {return T(value);}
+    static T combine(const T& a, const T& b) {return b < a ? b : a;}
+};
+
+template <typename T>
+struct MaxOfValues
+{
+    typedef T value_type;
+    static T identity() {return std::numeric_limits<T>::lowest();}
+    template<typename Key, typename Value>
+    static T lift(const Key&, const Value& value) {return T(value);}
+    static T combine(const T& a, const T& b) {return a < b ? b : a;}
+};
+
+/**
+* Threads the nodes together in key order, each holding its in-order successor and predecessor, so that
+* iterators step with one load instead of climbing parent links. AVLTree keeps the links up to date as
+* nodes come and go. They do not depend on the shape of the tree, so rotations never touch them and
+* pull() has nothing to do for them. Base is another augment to keep alongside, e.g. SubtreeSize.
+*/
+template <typename Base = NoAugment>
+class ThreadedLinks : public Base
+{
+public:
+    ThreadedLinks();
+
+    ThreadedLinks* getNextLink() const;
+    ThreadedLinks* getPrevLink() const;
+    void setNextLink(ThreadedLinks* next);
+    void setPrevLink(ThreadedLinks* prev);
+
+protected:
+    ThreadedLinks* mNext;
+    ThreadedLinks* mPrev;
+};
 
 /**
 * A special kind of node for an AVL tree, which adds the height as a data member, plus 
 * other additional helper functions. You do NOT need to implement any functionality or
 * add additional data members or helper functions.
 */
-template <typename Key, typename Value>
-class AVLNode : public Node<Key, Value>
+template <typename Key, typename Value, typename Augment = NoAugment>
+class AVLNode : public BasicNode<Key, Value, AVLNode<Key, Value, Augment> >, public Augment
 {
 public:
+    typedef Augment AugmentType;
+
 	// Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Augment>* parent);
+    template<typename... Args>
+    AVLNode(std::in_place_t, AVLNode<Key, Value, Augment>* parent, Args&&... args);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int getHeight() const;
     void setHeight(int height);
 
-    // Getters for parent, left, and right. These need to be redefined since they 
-    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
-    // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    // Recomputes the augment from the children.
+    void pull();
+
+    // The getters for parent, left, and right come from BasicNode and already
+    // return AVLNodes. See the BasicNode class in bst.h for more information.
+
+protected:
+    // Heights of AVL trees stay far below 127 for any number of nodes that fits in memory.
+    signed char mHeight;
+
+};
+
+/**
+* A compact AVL node for small keys and values. The parent and children are 32-bit indices into the
+* process-wide NodePool for this node type and the height is a single byte, so an IndexedAVLNode<int, int>
+* takes 24 bytes where an AVLNode<int, int> takes 40. These nodes have to be allocated with
+* NodePoolAllocator, which the IndexedAVLTree alias below takes care of.
+*/
+template <typename Key, typename Value>
+class IndexedAVLNode
+{
+public:
+    IndexedAVLNode(const Key& key, const Value& value, IndexedAVLNode<Key, Value>* parent);
+    template<typename... Args>
+    IndexedAVLNode(std::in_place_t, IndexedAVLNode<Key, Value>* parent, Args&&... args);
+
+    const std::pair<Key, Value>& getItem() const;
+    std::pair<Key, Value>& getItem();
+    const Key& getKey() const;
+    const Value& getValue() const;
+    Key& getKey();
+    Value& getValue();
+    void setValue(const Value &value);
+
+    // Getters/setters for parent, left, and right translate between pool indices and pointers.
+    IndexedAVLNode<Key, Value>* getParent() const;
+    IndexedAVLNode<Key, Value>* getLeft() const;
+    IndexedAVLNode<Key, Value>* getRight() const;
+    void setParent(IndexedAVLNode<Key, Value>* parent);
+    void setLeft(IndexedAVLNode<Key, Value>* left);
+    void setRight(IndexedAVLNode<Key, Value>* right);
+
+    int getHeight() const;
+    void setHeight(int height);
+
+    typedef NoAugment AugmentType;
+    void pull();
 
 protected:
-    int mHeight;
+    typedef NodePool<IndexedAVLNode<Key, Value> > Pool;
 
+    std::pair<Key, Value> mItem;
+    std::uint32_t mParent;
+    std::uint32_t mLeft;
+    std::uint32_t mRight;
+    signed char mHeight;
 };
 
+/*
+------------------------------------------------
+Begin implementations for the SubtreeSize class.
+------------------------------------------------
+*/
+
+/**
+* A new node is a leaf, so its subtree is just itself.
+*/
+inline SubtreeSize::SubtreeSize()
+    : mSize(1)
+{
+
+}
+
+inline std::size_t SubtreeSize::getSize() const
+{
+    return mSize;
+}
+
+template<typename NodeType>
+void SubtreeSize::pull(const NodeType& node)
+{
+    mSize = 1;
+    if(node.getLeft() != NULL)
+    {
+        mSize += node.getLeft()->getSize();
+    }
+    if(node.getRight() != NULL)
+    {
+        mSize += node.getRight()->getSize();
+    }
+}
+
+/*
+----------------------------------------------
+End implementations for the SubtreeSize class.
+----------------------------------------------
+*/
+
+/*
+--------------------------------------------------
+Begin implementations for the MonoidAugment class.
+--------------------------------------------------
+*/
+
+template<typename Monoid, typename Base>
+const typename MonoidAugment<Monoid, Base>::AggregateType& MonoidAugment<Monoid, Base>::getAggregate() const
+{
+    return mAggregate;
+}
+
+/**
+* Combines the left aggregate, the node's own item and the right aggregate, in that order.
+*/
+template<typename Monoid, typename Base>
+template<typename NodeType>
+void MonoidAugment<Monoid, Base>::pull(const NodeType& node)
+{
+    Base::pull(node);
+    mAggregate = Monoid::lift(node.getKey(), node.getValue());
+    if(node.getLeft() != NULL)
+    {
+        mAggregate = Monoid::combine(node.getLeft()->getAggregate(), mAggregate);
+    }
+    if(node.getRight() != NULL)
+    {
+        mAggregate = Monoid::combine(mAggregate, node.getRight()->getAggregate());
+    }
+}
+
+/*
+------------------------------------------------
+End implementations for the MonoidAugment class.
+------------------------------------------------
+*/
+
+/*
+--------------------------------------------------
+Begin implementations for the ThreadedLinks class.
+--------------------------------------------------
+*/
+
+/**
+* A new node is not linked to anything until the tree threads it in.
+*/
+template<typename Base>
+ThreadedLinks<Base>::ThreadedLinks()
+    : mNext(NULL)
+    , mPrev(NULL)
+{
+
+}
+
+template<typename Base>
+ThreadedLinks<Base>* ThreadedLinks<Base>::getNextLink() const
+{
+    return mNext;
+}
+
+template<typename Base>
+ThreadedLinks<Base>* ThreadedLinks<Base>::getPrevLink() const
+{
+    return mPrev;
+}
+
+template<typename Base>
+void ThreadedLinks<Base>::setNextLink(ThreadedLinks* next)
+{
+    mNext = next;
+}
+
+template<typename Base>
+void ThreadedLinks<Base>::setPrevLink(ThreadedLinks* prev)
+{
+    mPrev = prev;
+}
+
+/*
+------------------------------------------------
+End implementations for the ThreadedLinks class.
+------------------------------------------------
+*/
+
 /*
 --------------------------------------------
 Begin implementations for the AVLNode class.
@@ -45,9 +338,21 @@ Begin implementations for the AVLNode class.
 /**
 * Constructor for an AVLNode. Nodes are initialized with a height of 0.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
-    : Node<Key, Value>(key, value, parent)
+template<typename Key, typename Value, typename Augment>
+AVLNode<Key, Value, Augment>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Augment>* parent)
+    : BasicNode<Key, Value, AVLNode<Key, Value, Augment> >(key, value, parent)
+    , mHeight(0)
+{
+
+}
+
+/**
+* Constructor for an AVLNode whose item is built in place from args, see BasicNode.
+*/
+template<typename Key, typename Value, typename Augment>
+template<typename... Args>
+AVLNode<Key, Value, Augment>::AVLNode(std::in_place_t, AVLNode<Key, Value, Augment>* parent, Args&&... args)
+    : BasicNode<Key, Value, AVLNode<Key, Value, Augment> >(std::in_place, parent, std::forward<Args>(args)...)
     , mHeight(0)
 {
 
@@ -56,641 +361,1741 @@ AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Va
 /**
 * Destructor.
 */
+template<typename Key, typename Value, typename Augment>
+AVLNode<Key, Value, Augment>::~AVLNode()
+{
+
+}
+
+/**
+* Getter function for the height. 
+*/
+template<typename Key, typename Value, typename Augment>
+int AVLNode<Key, Value, Augment>::getHeight() const
+{
+    return mHeight;
+}
+
+/**
+* Setter function for the height. 
+*/
+template<typename Key, typename Value, typename Augment>
+void AVLNode<Key, Value, Augment>::setHeight(int height)
+{
+    mHeight = (signed char)height;
+}
+
+template<typename Key, typename Value, typename Augment>
+void AVLNode<Key, Value, Augment>::pull()
+{
+    Augment::pull(*this);
+}
+
+/*
+------------------------------------------
+End implementations for the AVLNode class.
+------------------------------------------
+*/
+
+/*
+---------------------------------------------------
+Begin implementations for the IndexedAVLNode class.
+---------------------------------------------------
+*/
+
+/**
+* Constructor for an IndexedAVLNode. Nodes are initialized with a height of 0.
+*/
+template<typename Key, typename Value>
+IndexedAVLNode<Key, Value>::IndexedAVLNode(const Key& key, const Value& value, IndexedAVLNode<Key, Value>* parent)
+    : mItem(key, value)
+    , mParent(Pool::indexOf(parent))
+    , mLeft(0)
+    , mRight(0)
+    , mHeight(0)
+{
+
+}
+
+template<typename Key, typename Value>
+template<typename... Args>
+IndexedAVLNode<Key, Value>::IndexedAVLNode(std::in_place_t, IndexedAVLNode<Key, Value>* parent, Args&&... args)
+    : mItem(std::forward<Args>(args)...)
+    , mParent(Pool::indexOf(parent))
+    , mLeft(0)
+    , mRight(0)
+    , mHeight(0)
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<Key, Value>& IndexedAVLNode<Key, Value>::getItem() const
+{
+    return mItem;
+}
+
+template<typename Key, typename Value>
+std::pair<Key, Value>& IndexedAVLNode<Key, Value>::getItem()
+{
+    return mItem;
+}
+
+template<typename Key, typename Value>
+const Key& IndexedAVLNode<Key, Value>::getKey() const
+{
+    return mItem.first;
+}
+
+template<typename Key, typename Value>
+const Value& IndexedAVLNode<Key, Value>::getValue() const
+{
+    return mItem.second;
+}
+
+template<typename Key, typename Value>
+Key& IndexedAVLNode<Key, Value>::getKey()
+{
+    return mItem.first;
+}
+
+template<typename Key, typename Value>
+Value& IndexedAVLNode<Key, Value>::getValue()
+{
+    return mItem.second;
+}
+
+template<typename Key, typename Value>
+void IndexedAVLNode<Key, Value>::setValue(const Value& value)
+{
+    mItem.second = value;
+}
+
+template<typename Key, typename Value>
+IndexedAVLNode<Key, Value>* IndexedAVLNode<Key, Value>::getParent() const
+{
+    return Pool::pointerTo(mParent);
+}
+
+template<typename Key, typename Value>
+IndexedAVLNode<Key, Value>* IndexedAVLNode<Key, Value>::getLeft() const
+{
+    return Pool::pointerTo(mLeft);
+}
+
+template<typename Key, typename Value>
+IndexedAVLNode<Key, Value>* IndexedAVLNode<Key, Value>::getRight() const
+{
+    return Pool::pointerTo(mRight);
+}
+
+template<typename Key, typename Value>
+void IndexedAVLNode<Key, Value>::setParent(IndexedAVLNode<Key, Value>* parent)
+{
+    mParent = Pool::indexOf(parent);
+}
+
+template<typename Key, typename Value>
+void IndexedAVLNode<Key, Value>::setLeft(IndexedAVLNode<Key, Value>* left)
+{
+    mLeft = Pool::indexOf(left);
+}
+
+template<typename Key, typename Value>
+void IndexedAVLNode<Key, Value>::setRight(IndexedAVLNode<Key, Value>* right)
+{
+    mRight = Pool::indexOf(right);
+}
+
+template<typename Key, typename Value>
+int IndexedAVLNode<Key, Value>::getHeight() const
+{
+    return mHeight;
+}
+
+template<typename Key, typename Value>
+void IndexedAVLNode<Key, Value>::setHeight(int height)
+{
+    mHeight = (signed char)height;
+}
+
+/**
+* Compact nodes carry no augment.
+*/
 template<typename Key, typename Value>
-AVLNode<Key, Value>::~AVLNode()
+void IndexedAVLNode<Key, Value>::pull()
+{
+}
+
+/*
+-------------------------------------------------
+End implementations for the IndexedAVLNode class.
+-------------------------------------------------
+*/
+
+/**
+* A templated balanced binary search tree implemented as an AVL tree. NodeType selects the node layout,
+* either the pointer based AVLNode or the compact IndexedAVLNode. Compare orders the keys, see
+* BinarySearchTree.
+*/
+template <class Key, class Value, class Alloc = SlabNodeAllocator, class NodeType = AVLNode<Key, Value>, class Compare = std::less<Key> >
+class AVLTree : public rotateBST<Key, Value, Alloc, NodeType, Compare>
 {
+public:
+    AVLTree();
+    explicit AVLTree(const Compare& compare);
+    template<typename Iterator>
+    AVLTree(Iterator first, Iterator last, bool checkSorted = false);
 
+	// Methods for inserting/removing elements from the tree. You must implement
+	// both of these methods. 
+    virtual void insert(const std::pair<Key, Value>& keyValuePair) override;
+    // The rvalue insert, emplace, try_emplace and insert_or_assign, see BinarySearchTree.
+    using rotateBST<Key, Value, Alloc, NodeType, Compare>::insert;
+    void remove(const Key& key);
+    // Heterogeneous remove for a transparent Compare, see BinarySearchTree::find.
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    void remove(const K& key);
+
+    // Linear time bulk load from a sorted range, see BinarySearchTree::assign_sorted.
+    template<typename Iterator>
+    void assign_sorted(Iterator first, Iterator last, bool checkSorted = false);
+
+    // Read only copy in a cache friendly, pointer free layout, see FrozenAVLTree.
+    FrozenAVLTree<Key, Value, Compare> freeze() const;
+
+    // Inserts a batch of key value pairs in any order. A later pair wins over an earlier one with the same key.
+    void insert_batch(const std::pair<Key, Value>* items, std::size_t count);
+#if __cplusplus >= 202002L
+    void insert_batch(std::span<const std::pair<Key, Value> > items) {insert_batch(items.data(), items.size());}
+#endif
+
+    // One insert or remove of a mixed batch. changed is set by apply_batch to whether an insert added a
+    // new key or a remove found its key.
+    struct Update
+    {
+        std::pair<Key, Value> item;
+        bool remove;
+        bool changed;
+    };
+    // Applies updates that are already sorted by key, in that order, each descent starting from the
+    // previous key's position instead of the root.
+    void apply_batch(Update* const* updates, std::size_t count);
+
+    /**
+    * A remembered position in the tree, for runs of operations on keys close to each other such as a
+    * sliding window. A move climbs from the current node to the lowest ancestor whose subtree can hold
+    * the new key and descends from there, instead of descending from the root. That is O(log d) steps
+    * for a key d positions away, except where the two keys sit on either side of a high ancestor, which
+    * costs up to the height, as stepping an iterator there does. Like an iterator, a finger stays valid
+    * through inserts and removes of other keys, but not through the removal of its own node or anything
+    * that rebuilds the tree.
+    */
+    class Finger
+    {
+    public:
+        // Moves to key and returns whether it is in the tree. If it is not, the finger stops on a
+        // neighbour of where key would go.
+        bool seek(const Key& key);
+        // The item under the finger, end() in an empty tree.
+        typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator position() const;
+        // insert and remove, starting from the finger. insert leaves the finger on the key, remove on
+        // a neighbour of the removed key.
+        std::pair<typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> insert(const std::pair<Key, Value>& keyValuePair);
+        bool remove(const Key& key);
+
+    private:
+        friend class AVLTree<Key, Value, Alloc, NodeType, Compare>;
+        Finger(AVLTree* tree, NodeType* node);
+
+        AVLTree* mTree;
+        NodeType* mNode;
+    };
+    // A finger on the root.
+    Finger finger();
+
+    // Joins left, the middle pair and right into this tree. Every key in left has to be smaller than the
+    // middle key and every key in right larger. left and right are left empty.
+    void join(AVLTree& left, const std::pair<Key, Value>& middle, AVLTree& right);
+    // Moves every key greater than key into greater and drops key itself. Returns whether key was present.
+    bool split(const Key& key, AVLTree& greater);
+
+    // Set operations against another tree, which is not modified. Keys in both trees keep this tree's value.
+    void union_with(const AVLTree& other);
+    void intersect_with(const AVLTree& other);
+    void difference_with(const AVLTree& other);
+
+    // Order statistics, for node types with a SubtreeSize augment (see OrderStatisticAVLTree).
+    std::size_t size() const;
+    typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator select(std::size_t index);
+    typename AVLTree<Key, Value, Alloc, NodeType, Compare>::const_iterator select(std::size_t index) const;
+    std::size_t rank(const Key& key) const;
+
+    // Aggregate of the items with keys in [low, high), for node types with a MonoidAugment (see AggregateAVLTree).
+    auto aggregate(const Key& low, const Key& high) const;
+
+private:
+	/* Helper functions are strongly encouraged to help separate the problem
+	   into smaller pieces. You should not need additional data members. */
+    static int heightOf(const NodeType* node);
+    static int balanceOf(NodeType* node);
+    NodeType* rebalance(NodeType* z);
+    void updateSingle(NodeType* thing);
+    void pullPath(NodeType* node);
+    template<typename Monoid>
+    typename Monoid::value_type aggregateBelow(const NodeType* node, const Key* low, const Key* high) const;
+    NodeType* insertBelow(NodeType* start, const std::pair<Key, Value>& keyValuePair, bool& added);
+    void linkLeaf(NodeType* leaf, NodeType* parent, int order) final;
+    void valueUpdated(NodeType* node) final;
+    NodeType* climbToCover(NodeType* finger, const Key& key) const;
+    NodeType* climbNear(NodeType* node, const Key& key) const;
+    NodeType* findBelow(NodeType* start, const Key& key) const;
+    static NodeType* predecessorOf(NodeType* node);
+    static NodeType* successorOf(NodeType* node);
+    void removeNode(NodeType* deleted);
+    std::size_t countUpTo(std::size_t limit) const;
+    void mergeRebuild(const std::vector<std::pair<Key, Value> >& batch);
+
+    // In-order links of threaded node types, see ThreadedLinks.
+    static NodeType* nextThread(const NodeType* node);
+    static NodeType* prevThread(const NodeType* node);
+    static void linkThreads(NodeType* prev, NodeType* next);
+    void threadAll();
+
+    // Join based building blocks. They all take and return detached subtree roots (parent NULL).
+    static void expose(NodeType* node, NodeType*& left, NodeType*& right);
+    NodeType* joinNodes(NodeType* left, NodeType* middle, NodeType* right);
+    NodeType* joinRight(NodeType* left, NodeType* middle, NodeType* right);
+    NodeType* joinLeft(NodeType* left, NodeType* middle, NodeType* right);
+    NodeType* joinPair(NodeType* left, NodeType* right);
+    NodeType* splitLast(NodeType* root, NodeType*& last);
+    NodeType* splitNodes(NodeType* root, const Key& key, NodeType*& found, NodeType*& greater);
+    NodeType* unionNodes(NodeType* mine, const NodeType* theirs, std::mutex& lock);
+    NodeType* intersectNodes(NodeType* mine, const NodeType* theirs, std::mutex& lock);
+    NodeType* differenceNodes(NodeType* mine, const NodeType* theirs, std::mutex& lock);
+    NodeType* copySubtree(const NodeType* theirs, std::mutex& lock);
+    void destroySubtree(NodeType* node, std::mutex& lock);
+    static bool worthForking(const NodeType* mine, const NodeType* theirs);
+
+    // Subtrees at least this tall on both sides of a set operation are handled as separate tasks.
+    static const int kForkHeight = 10;
+    // Augmented nodes summarize their whole subtree, so every ancestor of a change has to be pulled.
+    // The in-order links alone need no pulling, insert and remove keep them.
+    static const bool kAugmented = !std::is_same<typename NodeType::AugmentType, NoAugment>::value
+        && !std::is_same<typename NodeType::AugmentType, ThreadedLinks<> >::value;
+    static const bool kThreaded = NodeHasThreads<NodeType>::value;
+};
+
+/**
+* An AVLTree whose nodes link to each other through 32-bit pool indices, for when the tree overhead
+* matters more than the extra pool lookup on every link.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+using IndexedAVLTree = AVLTree<Key, Value, NodePoolAllocator<IndexedAVLNode<Key, Value> >, IndexedAVLNode<Key, Value>, Compare>;
+
+/**
+* An AVLTree that keeps subtree sizes, for select(), rank() and O(log n) iterator arithmetic.
+*/
+template <class Key, class Value, class Alloc = SlabNodeAllocator, class Compare = std::less<Key> >
+using OrderStatisticAVLTree = AVLTree<Key, Value, Alloc, AVLNode<Key, Value, SubtreeSize>, Compare>;
+
+/**
+* An AVLTree that keeps a Monoid aggregate of every subtree, for aggregate(low, high).
+*/
+template <class Key, class Value, class Monoid, class Alloc = SlabNodeAllocator, class Compare = std::less<Key> >
+using AggregateAVLTree = AVLTree<Key, Value, Alloc, AVLNode<Key, Value, MonoidAugment<Monoid> >, Compare>;
+
+/**
+* An AVLTree whose nodes are threaded in key order, for scans that never climb the tree. Each node is
+* two pointers larger.
+*/
+template <class Key, class Value, class Alloc = SlabNodeAllocator, class Compare = std::less<Key> >
+using ThreadedAVLTree = AVLTree<Key, Value, Alloc, AVLNode<Key, Value, ThreadedLinks<> >, Compare>;
+
+/*
+----------------------------------------------------
+Begin implementations for the AVLTree::Finger class.
+----------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+AVLTree<Key, Value, Alloc, NodeType, Compare>::Finger::Finger(AVLTree* tree, NodeType* node)
+    : mTree(tree)
+    , mNode(node)
+{
+
+}
+
+/**
+* With no node to start from, in a tree that was empty when the finger was made, the search starts at
+* the root.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+bool AVLTree<Key, Value, Alloc, NodeType, Compare>::Finger::seek(const Key& key)
+{
+    NodeType* start = mNode == NULL ? mTree->mRoot : mTree->climbNear(mNode, key);
+    NodeType* parent;
+    int order;
+    NodeType* found = mTree->findSlot(start, key, parent, order);
+    mNode = found != NULL ? found : parent;
+    return found != NULL;
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator AVLTree<Key, Value, Alloc, NodeType, Compare>::Finger::position() const
+{
+    return typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator(mNode, mTree);
+}
+
+/**
+* Like insert, which replaces the value of a key that is already there, but returns the item's position
+* and whether the key is new.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::pair<typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> AVLTree<Key, Value, Alloc, NodeType, Compare>::Finger::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    NodeType* start = mNode == NULL ? mTree->mRoot : mTree->climbNear(mNode, keyValuePair.first);
+    bool added;
+    mNode = mTree->insertBelow(start, keyValuePair, added);
+    return std::make_pair(typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator(mNode, mTree), added);
+}
+
+/**
+* The finger moves to the removed key's successor, or its predecessor if it was the largest. Neither is
+* the node that gets freed, so the finger survives the removal and its rotations.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+bool AVLTree<Key, Value, Alloc, NodeType, Compare>::Finger::remove(const Key& key)
+{
+    if(!seek(key))
+    {
+        return false;
+    }
+    NodeType* deleted = mNode;
+    mNode = successorOf(deleted);
+    if(mNode == NULL)
+    {
+        mNode = predecessorOf(deleted);
+    }
+    mTree->removeNode(deleted);
+    return true;
+}
+
+/*
+--------------------------------------------------
+End implementations for the AVLTree::Finger class.
+--------------------------------------------------
+*/
+
+/*
+--------------------------------------------
+Begin implementations for the AVLTree class.
+--------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+AVLTree<Key, Value, Alloc, NodeType, Compare>::AVLTree()
+{
+
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+AVLTree<Key, Value, Alloc, NodeType, Compare>::AVLTree(const Compare& compare)
+    : rotateBST<Key, Value, Alloc, NodeType, Compare>(compare)
+{
+
+}
+
+/**
+* Builds the tree from a range of key value pairs that is already sorted by key.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Iterator>
+AVLTree<Key, Value, Alloc, NodeType, Compare>::AVLTree(Iterator first, Iterator last, bool checkSorted)
+{
+    assign_sorted(first, last, checkSorted);
+}
+
+/**
+* Same as BinarySearchTree::assign_sorted, but also sets the height of every node as it is built.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Iterator>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::assign_sorted(Iterator first, Iterator last, bool checkSorted)
+{
+    if(checkSorted)
+    {
+        this->checkStrictlySorted(first, last);
+    }
+    this->clear();
+    std::size_t count = (std::size_t)std::distance(first, last);
+    this->mRoot = this->buildSorted(first, count, (NodeType*)NULL, [this](NodeType* node) { updateSingle(node); });
+    this->mRightmost = this->getLargestNode();
+    this->mLeftmost = this->getSmallestNode();
+    threadAll();
+}
+
+/**
+* Copies the items into a FrozenAVLTree. Later changes to this tree do not show in the copy.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+FrozenAVLTree<Key, Value, Compare> AVLTree<Key, Value, Alloc, NodeType, Compare>::freeze() const
+{
+    if(this->mRoot == NULL)
+    {
+        return FrozenAVLTree<Key, Value, Compare>(this->mCompare);
+    }
+    std::size_t count = countUpTo(std::numeric_limits<std::size_t>::max() - 1);
+    return FrozenAVLTree<Key, Value, Compare>(this->begin(), count, this->mCompare);
+}
+
+/**
+* Height of a possibly empty subtree. Empty subtrees have a height of 0 and leaves a height of 1.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+int AVLTree<Key, Value, Alloc, NodeType, Compare>::heightOf(const NodeType* node)
+{
+    return node == NULL ? 0 : node->getHeight();
+}
+
+/**
+* Balance factor of a node using the stored heights of its children. Positive means left heavy.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+int AVLTree<Key, Value, Alloc, NodeType, Compare>::balanceOf(NodeType* node)
+{
+    return heightOf(node->getLeft()) - heightOf(node->getRight());
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::updateSingle(NodeType* thing){
+    if(thing->getLeft() != NULL && thing->getRight() != NULL)
+    {
+        //choose the child of greater height or if equal choose either
+        if(thing->getLeft()->getHeight() > thing->getRight()->getHeight())
+        {
+            thing->setHeight(thing->getLeft()->getHeight()+1);
+        }
+        else if(thing->getLeft()->getHeight() < thing->getRight()->getHeight())
+        {
+            thing->setHeight(thing->getRight()->getHeight()+1);
+        }
+        else
+        {
+            thing->setHeight(thing->getLeft()->getHeight()+1);
+        }
+    }
+    else if(thing->getLeft() != NULL && thing->getRight() == NULL)
+    {
+        thing->setHeight(thing->getLeft()->getHeight()+1);
+    }
+    else if(thing->getRight() != NULL && thing->getLeft() == NULL)
+    {
+        thing->setHeight(thing->getRight()->getHeight()+1);
+    }
+    else
+    {
+        thing->setHeight(1);
+    }
+    thing->pull();
+}
+
+/**
+* Brings the augment of node and all of its ancestors up to date after a change below node that the
+* retrace did not carry all the way to the root. Does nothing for nodes without an augment.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::pullPath(NodeType* node)
+{
+    if constexpr(kAugmented)
+    {
+        for(; node != NULL; node = node->getParent())
+        {
+            node->pull();
+        }
+    }
+}
+
+/**
+* Restores the AVL property at z, whose children differ in height by 2, with a single or double
+* rotation. Only z and the nodes rotated around it get new heights. Returns the new root of the subtree.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::rebalance(NodeType* z){
+    NodeType* y;
+    //left heavy
+    if(balanceOf(z) > 1)
+    {
+        y = z->getLeft();
+        //zig zag going left
+        if(balanceOf(y) < 0)
+        {
+            this->leftRotate(y);
+            updateSingle(y);
+        }
+        this->rightRotate(z);
+    }
+    //right heavy
+    else
+    {
+        y = z->getRight();
+        //zig zag going right
+        if(balanceOf(y) > 0)
+        {
+            this->rightRotate(y);
+            updateSingle(y);
+        }
+        this->leftRotate(z);
+    }
+    //z is now a child of the new subtree root
+    updateSingle(z);
+    updateSingle(z->getParent());
+    return z->getParent();
+}
+
+/**
+* Insert function for a key value pair. Finds location to insert the node and then retraces the
+* path back up to the root, stopping at the first rotation or the first ancestor whose height is
+* unchanged. Nodes off the insertion path are never visited.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    bool added;
+    insertBelow(this->mRoot, keyValuePair, added);
+}
+
+/**
+* Helper function for insert. Descends from start, which has to be an ancestor of the key's position,
+* and either updates the existing node or hangs a new leaf and retraces. Returns the node holding the key
+* and sets added to whether it is a new one.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::insertBelow(NodeType* start, const std::pair<Key, Value>& keyValuePair, bool& added)
+{
+    NodeType* parent;
+    int order;
+    NodeType* found = this->findSlot(start, keyValuePair.first, parent, order);
+    if(found != NULL)
+    {
+        found->setValue(keyValuePair.second);
+        pullPath(found);
+        added = false;
+        return found;
+    }
+    NodeType* leaf = this->createNode(keyValuePair.first, keyValuePair.second, parent);
+    linkLeaf(leaf, parent, order);
+    added = true;
+    return leaf;
+}
+
+/**
+* Hangs a new leaf where findSlot put it, threads it in and retraces the path back up to the root, stopping
+* at the first rotation or the first ancestor whose height is unchanged.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::linkLeaf(NodeType* leaf, NodeType* parent, int order)
+{
+    leaf->setParent(parent);
+    updateSingle(leaf);
+    if(parent == NULL)
+    {
+        this->mRoot = leaf;
+        this->mRightmost = leaf;
+        this->mLeftmost = leaf;
+        return;
+    }
+    //the parent is the new leaf's neighbour in key order on the side it hangs from
+    if(order < 0)
+    {
+        parent->setLeft(leaf);
+        if(parent == this->mLeftmost)
+        {
+            this->mLeftmost = leaf;
+        }
+        if constexpr(kThreaded)
+        {
+            linkThreads(prevThread(parent), leaf);
+            linkThreads(leaf, parent);
+        }
+    }
+    else
+    {
+        parent->setRight(leaf);
+        if(parent == this->mRightmost)
+        {
+            this->mRightmost = leaf;
+        }
+        if constexpr(kThreaded)
+        {
+            linkThreads(leaf, nextThread(parent));
+            linkThreads(parent, leaf);
+        }
+    }
+    //retrace towards the root
+    while(parent != NULL)
+    {
+        int oldHeight = parent->getHeight();
+        updateSingle(parent);
+        int balance = balanceOf(parent);
+        //a single or double rotation restores the height the subtree had before the insert
+        if(balance > 1 || balance < -1)
+        {
+            parent = rebalance(parent);
+            break;
+        }
+        if(parent->getHeight() == oldHeight)
+        {
+            break;
+        }
+        parent = parent->getParent();
+    }
+    if(parent != NULL)
+    {
+        pullPath(parent->getParent());
+    }
+}
+
+/**
+* An aggregate over the values has to be recomputed on the path above a replaced value.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::valueUpdated(NodeType* node)
+{
+    pullPath(node);
+}
+
+/**
+* Walks up from finger to the lowest ancestor whose subtree can hold key, given that key is greater
+* than the finger's key. Subtrees that a right child spans are bounded by the same ancestor as their
+* parent, so only a left child whose parent is greater than key stops the climb.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::climbToCover(NodeType* finger, const Key& key) const
+{
+    NodeType* parent = finger->getParent();
+    while(parent != NULL)
+    {
+        if(parent->getLeft() == finger && this->lessKeys(key, parent->getKey()))
+        {
+            break;
+        }
+        finger = parent;
+        parent = parent->getParent();
+    }
+    return finger;
+}
+
+/**
+* Walks up from node to the lowest ancestor whose subtree can hold key, like climbToCover but for a key
+* on either side of node's. Going up from a child on the same side as key, the parent bounds the
+* subtree on the far side of key once key is between the two. An ancestor holding key is returned as
+* soon as it is passed.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::climbNear(NodeType* node, const Key& key) const
+{
+    int side = this->compareKeys(key, node->getKey());
+    if(side == 0)
+    {
+        return node;
+    }
+    NodeType* parent = node->getParent();
+    while(parent != NULL)
+    {
+        if((side > 0 ? parent->getLeft() : parent->getRight()) == node)
+        {
+            int order = this->compareKeys(key, parent->getKey());
+            if(order == 0)
+            {
+                return parent;
+            }
+            if((order < 0) == (side > 0))
+            {
+                break;
+            }
+        }
+        node = parent;
+        parent = parent->getParent();
+    }
+    return node;
+}
+
+/**
+* Fingers start on the root, the one node every key is as close to as any other.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename AVLTree<Key, Value, Alloc, NodeType, Compare>::Finger AVLTree<Key, Value, Alloc, NodeType, Compare>::finger()
+{
+    return Finger(this, this->mRoot);
+}
+
+/**
+* Counts the nodes in order, giving up once more than limit have been seen.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t AVLTree<Key, Value, Alloc, NodeType, Compare>::countUpTo(std::size_t limit) const
+{
+    std::size_t count = 0;
+    if(this->mRoot == NULL)
+    {
+        return count;
+    }
+    for(typename AVLTree<Key, Value, Alloc, NodeType, Compare>::const_iterator it = this->begin(); it != this->end() && count <= limit; ++it)
+    {
+        ++count;
+    }
+    return count;
+}
+
+/**
+* Helper function for insert_batch. Merges the tree's nodes with the sorted, duplicate free batch and
+* relinks everything into a perfectly balanced tree. Existing nodes are reused, only new keys allocate.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::mergeRebuild(const std::vector<std::pair<Key, Value> >& batch)
+{
+    std::vector<NodeType*> existing;
+    for(NodeType* node = this->getSmallestNode(); node != NULL; node = successorOf(node))
+    {
+        existing.push_back(node);
+    }
+    std::vector<NodeType*> merged;
+    merged.reserve(existing.size() + batch.size());
+    std::size_t i = 0;
+    std::size_t j = 0;
+    while(i < existing.size() || j < batch.size())
+    {
+        int order = j == batch.size() ? -1 : i == existing.size() ? 1 : this->compareKeys(existing[i]->getKey(), batch[j].first);
+        if(order < 0)
+        {
+            merged.push_back(existing[i++]);
+        }
+        else if(order > 0)
+        {
+            merged.push_back(this->createNode(batch[j].first, batch[j].second, NULL));
+            ++j;
+        }
+        else
+        {
+            existing[i]->setValue(batch[j++].second);
+            merged.push_back(existing[i++]);
+        }
+    }
+    this->mRoot = this->linkSorted(merged.data(), merged.size(), (NodeType*)NULL, [this](NodeType* node) { updateSingle(node); });
+    this->mRightmost = merged.back();
+    this->mLeftmost = merged.front();
+    if constexpr(kThreaded)
+    {
+        linkThreads(NULL, merged.front());
+        for(std::size_t k = 1; k < merged.size(); ++k)
+        {
+            linkThreads(merged[k - 1], merged[k]);
+        }
+        linkThreads(merged.back(), NULL);
+    }
+}
+
+/**
+* Inserts count key value pairs at once. The batch is sorted and deduplicated first. A batch that is
+* large next to the tree is merged with it in a single linear pass and the tree is rebuilt, otherwise
+* the keys go in one by one in increasing order, each descent starting from the previous key's node
+* instead of the root.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::insert_batch(const std::pair<Key, Value>* items, std::size_t count)
+{
+    if(count == 0)
+    {
+        return;
+    }
+    std::vector<std::pair<Key, Value> > batch(items, items + count);
+    std::stable_sort(batch.begin(), batch.end(),
+        [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return this->lessKeys(a.first, b.first); });
+    //keep the last pair of every run of equal keys
+    std::size_t unique = 0;
+    for(std::size_t i = 0; i < batch.size(); ++i)
+    {
+        if(unique > 0 && !this->lessKeys(batch[unique - 1].first, batch[i].first))
+        {
+            batch[unique - 1] = batch[i];
+        }
+        else
+        {
+            if(unique != i)
+            {
+                batch[unique] = batch[i];
+            }
+            ++unique;
+        }
+    }
+    batch.resize(unique);
+    //finger descents stay short while the batch is dense in the tree, a rebuild pays for every node
+    //in the tree, so rebuilding only wins once the tree is within a small factor of the batch
+    std::size_t limit = batch.size() * 4;
+    if(countUpTo(limit) <= limit)
+    {
+        mergeRebuild(batch);
+        return;
+    }
+    bool added;
+    NodeType* finger = insertBelow(this->mRoot, batch[0], added);
+    for(std::size_t i = 1; i < batch.size(); ++i)
+    {
+        finger = insertBelow(climbToCover(finger, batch[i].first), batch[i], added);
+    }
+}
+
+/**
+* Helper function for apply_batch. Descends from start, which has to be an ancestor of the key's
+* position, and returns the node holding key or NULL.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::findBelow(NodeType* start, const Key& key) const
+{
+    NodeType* current = start;
+    while(current != NULL)
+    {
+        int order = this->compareKeys(key, current->getKey());
+        if(order < 0)
+        {
+            current = current->getLeft();
+        }
+        else if(order > 0)
+        {
+            current = current->getRight();
+        }
+        else
+        {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+/**
+* In order predecessor of node, or NULL for the smallest node.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::predecessorOf(NodeType* node)
+{
+    if(node->getLeft() != NULL)
+    {
+        node = node->getLeft();
+        while(node->getRight() != NULL)
+        {
+            node = node->getRight();
+        }
+        return node;
+    }
+    NodeType* parent = node->getParent();
+    while(parent != NULL && parent->getLeft() == node)
+    {
+        node = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
+/**
+* In order successor of node, or NULL for the largest node. Walks the tree, not the threads, so that
+* threadAll() can use it to rebuild them.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::successorOf(NodeType* node)
+{
+    if(node->getRight() != NULL)
+    {
+        node = node->getRight();
+        while(node->getLeft() != NULL)
+        {
+            node = node->getLeft();
+        }
+        return node;
+    }
+    NodeType* parent = node->getParent();
+    while(parent != NULL && parent->getRight() == node)
+    {
+        node = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
+/**
+* The threaded successor of node. Only for node types with NodeHasThreads, like the other thread helpers.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::nextThread(const NodeType* node)
+{
+    return static_cast<NodeType*>(node->getNextLink());
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::prevThread(const NodeType* node)
+{
+    return static_cast<NodeType*>(node->getPrevLink());
+}
+
+/**
+* Makes prev and next adjacent in key order. Either may be NULL to mark the end of the threads.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::linkThreads(NodeType* prev, NodeType* next)
+{
+    if(prev != NULL)
+    {
+        prev->setNextLink(next);
+    }
+    if(next != NULL)
+    {
+        next->setPrevLink(prev);
+    }
+}
+
+/**
+* Rethreads the whole tree with one in-order walk, after operations that rebuild it wholesale. Does
+* nothing for node types without threads.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::threadAll()
+{
+    if constexpr(kThreaded)
+    {
+        NodeType* prev = NULL;
+        for(NodeType* node = this->getSmallestNode(); node != NULL; node = successorOf(node))
+        {
+            linkThreads(prev, node);
+            prev = node;
+        }
+        linkThreads(prev, NULL);
+    }
+}
+
+/**
+* Applies a batch of inserts and removes sorted by key. Like the finger path of insert_batch, every
+* descent starts from the lowest ancestor of the previous key's node that covers the next key. A remove
+* leaves the finger on the removed key's predecessor, which survives the removal and its rotations.
+* Updates to equal keys are applied in the order they are given.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::apply_batch(Update* const* updates, std::size_t count)
+{
+    //the finger is either NULL or a node whose key is not greater than the next update's key
+    NodeType* finger = NULL;
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        Update& update = *updates[i];
+        NodeType* start = finger == NULL ? this->mRoot : climbToCover(finger, update.item.first);
+        if(!update.remove)
+        {
+            if(this->mRoot == NULL)
+            {
+                this->mRoot = this->createNode(update.item.first, update.item.second, NULL);
+                this->mRightmost = this->mRoot;
+                this->mLeftmost = this->mRoot;
+                updateSingle(this->mRoot);
+                finger = this->mRoot;
+                update.changed = true;
+                continue;
+            }
+            finger = insertBelow(start, update.item, update.changed);
+            continue;
+        }
+        NodeType* deleted = findBelow(start, update.item.first);
+        update.changed = deleted != NULL;
+        if(deleted != NULL)
+        {
+            finger = predecessorOf(deleted);
+            removeNode(deleted);
+        }
+    }
+}
+
+/**
+* Remove function for a given key. Finds the node with a single descent, splices it (or its predecessor)
+* out of the tree and then retraces only the ancestors of the spliced position, stopping as soon as a
+* subtree keeps its old height.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::remove(const Key& key)
+{
+    NodeType* deleted = this->internalFind(key);
+    //if the key does not exist
+    if(deleted == NULL)
+    {
+        return;
+    }
+    removeNode(deleted);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename C, typename>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::remove(const K& key)
+{
+    NodeType* deleted = this->internalFind(key);
+    if(deleted == NULL)
+    {
+        return;
+    }
+    removeNode(deleted);
+}
+
+/**
+* Helper function for remove and apply_batch. Splices deleted out, frees it and retraces.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::removeNode(NodeType* deleted)
+{
+    bool twoChildren = deleted->getLeft() != NULL && deleted->getRight() != NULL;
+    if constexpr(kThreaded)
+    {
+        linkThreads(prevThread(deleted), nextThread(deleted));
+    }
+    NodeType* replacement;
+    NodeType* parent = this->unlinkNode(deleted, replacement);
+    //a predecessor moved into the removed node's position takes over its height
+    if(twoChildren)
+    {
+        replacement->setHeight(deleted->getHeight());
+    }
+    this->destroyNode(deleted);
+    //retrace towards the root
+    while(parent != NULL)
+    {
+        int oldHeight = parent->getHeight();
+        updateSingle(parent);
+        int balance = balanceOf(parent);
+        //unlike insert, a rotation here can still shrink the subtree so retracing may continue
+        if(balance > 1 || balance < -1)
+        {
+            parent = rebalance(parent);
+        }
+        if(parent->getHeight() == oldHeight)
+        {
+            pullPath(parent->getParent());
+            return;
+        }
+        parent = parent->getParent();
+    }
+}
+
+/**
+* Takes the children off node, leaving all three detached, and resets node to a leaf.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::expose(NodeType* node, NodeType*& left, NodeType*& right)
+{
+    left = node->getLeft();
+    right = node->getRight();
+    if(left != NULL)
+    {
+        left->setParent(NULL);
+    }
+    if(right != NULL)
+    {
+        right->setParent(NULL);
+    }
+    node->setLeft(NULL);
+    node->setRight(NULL);
+    node->setParent(NULL);
+    node->setHeight(1);
+}
+
+/**
+* Joins two AVL subtrees around a middle node whose key lies between them. Heights that differ by more
+* than one are handled by descending the spine of the taller tree, which costs O(|height difference|).
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::joinNodes(NodeType* left, NodeType* middle, NodeType* right)
+{
+    if(heightOf(left) > heightOf(right) + 1)
+    {
+        return joinRight(left, middle, right);
+    }
+    if(heightOf(right) > heightOf(left) + 1)
+    {
+        return joinLeft(left, middle, right);
+    }
+    middle->setParent(NULL);
+    middle->setLeft(left);
+    middle->setRight(right);
+    if(left != NULL)
+    {
+        left->setParent(middle);
+    }
+    if(right != NULL)
+    {
+        right->setParent(middle);
+    }
+    updateSingle(middle);
+    return middle;
 }
 
 /**
-* Getter function for the height. 
+* Helper function for joinNodes when left is the taller tree. Walks down the right spine of left until the
+* heights are within one, hangs middle there and fixes the one spot that can end up unbalanced on the way
+* back up with the usual rotations.
 */
-template<typename Key, typename Value>
-int AVLNode<Key, Value>::getHeight() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::joinRight(NodeType* left, NodeType* middle, NodeType* right)
 {
-    return mHeight;
+    NodeType* spine = left->getRight();
+    if(spine != NULL)
+    {
+        spine->setParent(NULL);
+    }
+    NodeType* joined;
+    if(heightOf(spine) <= heightOf(right) + 1)
+    {
+        joined = joinNodes(spine, middle, right);
+    }
+    else
+    {
+        joined = joinRight(spine, middle, right);
+    }
+    left->setRight(joined);
+    joined->setParent(left);
+    updateSingle(left);
+    if(balanceOf(left) < -1)
+    {
+        return rebalance(left);
+    }
+    return left;
 }
 
 /**
-* Setter function for the height. 
+* Mirror image of joinRight for when right is the taller tree.
 */
-template<typename Key, typename Value>
-void AVLNode<Key, Value>::setHeight(int height)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::joinLeft(NodeType* left, NodeType* middle, NodeType* right)
 {
-    mHeight = height;
+    NodeType* spine = right->getLeft();
+    if(spine != NULL)
+    {
+        spine->setParent(NULL);
+    }
+    NodeType* joined;
+    if(heightOf(spine) <= heightOf(left) + 1)
+    {
+        joined = joinNodes(left, middle, spine);
+    }
+    else
+    {
+        joined = joinLeft(left, middle, spine);
+    }
+    right->setLeft(joined);
+    joined->setParent(right);
+    updateSingle(right);
+    if(balanceOf(right) > 1)
+    {
+        return rebalance(right);
+    }
+    return right;
 }
 
 /**
-* Getter function for the parent. Used since the node inherits from a base node.
+* Joins two subtrees without a middle node by borrowing the largest node of left.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLNode<Key, Value>::getParent() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::joinPair(NodeType* left, NodeType* right)
 {
-    return static_cast<AVLNode<Key,Value>*>(this->mParent);
+    if(left == NULL)
+    {
+        return right;
+    }
+    if(right == NULL)
+    {
+        return left;
+    }
+    NodeType* last;
+    NodeType* rest = splitLast(left, last);
+    return joinNodes(rest, last, right);
 }
 
 /**
-* Getter function for the left child. Used since the node inherits from a base node.
+* Removes the largest node of a non-empty subtree. Returns what is left and the detached node through last.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLNode<Key, Value>::getLeft() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::splitLast(NodeType* root, NodeType*& last)
 {
-    return static_cast<AVLNode<Key,Value>*>(this->mLeft);
+    NodeType* left;
+    NodeType* right;
+    expose(root, left, right);
+    if(right == NULL)
+    {
+        last = root;
+        return left;
+    }
+    NodeType* rest = splitLast(right, last);
+    return joinNodes(left, root, rest);
 }
 
 /**
-* Getter function for the right child. Used since the node inherits from a base node.
+* Splits a subtree by key. Returns the subtree of smaller keys and hands back the subtree of greater keys
+* through greater and the detached node holding key, or NULL, through found. O(log n).
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLNode<Key, Value>::getRight() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::splitNodes(NodeType* root, const Key& key, NodeType*& found, NodeType*& greater)
 {
-    return static_cast<AVLNode<Key,Value>*>(this->mRight);
+    if(root == NULL)
+    {
+        found = NULL;
+        greater = NULL;
+        return NULL;
+    }
+    NodeType* left;
+    NodeType* right;
+    expose(root, left, right);
+    int order = this->compareKeys(key, root->getKey());
+    if(order < 0)
+    {
+        NodeType* middle;
+        NodeType* less = splitNodes(left, key, found, middle);
+        greater = joinNodes(middle, root, right);
+        return less;
+    }
+    else if(order > 0)
+    {
+        NodeType* middle;
+        NodeType* less = joinNodes(left, root, splitNodes(right, key, found, middle));
+        greater = middle;
+        return less;
+    }
+    found = root;
+    greater = right;
+    return left;
 }
 
-/*
-------------------------------------------
-End implementations for the AVLNode class.
-------------------------------------------
-*/
-
 /**
-* A templated balanced binary search tree implemented as an AVL tree.
+* Whether the two halves of a set operation step are big enough to be worth running as separate tasks.
 */
-template <class Key, class Value>
-class AVLTree : public rotateBST<Key, Value>
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+bool AVLTree<Key, Value, Alloc, NodeType, Compare>::worthForking(const NodeType* mine, const NodeType* theirs)
 {
-public:
-	// Methods for inserting/removing elements from the tree. You must implement
-	// both of these methods. 
-    virtual void insert(const std::pair<Key, Value>& keyValuePair) override;
-    void remove(const Key& key);
-
-private:
-	/* Helper functions are strongly encouraged to help separate the problem
-	   into smaller pieces. You should not need additional data members. */
-    void insertHelper(AVLNode<Key, Value>* z);
-    void updateAll(AVLNode<Key, Value>* node);
-    void updateSingle(AVLNode<Key, Value>* thing);
-};
-
-/*
---------------------------------------------
-Begin implementations for the AVLTree class.
---------------------------------------------
-*/
+    return heightOf(mine) >= kForkHeight && heightOf(theirs) >= kForkHeight;
+}
 
 /**
-* Insert function for a key value pair. Finds location to insert the node and then balances the tree. 
+* Splits mine by the root key of theirs and unions the matching halves, in parallel when they are large,
+* before joining them back around that key. Nodes from theirs are copied, nodes of mine are reused.
 */
-
-
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::updateAll(AVLNode<Key, Value>* thing){
-    while(thing != NULL)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::unionNodes(NodeType* mine, const NodeType* theirs, std::mutex& lock)
+{
+    if(theirs == NULL)
     {
-        if(thing->getLeft() != NULL && thing->getRight() != NULL)
-        {
-            if(thing->getLeft()->getHeight() > thing->getRight()->getHeight())
-            {
-                thing->setHeight(thing->getLeft()->getHeight()+1);
-            }
-            else if(thing->getLeft()->getHeight() < thing->getRight()->getHeight())
-            {
-                thing->setHeight(thing->getRight()->getHeight()+1);
-            }
-            else
-            {
-                thing->setHeight(thing->getLeft()->getHeight()+1);
-            }
-        }
-        else if(thing->getLeft() != NULL && thing->getRight() == NULL)
-        {
-            thing->setHeight(thing->getLeft()->getHeight()+1);
-        }
-        else if(thing->getRight() != NULL && thing->getLeft() == NULL)
-        {
-            thing->setHeight(thing->getRight()->getHeight()+1);
-        }
-        thing = thing->getParent();
+        return mine;
     }
-}
-
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::updateSingle(AVLNode<Key, Value>* thing){
-    if(thing->getLeft() != NULL && thing->getRight() != NULL)
+    if(mine == NULL)
     {
-        //choose the child of greater height or if equal choose either
-        if(thing->getLeft()->getHeight() > thing->getRight()->getHeight())
-        {
-            thing->setHeight(thing->getLeft()->getHeight()+1);
-        }
-        else if(thing->getLeft()->getHeight() < thing->getRight()->getHeight())
-        {
-            thing->setHeight(thing->getRight()->getHeight()+1);
-        }
-        else
-        {
-            thing->setHeight(thing->getLeft()->getHeight()+1);
-        }
+        return copySubtree(theirs, lock);
     }
-    else if(thing->getLeft() != NULL && thing->getRight() == NULL)
+    bool fork = worthForking(mine, theirs);
+    NodeType* found;
+    NodeType* greater;
+    NodeType* less = splitNodes(mine, theirs->getKey(), found, greater);
+    if(found == NULL)
     {
-        thing->setHeight(thing->getLeft()->getHeight()+1);
+        std::lock_guard<std::mutex> guard(lock);
+        found = this->createNode(theirs->getKey(), theirs->getValue(), NULL);
+        found->setHeight(1);
     }
-    else if(thing->getRight() != NULL && thing->getLeft() == NULL)
+    NodeType* left;
+    NodeType* right;
+    auto doLeft = [&]() { left = unionNodes(less, theirs->getLeft(), lock); };
+    auto doRight = [&]() { right = unionNodes(greater, theirs->getRight(), lock); };
+    if(fork)
     {
-        thing->setHeight(thing->getRight()->getHeight()+1);
+        TaskPool::instance().fork(doLeft, doRight);
     }
     else
     {
-        thing->setHeight(1);
+        doLeft();
+        doRight();
     }
+    return joinNodes(left, found, right);
 }
 
-//helper function for insert
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::insertHelper(AVLNode<Key, Value>* z){
-    //exit if already balanced
-    if(this->isBalanced())
+/**
+* Same recursion as unionNodes, keeping only the split key of mine when it was found.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::intersectNodes(NodeType* mine, const NodeType* theirs, std::mutex& lock)
+{
+    if(mine == NULL)
     {
-        return;
+        return NULL;
     }
-    AVLNode<Key, Value>* y;
-    AVLNode<Key, Value>* x;
-    //get the y
-    if(z->getLeft() != NULL && z->getRight() != NULL)
+    if(theirs == NULL)
     {
-        if(z->getLeft()->getHeight() > z->getRight()->getHeight())
-        {
-            y = z->getLeft();
-        }
-        else
-        {
-            y = z->getRight();
-        }
+        destroySubtree(mine, lock);
+        return NULL;
     }
-    else if(z->getLeft() != NULL && z->getRight() == NULL)
+    bool fork = worthForking(mine, theirs);
+    NodeType* found;
+    NodeType* greater;
+    NodeType* less = splitNodes(mine, theirs->getKey(), found, greater);
+    NodeType* left;
+    NodeType* right;
+    auto doLeft = [&]() { left = intersectNodes(less, theirs->getLeft(), lock); };
+    auto doRight = [&]() { right = intersectNodes(greater, theirs->getRight(), lock); };
+    if(fork)
     {
-        y = z->getLeft();
+        TaskPool::instance().fork(doLeft, doRight);
     }
-    else if(z->getRight() != NULL && z->getLeft() == NULL)
+    else
     {
-        y = z->getRight();
+        doLeft();
+        doRight();
     }
-    //gets the x
-    if(y->getLeft() != NULL && y->getRight() != NULL)
+    if(found == NULL)
     {
-        if(y->getLeft()->getHeight() > y->getRight()->getHeight())
-        {
-            x = y->getLeft();
-        }
-        else if(y->getRight()->getHeight() > y->getLeft()->getHeight())
-        {
-            x = y->getRight();
-        }
-        else if(y->getLeft()->getHeight() == y->getRight()->getHeight())
-        {
-            if(z->getLeft() == y) x = y->getLeft();
-            else if(z->getRight() == y) x = y->getRight();
-        }
+        return joinPair(left, right);
+    }
+    return joinNodes(left, found, right);
+}
+
+/**
+* Same recursion as unionNodes, dropping the split key of mine when it was found.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::differenceNodes(NodeType* mine, const NodeType* theirs, std::mutex& lock)
+{
+    if(mine == NULL || theirs == NULL)
+    {
+        return mine;
     }
-    else if(y->getLeft() != NULL && y->getRight() == NULL)
+    bool fork = worthForking(mine, theirs);
+    NodeType* found;
+    NodeType* greater;
+    NodeType* less = splitNodes(mine, theirs->getKey(), found, greater);
+    if(found != NULL)
     {
-        x = y->getLeft();
+        std::lock_guard<std::mutex> guard(lock);
+        this->destroyNode(found);
     }
-    else if(y->getRight() != NULL && y->getLeft() == NULL)
+    NodeType* left;
+    NodeType* right;
+    auto doLeft = [&]() { left = differenceNodes(less, theirs->getLeft(), lock); };
+    auto doRight = [&]() { right = differenceNodes(greater, theirs->getRight(), lock); };
+    if(fork)
     {
-        x = y->getRight();
+        TaskPool::instance().fork(doLeft, doRight);
     }
-    //bool flag for if its zig zig or zig zag
-    bool zigzig = true;
-    //balances zig zig going left
-    if(z->getLeft() == y && y->getLeft() == x)
+    else
     {
-        this->rightRotate(z);
-        zigzig = true;
+        doLeft();
+        doRight();
     }
-    //balances zig zig going right
-    else if(z->getRight() == y && y->getRight() == x)
+    return joinPair(left, right);
+}
+
+/**
+* Copies a subtree of another tree node for node into this tree's allocator, keeping its shape and heights.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* AVLTree<Key, Value, Alloc, NodeType, Compare>::copySubtree(const NodeType* theirs, std::mutex& lock)
+{
+    if(theirs == NULL)
     {
-        this->leftRotate(z);
-        zigzig = true;
+        return NULL;
     }
-    //balances zig zag going left
-    else if(z->getLeft() == y && y->getRight() == x)
+    NodeType* node;
     {
-        this->leftRotate(y);
-        updateAll(y);
-        this->rightRotate(z);
-        updateAll(x);
-        zigzig = false;
+        std::lock_guard<std::mutex> guard(lock);
+        node = this->createNode(theirs->getKey(), theirs->getValue(), NULL);
     }
-    //balances zig zag going right
-    else if(z->getRight() == y && y->getLeft() == x)
+    NodeType* left = copySubtree(theirs->getLeft(), lock);
+    NodeType* right = copySubtree(theirs->getRight(), lock);
+    node->setLeft(left);
+    node->setRight(right);
+    if(left != NULL)
     {
-        this->rightRotate(y);
-        updateAll(y);
-        this->leftRotate(z);
-        updateAll(x);
-        zigzig = false;
+        left->setParent(node);
     }
-    if(zigzig)
+    if(right != NULL)
     {
-        //sets the new heights for z in a zig zig
-        updateSingle(z);
-        //sets the new heights for y
-        updateSingle(y);
-        //update heights of all the parents
-        AVLNode<Key, Value>* thing = y->getParent();
-        updateAll(thing);
+        right->setParent(node);
     }
+    node->setHeight(theirs->getHeight());
+    node->pull();
+    return node;
 }
 
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::destroySubtree(NodeType* node, std::mutex& lock)
 {
-    // TODO
-    
-    //if there is an empty tree
-    if(this->mRoot == NULL)
+    if(node == NULL)
     {
-        this->mRoot = new AVLNode<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-        dynamic_cast<AVLNode<Key, Value>*>(this->mRoot)->setHeight(1);
-        this->mRoot->setLeft(NULL);
-        this->mRoot->setRight(NULL);
         return;
     }
-    else
+    destroySubtree(node->getLeft(), lock);
+    destroySubtree(node->getRight(), lock);
+    std::lock_guard<std::mutex> guard(lock);
+    this->destroyNode(node);
+}
+
+/**
+* Builds this tree out of left, middle and right in O(log n), taking over the nodes (and, for an arena
+* allocator, the storage) of both trees. Throws std::invalid_argument, changing nothing, if the keys are
+* not in order. Either tree may be this tree itself.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::join(AVLTree& left, const std::pair<Key, Value>& middle, AVLTree& right)
+{
+    NodeType* leftRoot = left.mRoot;
+    NodeType* rightRoot = right.mRoot;
+    NodeType* largest = NULL;
+    NodeType* smallest = right.getSmallestNode();
+    if(leftRoot != NULL)
     {
-        AVLNode<Key, Value>* current;
-        AVLNode<Key, Value>* parent = dynamic_cast<AVLNode<Key, Value>*>(this->mRoot);
-        if(keyValuePair.first < parent->getKey())
-        {
-            current = parent->getLeft();
-        }   
-        else if(keyValuePair.first > parent->getKey())
-        {
-            current = parent->getRight();
-        }
-        else
+        largest = leftRoot;
+        while(largest->getRight() != NULL)
         {
-            parent->setValue(keyValuePair.second);
-            return;
-        }
-        while(current != NULL)
-        {
-            if(current->getKey() == keyValuePair.first)
-            {
-                current->setValue(keyValuePair.second);
-                return;
-            }
-            else if(keyValuePair.first < current->getKey())
-            {
-                parent = current;
-                current = current->getLeft();
-            }
-            else if(keyValuePair.first > current->getKey())
-            {
-                parent = current;
-                current = current->getRight();
-            }
+            largest = largest->getRight();
         }
-        if(keyValuePair.first < parent->getKey())
+        if(!this->lessKeys(largest->getKey(), middle.first))
         {
-            parent->setLeft(new AVLNode<Key, Value>(keyValuePair.first, keyValuePair.second, parent));
-            parent->getLeft()->setHeight(parent->getLeft()->getHeight()+1);
+            throw std::invalid_argument("join: left tree has a key that is not smaller than the middle key");
         }
-        else if(keyValuePair.first > parent->getKey())
+    }
+    if(smallest != NULL && !this->lessKeys(middle.first, smallest->getKey()))
+    {
+        throw std::invalid_argument("join: right tree has a key that is not greater than the middle key");
+    }
+    left.mRoot = NULL;
+    left.mRightmost = NULL;
+    left.mLeftmost = NULL;
+    right.mRoot = NULL;
+    right.mRightmost = NULL;
+    right.mLeftmost = NULL;
+    if(&left != this && &right != this)
+    {
+        this->clear();
+    }
+    this->mAlloc.adopt(left.mAlloc);
+    this->mAlloc.adopt(right.mAlloc);
+    NodeType* node = this->createNode(middle.first, middle.second, NULL);
+    if constexpr(kThreaded)
+    {
+        linkThreads(largest, node);
+        linkThreads(node, smallest);
+    }
+    this->mRoot = joinNodes(leftRoot, node, rightRoot);
+    this->mRightmost = this->getLargestNode();
+    this->mLeftmost = this->getSmallestNode();
+}
+
+/**
+* Splits the tree in O(log n). With an arena allocator nodes cannot outlive their arena, so the smaller
+* of the two halves (by height) is copied into the arena of the tree it ends up in, which adds the size
+* of that half to the cost.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+bool AVLTree<Key, Value, Alloc, NodeType, Compare>::split(const Key& key, AVLTree& greater)
+{
+    if(&greater == this)
+    {
+        throw std::invalid_argument("split: the greater tree has to be a different tree");
+    }
+    greater.clear();
+    NodeType* root = this->mRoot;
+    this->mRoot = NULL;
+    NodeType* found;
+    NodeType* upper;
+    NodeType* lower = splitNodes(root, key, found, upper);
+    if(found != NULL)
+    {
+        this->destroyNode(found);
+    }
+    if constexpr(kThreaded)
+    {
+        //the largest smaller key and the smallest greater key no longer continue into each other
+        NodeType* last = lower;
+        while(last != NULL && last->getRight() != NULL)
         {
-            parent->setRight(new AVLNode<Key, Value>(keyValuePair.first, keyValuePair.second, parent));
-            parent->getRight()->setHeight(parent->getRight()->getHeight()+1);
+            last = last->getRight();
         }
-        AVLNode<Key, Value>* place = parent;
-        updateAll(parent);
-        while(this->isBalanced() == false)
+        NodeType* first = upper;
+        while(first != NULL && first->getLeft() != NULL)
         {
-            //increments the height of the tree
-            AVLNode<Key, Value>* thenode = NULL;
-            parent = place;
-            while(parent != NULL)
-            {
-                //parent->setHeight(parent->getHeight()+1);
-                if(thenode != NULL){}
-                else
-                {
-                    if(parent->getLeft() != NULL && parent->getRight() != NULL)
-                    {
-                        if(abs(parent->getLeft()->getHeight() - parent->getRight()->getHeight()) >= 2)
-                        {
-                            thenode = parent;
-                        }
-                    }
-                    else if(parent->getLeft() != NULL && parent->getRight() == NULL)
-                    {
-                        if(parent->getLeft()->getHeight() >= 2)
-                        {
-                            thenode = parent;
-                        }
-                    }
-                    else if(parent->getRight() != NULL && parent->getLeft() == NULL)
-                    {
-                        if(parent->getRight()->getHeight() >= 2)
-                        {
-                            thenode = parent;
-                        }
-                    }
-                }
-                parent = parent->getParent();
-            }
-            if(thenode != NULL)
-            {
-                insertHelper(thenode);
-            }
+            first = first->getLeft();
         }
-        return;
+        linkThreads(last, NULL);
+        linkThreads(NULL, first);
+    }
+    std::mutex lock;
+    if(!Alloc::kReleasesAll)
+    {
+        this->mRoot = lower;
+        greater.mRoot = upper;
+    }
+    else if(heightOf(upper) <= heightOf(lower))
+    {
+        greater.mRoot = greater.copySubtree(upper, lock);
+        greater.threadAll();
+        destroySubtree(upper, lock);
+        this->mRoot = lower;
+    }
+    else
+    {
+        //hand the whole arena to greater and copy the lower half back into a fresh one
+        greater.mAlloc.adopt(this->mAlloc);
+        greater.mRoot = upper;
+        this->mRoot = copySubtree(lower, lock);
+        threadAll();
+        greater.destroySubtree(lower, lock);
     }
+    this->mRightmost = this->getLargestNode();
+    this->mLeftmost = this->getSmallestNode();
+    greater.mRightmost = greater.getLargestNode();
+    greater.mLeftmost = greater.getSmallestNode();
+    return found != NULL;
 }
 
 /**
-* Remove function for a given key. Finds the node, reattaches pointers, and then balances when finished. 
+* Adds every key of other in O(m log(n/m + 1)) work, where m is the size of the smaller tree, with the
+* recursion on both halves running in parallel on the shared TaskPool. Threaded trees are rethreaded
+* afterwards in one linear pass.
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::union_with(const AVLTree& other)
 {
-   // TODO
-    //root is null
-    if(this->mRoot == NULL)
+    if(&other == this)
     {
         return;
     }
-    //if you are removing just the root node
-    if(this->mRoot->getLeft() == NULL && this->mRoot->getRight() == NULL)
+    std::mutex lock;
+    NodeType* root = this->mRoot;
+    this->mRoot = NULL;
+    this->mRoot = unionNodes(root, other.mRoot, lock);
+    this->mRightmost = this->getLargestNode();
+    this->mLeftmost = this->getSmallestNode();
+    threadAll();
+}
+
+/**
+* Keeps only the keys that are also in other, with the same bounds as union_with.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::intersect_with(const AVLTree& other)
+{
+    if(&other == this)
     {
-        
-        this->mRoot->setLeft(NULL);
-        this->mRoot->setRight(NULL);
-        this->mRoot->setParent(NULL);
-        delete this->mRoot;
-        this->mRoot = NULL;
         return;
     }
-    //if the key does not exist
-    if(!this->internalFind(key))
+    std::mutex lock;
+    NodeType* root = this->mRoot;
+    this->mRoot = NULL;
+    this->mRoot = intersectNodes(root, other.mRoot, lock);
+    this->mRightmost = this->getLargestNode();
+    this->mLeftmost = this->getSmallestNode();
+    threadAll();
+}
+
+/**
+* Removes every key that is in other, with the same bounds as union_with.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void AVLTree<Key, Value, Alloc, NodeType, Compare>::difference_with(const AVLTree& other)
+{
+    if(&other == this)
     {
+        this->clear();
         return;
     }
-    //if the key does exist
-    else
+    std::mutex lock;
+    NodeType* root = this->mRoot;
+    this->mRoot = NULL;
+    this->mRoot = differenceNodes(root, other.mRoot, lock);
+    this->mRightmost = this->getLargestNode();
+    this->mLeftmost = this->getSmallestNode();
+    threadAll();
+}
+
+/**
+* Number of keys in the tree, in O(1).
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t AVLTree<Key, Value, Alloc, NodeType, Compare>::size() const
+{
+    static_assert(NodeHasSize<NodeType>::value, "size() needs a node type with a SubtreeSize augment");
+    return this->sizeOf(this->mRoot);
+}
+
+/**
+* The key at a zero based position in key order, or end() if the tree is not that large. O(log n).
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename AVLTree<Key, Value, Alloc, NodeType, Compare>::iterator AVLTree<Key, Value, Alloc, NodeType, Compare>::select(std::size_t index)
+{
+    return this->unconst(std::as_const(*this).select(index));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename AVLTree<Key, Value, Alloc, NodeType, Compare>::const_iterator AVLTree<Key, Value, Alloc, NodeType, Compare>::select(std::size_t index) const
+{
+    static_assert(NodeHasSize<NodeType>::value, "select() needs a node type with a SubtreeSize augment");
+    return typename AVLTree<Key, Value, Alloc, NodeType, Compare>::const_iterator(this->selectFrom(this->mRoot, index), this);
+}
+
+/**
+* Number of keys smaller than key, whether or not key itself is in the tree. O(log n).
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t AVLTree<Key, Value, Alloc, NodeType, Compare>::rank(const Key& key) const
+{
+    static_assert(NodeHasSize<NodeType>::value, "rank() needs a node type with a SubtreeSize augment");
+    return this->countLess(key);
+}
+
+/**
+* Combines the items with keys in [low, high) in key order. The search follows one path down to the node
+* where the paths to low and high split, and from there one path each, taking whole subtree aggregates
+* for everything in between, so it is O(log n).
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+auto AVLTree<Key, Value, Alloc, NodeType, Compare>::aggregate(const Key& low, const Key& high) const
+{
+    typedef typename NodeType::AugmentType::MonoidType Monoid;
+    if(!this->lessKeys(low, high))
+    {
+        return Monoid::identity();
+    }
+    return aggregateBelow<Monoid>(this->mRoot, &low, &high);
+}
+
+/**
+* Helper function for aggregate. A NULL bound means the subtree is known to lie entirely on that side of it.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Monoid>
+typename Monoid::value_type AVLTree<Key, Value, Alloc, NodeType, Compare>::aggregateBelow(const NodeType* node, const Key* low, const Key* high) const
+{
+    while(node != NULL)
     {
-        AVLNode<Key, Value>* predecessorPar = NULL;
-        AVLNode<Key, Value>* deleted = dynamic_cast<AVLNode<Key, Value>*>(this->internalFind(key));
-        //if the removed node is a leaf
-        if(deleted->getRight() == NULL && deleted->getLeft() == NULL)
+        if(low == NULL && high == NULL)
         {
-            AVLNode<Key, Value>* temp = deleted->getParent();
-            if(temp->getRight() == deleted)
-            {
-                temp->setRight(NULL);
-                delete deleted;
-            }
-            else if(temp->getLeft() == deleted)
-            {
-                temp->setLeft(NULL);
-                delete deleted;
-            }
-            deleted = NULL;
-            if(!this->isBalanced())
-            {
-                predecessorPar = temp;
-            }
+            return node->getAggregate();
         }
-        //if it is an internal node
-        else
+        if(low != NULL && this->lessKeys(node->getKey(), *low))
         {
-            //if it has a single child
-            //if the single child is on right
-            AVLNode<Key, Value>* parent = deleted->getParent();
-            if(deleted->getRight() != NULL && deleted->getLeft() == NULL)
-            {
-                //if the removed node is the root node
-                if(deleted == this->mRoot)
-                {
-                    this->mRoot = this->mRoot->getRight();
-                    this->mRoot->setParent(NULL);
-                    delete deleted;
-                    deleted = NULL;
-                }
-                //if the removed node is not the root node
-                else
-                {
-                    AVLNode<Key, Value>* child = deleted->getRight();
-                    child->setParent(parent);
-                    if(parent->getLeft() == deleted)
-                    {
-                        parent->setLeft(child);
-                    }
-                    else
-                    {
-                        parent->setRight(child);
-                    }
-                    delete deleted;
-                    deleted = NULL;
-                }
-                if(!this->isBalanced())
-                {
-                    predecessorPar = parent;
-                }
-            }
-            //if the single child is on the left
-            else if(deleted->getRight() == NULL && deleted->getLeft() != NULL)
-            {
-                //if the removed node is the root node
-                if(deleted == this->mRoot)
-                {
-                    this->mRoot = this->mRoot->getLeft();
-                    this->mRoot->setParent(NULL);
-                    delete deleted;
-                    deleted = NULL;
-                }
-                //if the removed node is not the root node
-                else
-                {
-                    AVLNode<Key, Value>* child = deleted->getLeft();
-                    child->setParent(parent);
-                    if(parent->getLeft() == deleted)
-                    {
-                        parent->setLeft(child);
-                    }
-                    else
-                    {
-                        parent->setRight(child);
-                    }
-                    delete deleted;
-                    deleted = NULL;
-                }
-                if(!this->isBalanced())
-                {
-                    predecessorPar = parent;
-                }
-            }
-            //if it has two children
-            else if(deleted->getRight() != NULL && deleted->getLeft() != NULL)
-            {
-                //set the predecessor 
-                AVLNode<Key, Value>* predecessor = deleted;
-                if(predecessor->getLeft() != NULL) predecessor = predecessor->getLeft();
-                while(predecessor->getRight() != NULL)
-                {
-                    predecessor = predecessor->getRight();
-                }
-                //if the predecessor's parent is the removed node and root node
-                if(predecessor->getParent() == deleted && predecessor->getParent() == this->mRoot)
-                {
-                    AVLNode<Key, Value>* temp = dynamic_cast<AVLNode<Key, Value>*>(this->mRoot->getRight());
-                    predecessor->setRight(temp);
-                    temp->setParent(predecessor);
-                    predecessor->setParent(NULL);
-                    delete this->mRoot;
-                    this->mRoot = predecessor;
-                    deleted = NULL;
-                }
-                //if the predecessor's parent is the removed node but not the root node
-                else if(predecessor->getParent() == deleted)
-                {
-                    //if the removed node is a right child
-                    if(parent->getRight() == deleted)
-                    {
-                        parent->setRight(predecessor);
-                        predecessor->setParent(parent);
-                        if(deleted->getRight() != NULL)
-                        {
-                            deleted->getRight()->setParent(predecessor);
-                            predecessor->setRight(deleted->getRight());
-                        }
-                        delete deleted;
-                        deleted = NULL;
-                    }
-                    //if the removed node is a left child
-                    else
-                    {
-                        parent->setLeft(predecessor);
-                        predecessor->setParent(parent);
-                        if(deleted->getRight() != NULL)
-                        {
-                            deleted->getRight()->setParent(predecessor);
-                            predecessor->setRight(deleted->getRight());
-                        }
-                        delete deleted;
-                        deleted = NULL;
-                    }
-                }
-                //if the predecessor's parent is not the removed node
-                else
-                {
-                    //if the removed node is the root node
-                    if(deleted == this->mRoot)
-                    {
-                        AVLNode<Key, Value>* temp = predecessor->getParent();
-                        //if predecessor has a left child
-                        if(predecessor->getLeft() != NULL)
-                        {
-                            predecessor->getLeft()->setParent(temp);
-                            temp->setRight(predecessor->getLeft());
-                        }
-                        //if predecessor does not have a left child
-                        else
-                        {
-                            temp->setRight(NULL);
-                        }
-                        predecessor->setRight(this->mRoot->getRight());
-                        predecessor->setLeft(this->mRoot->getLeft());
-                        this->mRoot->getRight()->setParent(predecessor);
-                        this->mRoot->getLeft()->setParent(predecessor);
-                        this->mRoot = predecessor;
-                        predecessor->setParent(NULL);
-                        delete deleted;
-                        deleted = NULL;
-                    }
-                    //if the removed node is a right child
-                    else if(parent->getRight() == deleted)
-                    {
-                        parent->setRight(predecessor);
-                        if(predecessor->getLeft() != NULL)
-                        {
-                            predecessor->getParent()->setRight(predecessor->getLeft());
-                            predecessor->getLeft()->setParent(predecessor->getParent());
-                        }
-                        else
-                        {
-                            predecessor->getParent()->setRight(NULL);
-                        }
-                        deleted->getLeft()->setParent(predecessor);
-                        if(deleted->getRight() != NULL)
-                        {
-                            deleted->getRight()->setParent(predecessor);
-                            predecessor->setRight(deleted->getRight());
-                        }
-                        else
-                        {
-                            predecessor->setRight(NULL);
-                        }
-                        predecessor->setLeft(deleted->getLeft());
-                        predecessor->setParent(parent);
-                        delete deleted;
-                        deleted = NULL;
-                    }
-                    //if the removed node is a left child
-                    else
-                    {
-                        parent->setLeft(predecessor);
-                        if(predecessor->getLeft() != NULL)
-                        {
-                            predecessor->getParent()->setRight(predecessor->getLeft());
-                            predecessor->getLeft()->setParent(predecessor->getParent());
-                        }
-                        else
-                        {
-                            predecessor->getParent()->setRight(NULL);
-                        }
-                        deleted->getLeft()->setParent(predecessor);
-                        if(deleted->getRight() != NULL)
-                        {
-                            deleted->getRight()->setParent(predecessor);
-                            predecessor->setRight(deleted->getRight());
-                        }
-                        else
-                        {
-                            predecessor->setRight(NULL);
-                        }
-                        predecessor->setLeft(deleted->getLeft());
-                        predecessor->setParent(parent);
-                        delete deleted;
-                        deleted = NULL;
-                    }
-                }
-                if(!this->isBalanced())
-                {
-                    predecessorPar = predecessor;
-                }
-            }
+            node = node->getRight();
         }
-        //keep balancing until it is balanced
-        while(!this->isBalanced())
+        else if(high != NULL && !this->lessKeys(node->getKey(), *high))
         {
-            if(predecessorPar != NULL)
-            {
-                insertHelper(predecessorPar);
-            }
-            if(predecessorPar == dynamic_cast<AVLNode<Key, Value>*>(this->mRoot))
-            {
-            }
-            else
-            {
-                predecessorPar = predecessorPar->getParent();
-            }
+            node = node->getLeft();
+        }
+        else
+        {
+            //node is in range, so its left subtree is bounded only by low and its right only by high
+            typename Monoid::value_type result = aggregateBelow<Monoid>(node->getLeft(), low, NULL);
+            result = Monoid::combine(result, Monoid::lift(node->getKey(), node->getValue()));
+            return Monoid::combine(result, aggregateBelow<Monoid>(node->getRight(), NULL, high));
         }
     }
-    return;
+    return Monoid::identity();
 }
 
 /*
@@ -0,0 +1,512 @@
+#include "avlbst.h"
+#include "persistent_avlbst.h"
+#include "bplustree.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Small timing harness for the tree operations. Usage: ./bench [number of keys]
+
+typedef chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const char* name, size_t ops, double seconds)
+{
+	cout << "  " << name << ": " << ops << " ops in " << seconds << " s ("
+		<< (ops / seconds / 1e6) << " Mops/s)" << endl;
+}
+
+// Runs the standard insert/find/scan/remove workload against one tree type.
+// Only even keys are inserted so that odd keys miss somewhere inside the tree.
+template<typename Tree>
+void runTree(const char* name, vector<int> keys)
+{
+	cout << name << endl;
+	size_t n = keys.size();
+	mt19937 rng(12345);
+	Tree tree;
+
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		tree.insert(std::pair<int,int>(keys[i], keys[i]));
+	}
+	report("insert (random order)", n, secondsSince(start));
+
+	shuffle(keys.begin(), keys.end(), rng);
+	long long checksum = 0;
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += tree.find(keys[i])->second;
+	}
+	report("find (hit)", n, secondsSince(start));
+
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += (tree.find(keys[i] + 1) == tree.end());
+	}
+	report("find (miss)", n, secondsSince(start));
+
+	start = Clock::now();
+	size_t visited = 0;
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		checksum += it->second;
+		++visited;
+	}
+	report("full scan", visited, secondsSince(start));
+
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		tree.remove(keys[i]);
+	}
+	report("remove (random order)", n, secondsSince(start));
+
+	cout << "  checksum " << checksum << endl;
+}
+
+// Percentile style lookups: select() against stepping an iterator from begin() to the same position.
+static void runSelect(const vector<int>& keys)
+{
+	cout << "OrderStatisticAVLTree<int,int>" << endl;
+	size_t n = keys.size();
+	mt19937 rng(54321);
+	OrderStatisticAVLTree<int,int> tree;
+	for(size_t i = 0; i < n; ++i)
+	{
+		tree.insert(std::pair<int,int>(keys[i], keys[i]));
+	}
+	if(n == 0)
+	{
+		return;
+	}
+
+	size_t queries = 100000;
+	long long checksum = 0;
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < queries; ++i)
+	{
+		checksum += tree.select(rng() % n)->second;
+	}
+	report("select", queries, secondsSince(start));
+
+	queries = 10;
+	start = Clock::now();
+	for(size_t i = 0; i < queries; ++i)
+	{
+		size_t steps = rng() % n;
+		OrderStatisticAVLTree<int,int>::iterator it = tree.begin();
+		for(size_t j = 0; j < steps; ++j)
+		{
+			++it;
+		}
+		checksum += it->second;
+	}
+	report("step from begin()", queries, secondsSince(start));
+
+	cout << "  checksum " << checksum << endl;
+}
+
+// Read only lookups: the same tree searched through its nodes and through its frozen copy.
+static void runFrozen(const vector<int>& keys)
+{
+	cout << "FrozenAVLTree<int,int>" << endl;
+	size_t n = keys.size();
+	mt19937 rng(2468);
+	AVLTree<int,int> tree;
+	for(size_t i = 0; i < n; ++i)
+	{
+		tree.insert(std::pair<int,int>(keys[i], keys[i]));
+	}
+
+	Clock::time_point start = Clock::now();
+	FrozenAVLTree<int,int> frozen = tree.freeze();
+	report("freeze", n, secondsSince(start));
+
+	//hits and misses mixed at random
+	vector<int> queries(n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		queries[i] = (int)(rng() % (2 * n + 1));
+	}
+	long long checksum = 0;
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += (tree.find(queries[i]) != tree.end());
+	}
+	report("AVLTree find (mixed)", n, secondsSince(start));
+
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += frozen.contains(queries[i]);
+	}
+	report("frozen find (mixed)", n, secondsSince(start));
+
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += (frozen.lower_bound(queries[i]) != frozen.end());
+	}
+	report("frozen lower_bound", n, secondsSince(start));
+
+	start = Clock::now();
+	size_t visited = 0;
+	for(FrozenAVLTree<int,int>::iterator it = frozen.begin(); it != frozen.end(); ++it)
+	{
+		checksum += it->second;
+		++visited;
+	}
+	report("frozen full scan", visited, secondsSince(start));
+
+	cout << "  checksum " << checksum << endl;
+}
+
+// A strict weak ordering that only answers less, so a descent needs two calls to tell equal from greater.
+struct StringLess
+{
+	bool operator()(const string& a, const string& b) const
+	{
+		return a < b;
+	}
+};
+
+// String keys with a long shared prefix, where each comparison has to scan past the prefix. The default
+// std::less<string> compares once per level through string::compare, StringLess twice.
+template<typename Tree>
+void runStrings(const char* name, const vector<int>& keys)
+{
+	cout << name << endl;
+	size_t n = keys.size();
+	vector<string> strings(n);
+	char buffer[32];
+	for(size_t i = 0; i < n; ++i)
+	{
+		snprintf(buffer, sizeof(buffer), "customer/%010d", keys[i]);
+		strings[i] = buffer;
+	}
+	Tree tree;
+
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		tree.insert(std::pair<string,int>(strings[i], keys[i]));
+	}
+	report("insert (random order)", n, secondsSince(start));
+
+	long long checksum = 0;
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += tree.find(strings[i])->second;
+	}
+	report("find (hit)", n, secondsSince(start));
+
+	//odd keys were never inserted
+	for(size_t i = 0; i < n; ++i)
+	{
+		snprintf(buffer, sizeof(buffer), "customer/%010d", keys[i] + 1);
+		strings[i] = buffer;
+	}
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		checksum += (tree.find(strings[i]) == tree.end());
+	}
+	report("find (miss)", n, secondsSince(start));
+
+	cout << "  checksum " << checksum << endl;
+}
+
+// Lookups from string_view tokens: building a std::string key for each one, which allocates once the
+// key is past the small string buffer, against passing the view to a tree with a transparent Compare.
+static void runStringViews(const vector<int>& keys)
+{
+	cout << "AVLTree<string,int> with std::less<>" << endl;
+	size_t n = keys.size();
+	string text;
+	vector<size_t> offsets(n + 1, 0);
+	char buffer[32];
+	AVLTree<string,int,SlabNodeAllocator,AVLNode<string,int>,less<> > tree;
+	for(size_t i = 0; i < n; ++i)
+	{
+		snprintf(buffer, sizeof(buffer), "customer/%010d", keys[i]);
+		tree.insert(std::pair<string,int>(buffer, keys[i]));
+		text += buffer;
+		offsets[i + 1] = text.size();
+	}
+
+	long long checksum = 0;
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		string_view token(text.data() + offsets[i], offsets[i + 1] - offsets[i]);
+		checksum += tree.find(string(token))->second;
+	}
+	report("find (string from view)", n, secondsSince(start));
+
+	start = Clock::now();
+	for(size_t i = 0; i < n; ++i)
+	{
+		string_view token(text.data() + offsets[i], offsets[i + 1] - offsets[i]);
+		checksum += tree.find(token)->second;
+	}
+	report("find (string_view)", n, secondsSince(start));
+
+	cout << "  checksum " << checksum << endl;
+}
+
+// Large values: inserting a copy of a prepared pair against moving it in and building the value in
+// the node with try_emplace. Then replacing every value, by copy and by insert_or_assign with a move.
+static void runLargeValues(const vector<int>& keys, size_t valueBytes)
+{
+	cout << "AVLTree<int,vector<char> > with " << valueBytes << " byte values" << endl;
+	size_t n = keys.size();
+	long long checksum = 0;
+	{
+		AVLTree<int, vector<char> > tree;
+		vector<std::pair<int, vector<char> > > items(n);
+		for(size_t i = 0; i < n; ++i)
+		{
+			items[i] = std::pair<int, vector<char> >(keys[i], vector<char>(valueBytes, 'a'));
+		}
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			tree.insert(items[i]);
+		}
+		report("insert (copy)", n, secondsSince(start));
+
+		start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			tree.insert(items[i]);
+		}
+		report("replace (copy)", n, secondsSince(start));
+	}
+	{
+		AVLTree<int, vector<char> > tree;
+		vector<std::pair<int, vector<char> > > items(n);
+		for(size_t i = 0; i < n; ++i)
+		{
+			items[i] = std::pair<int, vector<char> >(keys[i], vector<char>(valueBytes, 'a'));
+		}
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			checksum += tree.insert(std::move(items[i])).second;
+		}
+		report("insert (move)", n, secondsSince(start));
+
+		vector<vector<char> > values(n, vector<char>(valueBytes, 'b'));
+		start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			checksum += tree.insert_or_assign(keys[i], std::move(values[i])).second;
+		}
+		report("replace (insert_or_assign, move)", n, secondsSince(start));
+	}
+	{
+		AVLTree<int, vector<char> > tree;
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			checksum += tree.try_emplace(keys[i], valueBytes, 'a').second;
+		}
+		report("insert (try_emplace)", n, secondsSince(start));
+	}
+	cout << "  checksum " << checksum << endl;
+}
+
+// Keys that arrive in increasing order, like timestamps: strictly ascending through plain insert, which
+// appends past the largest key, and through insert with the end() hint; strictly descending with and
+// without the begin() hint; and nearly ascending, with every few keys swapped, through insert with the
+// previous position as the hint. A descent from the root for every key is the baseline.
+static void runAscending(size_t n)
+{
+	cout << "AVLTree<int,int> ascending ingest" << endl;
+	vector<int> nearly(n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		nearly[i] = (int)i;
+	}
+	for(size_t i = 0; i + 1 < n; i += 7)
+	{
+		swap(nearly[i], nearly[i + 1]);
+	}
+	long long checksum = 0;
+	{
+		AVLTree<int,int> tree;
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			tree.insert(std::pair<int,int>((int)i, (int)i));
+		}
+		report("insert (ascending)", n, secondsSince(start));
+		checksum += tree.rbegin()->first;
+	}
+	{
+		AVLTree<int,int> tree;
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			tree.insert(tree.cend(), std::pair<int,int>((int)i, (int)i));
+		}
+		report("hinted insert (ascending, end())", n, secondsSince(start));
+		checksum += tree.rbegin()->first;
+	}
+	{
+		AVLTree<int,int> tree;
+		Clock::time_point start = Clock::now();
+		for(size_t i = n; i-- > 0; )
+		{
+			tree.insert(std::pair<int,int>((int)i, (int)i));
+		}
+		report("insert (descending)", n, secondsSince(start));
+		checksum += tree.begin()->first;
+	}
+	{
+		AVLTree<int,int> tree;
+		Clock::time_point start = Clock::now();
+		for(size_t i = n; i-- > 0; )
+		{
+			tree.insert(tree.cbegin(), std::pair<int,int>((int)i, (int)i));
+		}
+		report("hinted insert (descending, begin())", n, secondsSince(start));
+		checksum += tree.begin()->first;
+	}
+	{
+		AVLTree<int,int> tree;
+		AVLTree<int,int>::iterator hint = tree.end();
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			hint = tree.insert(hint, std::pair<int,int>(nearly[i], nearly[i]));
+		}
+		report("hinted insert (nearly ascending)", n, secondsSince(start));
+		checksum += tree.rbegin()->first;
+	}
+	{
+		AVLTree<int,int> tree;
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			tree.insert(std::pair<int,int>(nearly[i], nearly[i]));
+		}
+		report("insert (nearly ascending, no hint)", n, secondsSince(start));
+		checksum += tree.rbegin()->first;
+	}
+	cout << "  checksum " << checksum << endl;
+}
+
+// A cursor wandering over a large tree of string keys, inserting, finding and removing keys a few places
+// from the last ones, once from the root each time and once through a Finger. The keys share a long
+// prefix, so each comparison the finger saves costs a scan.
+static void runFinger(size_t n)
+{
+	cout << "AVLTree<string,int> local walk" << endl;
+	vector<std::pair<string,int> > base(n);
+	vector<string> between(n);
+	char buffer[32];
+	for(size_t i = 0; i < n; ++i)
+	{
+		snprintf(buffer, sizeof(buffer), "customer/%010d", (int)(2 * i));
+		base[i] = std::pair<string,int>(buffer, (int)i);
+		snprintf(buffer, sizeof(buffer), "customer/%010d", (int)(2 * i + 1));
+		between[i] = buffer;
+	}
+	vector<size_t> walk(n);
+	mt19937 rng(7);
+	long long position = (long long)n / 2;
+	for(size_t i = 0; i < n; ++i)
+	{
+		position += (long long)(rng() % 33) - 16;
+		position = max(0LL, min((long long)n - 1, position));
+		walk[i] = (size_t)position;
+	}
+	long long checksum = 0;
+	{
+		AVLTree<string,int> tree;
+		tree.assign_sorted(base.begin(), base.end());
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			tree.insert(std::pair<string,int>(between[walk[i]], 0));
+			checksum += tree.find(base[walk[i]].first)->second;
+			tree.remove(between[walk[i]]);
+		}
+		report("insert, find, remove from the root", 3 * n, secondsSince(start));
+	}
+	{
+		AVLTree<string,int> tree;
+		tree.assign_sorted(base.begin(), base.end());
+		AVLTree<string,int>::Finger finger = tree.finger();
+		Clock::time_point start = Clock::now();
+		for(size_t i = 0; i < n; ++i)
+		{
+			finger.insert(std::pair<string,int>(between[walk[i]], 0));
+			finger.seek(base[walk[i]].first);
+			checksum += finger.position()->second;
+			finger.remove(between[walk[i]]);
+		}
+		report("insert, find, remove at a finger", 3 * n, secondsSince(start));
+	}
+	cout << "  checksum " << checksum << endl;
+}
+
+int main(int argc, char* argv[]) {
+
+size_t n = 1000000;
+if(argc > 1)
+{
+	n = strtoul(argv[1], NULL, 10);
+}
+
+vector<int> keys(n);
+for(size_t i = 0; i < n; ++i)
+{
+	keys[i] = (int)(2 * i);
+}
+mt19937 rng(12345);
+shuffle(keys.begin(), keys.end(), rng);
+
+cout << "node bytes: AVLNode<int,int> " << sizeof(AVLNode<int,int>)
+	<< ", IndexedAVLNode<int,int> " << sizeof(IndexedAVLNode<int,int>)
+	<< ", AVLNode<int,int,SubtreeSize> " << sizeof(AVLNode<int,int,SubtreeSize>)
+	<< ", AVLNode<int,int,ThreadedLinks<> > " << sizeof(AVLNode<int,int,ThreadedLinks<> >) << endl;
+
+runTree<AVLTree<int,int> >("AVLTree<int,int>", keys);
+runTree<ThreadedAVLTree<int,int> >("ThreadedAVLTree<int,int>", keys);
+runTree<IndexedAVLTree<int,int> >("IndexedAVLTree<int,int>", keys);
+runTree<OrderStatisticAVLTree<int,int> >("OrderStatisticAVLTree<int,int>", keys);
+runTree<PersistentAVLTree<int,int> >("PersistentAVLTree<int,int>", keys);
+runTree<BPlusTree<int,int,16> >("BPlusTree<int,int,16>", keys);
+runTree<BPlusTree<int,int> >("BPlusTree<int,int,32>", keys);
+runTree<BPlusTree<int,int,64> >("BPlusTree<int,int,64>", keys);
+runSelect(keys);
+runFrozen(keys);
+runStrings<AVLTree<string,int> >("AVLTree<string,int>", keys);
+runStrings<AVLTree<string,int,SlabNodeAllocator,AVLNode<string,int>,StringLess> >("AVLTree<string,int> with StringLess", keys);
+runStringViews(keys);
+runAscending(n);
+runFinger(n);
+runLargeValues(vector<int>(keys.begin(), keys.begin() + n / 10), 4096);
+
+return 0;
+}
@@ -0,0 +1,709 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+
+#include <cstddef>
+#include <utility>
+
+/**
+* A balanced search tree with wide nodes, with the same interface as AVLTree for the operations they
+* share. Every node holds up to MaxKeys sorted keys in one contiguous array, so a lookup costs one node,
+* a few cache lines, per level instead of one cache miss per key compared, and the tree is about
+* log(MaxKeys) times shallower than a binary one. The items live in the leaves, which are chained in key
+* order for iteration. Inner nodes only hold separator keys and child pointers.
+*
+* Nodes are split when they fill up and borrow from or merge with a sibling when they run low, instead
+* of rotating. Both are done top down on the way to the leaf: insert splits every full node it is about
+* to enter and remove tops up every node it is about to enter that is at the minimum, so a change never
+* has to travel back up. Key and Value have to be default constructible.
+*/
+template <typename Key, typename Value, std::size_t MaxKeys = 32>
+class BPlusTree
+{
+private:
+    struct Node;
+    struct LeafNode;
+    struct InnerNode;
+
+public:
+    static_assert(MaxKeys >= 8 && MaxKeys <= 64 && MaxKeys % 2 == 0, "nodes hold an even number of 8 to 64 keys");
+
+    /**
+    * Forward iterator over the leaf chain. Any insert or remove invalidates it.
+    */
+    class iterator
+    {
+        public:
+            iterator();
+
+            std::pair<Key, Value>& operator*() const;
+            std::pair<Key, Value>* operator->() const;
+            bool operator==(const iterator& rhs) const;
+            bool operator!=(const iterator& rhs) const;
+            iterator& operator++();
+
+        private:
+            friend class BPlusTree<Key, Value, MaxKeys>;
+            iterator(LeafNode* leaf, std::size_t index);
+
+            LeafNode* mLeaf;
+            std::size_t mIndex;
+    };
+
+    BPlusTree();
+    ~BPlusTree();
+
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+
+    std::size_t size() const;
+    bool empty() const;
+    // Checks the node occupancy, the key order and that every leaf is at the same depth.
+    bool isBalanced() const;
+
+private:
+    BPlusTree(const BPlusTree&);
+    BPlusTree& operator=(const BPlusTree&);
+
+    struct Node
+    {
+        std::size_t mCount;
+    };
+
+    struct LeafNode : public Node
+    {
+        LeafNode* mNext;
+        std::pair<Key, Value> mItems[MaxKeys];
+    };
+
+    // mChildren[i] holds the keys in [mKeys[i - 1], mKeys[i]).
+    struct InnerNode : public Node
+    {
+        Key mKeys[MaxKeys];
+        Node* mChildren[MaxKeys + 1];
+    };
+
+    static std::size_t lowerIndex(const LeafNode* leaf, const Key& key);
+    static std::size_t childIndex(const InnerNode* inner, const Key& key);
+    LeafNode* findLeaf(const Key& key) const;
+
+    void splitChild(InnerNode* parent, std::size_t index, bool leafChildren);
+    Node* topUpChild(InnerNode* parent, std::size_t index, bool leafChildren);
+    void mergeChildren(InnerNode* parent, std::size_t index, bool leafChildren);
+
+    void destroy(Node* node, std::size_t height);
+    bool checkNode(const Node* node, std::size_t height, const Key* low, const Key* high) const;
+
+    // A node that is not the root never holds fewer keys than this.
+    static const std::size_t kMinKeys = MaxKeys / 2 - 1;
+
+    Node* mRoot;
+    // Number of inner levels above the leaves, 0 while the root is a leaf.
+    std::size_t mHeight;
+    std::size_t mSize;
+};
+
+/*
+--------------------------------------------------------
+Begin implementations for the BPlusTree::iterator class.
+--------------------------------------------------------
+*/
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+BPlusTree<Key, Value, MaxKeys>::iterator::iterator()
+    : mLeaf(NULL)
+    , mIndex(0)
+{
+
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+BPlusTree<Key, Value, MaxKeys>::iterator::iterator(LeafNode* leaf, std::size_t index)
+    : mLeaf(leaf)
+    , mIndex(index)
+{
+    //a position past the last item of a leaf is the first item of the next one
+    if(mLeaf != NULL && mIndex == mLeaf->mCount)
+    {
+        mLeaf = mLeaf->mNext;
+        mIndex = 0;
+    }
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+std::pair<Key, Value>& BPlusTree<Key, Value, MaxKeys>::iterator::operator*() const
+{
+    return mLeaf->mItems[mIndex];
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+std::pair<Key, Value>* BPlusTree<Key, Value, MaxKeys>::iterator::operator->() const
+{
+    return &mLeaf->mItems[mIndex];
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+bool BPlusTree<Key, Value, MaxKeys>::iterator::operator==(const iterator& rhs) const
+{
+    return mLeaf == rhs.mLeaf && mIndex == rhs.mIndex;
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+bool BPlusTree<Key, Value, MaxKeys>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::iterator& BPlusTree<Key, Value, MaxKeys>::iterator::operator++()
+{
+    ++mIndex;
+    if(mIndex == mLeaf->mCount)
+    {
+        mLeaf = mLeaf->mNext;
+        mIndex = 0;
+    }
+    return *this;
+}
+
+/*
+------------------------------------------------------
+End implementations for the BPlusTree::iterator class.
+------------------------------------------------------
+*/
+
+/*
+----------------------------------------------
+Begin implementations for the BPlusTree class.
+----------------------------------------------
+*/
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+BPlusTree<Key, Value, MaxKeys>::BPlusTree()
+    : mRoot(NULL)
+    , mHeight(0)
+    , mSize(0)
+{
+
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+BPlusTree<Key, Value, MaxKeys>::~BPlusTree()
+{
+    clear();
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+void BPlusTree<Key, Value, MaxKeys>::clear()
+{
+    if(mRoot != NULL)
+    {
+        destroy(mRoot, mHeight);
+    }
+    mRoot = NULL;
+    mHeight = 0;
+    mSize = 0;
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+void BPlusTree<Key, Value, MaxKeys>::destroy(Node* node, std::size_t height)
+{
+    if(height == 0)
+    {
+        delete static_cast<LeafNode*>(node);
+        return;
+    }
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    for(std::size_t i = 0; i <= inner->mCount; ++i)
+    {
+        destroy(inner->mChildren[i], height - 1);
+    }
+    delete inner;
+}
+
+/**
+* Index of the first item in the leaf whose key is not less than key. The binary search moves its base
+* with a select instead of a branch, and always takes the same number of steps for a given count.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+std::size_t BPlusTree<Key, Value, MaxKeys>::lowerIndex(const LeafNode* leaf, const Key& key)
+{
+    std::size_t count = leaf->mCount;
+    if(count == 0)
+    {
+        return 0;
+    }
+    const std::pair<Key, Value>* base = leaf->mItems;
+    while(count > 1)
+    {
+        std::size_t half = count / 2;
+        base = base[half - 1].first < key ? base + half : base;
+        count -= half;
+    }
+    return (std::size_t)(base - leaf->mItems) + (base->first < key);
+}
+
+/**
+* Index of the child whose range holds key: the number of separators that are not greater than key.
+* Same search as lowerIndex.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+std::size_t BPlusTree<Key, Value, MaxKeys>::childIndex(const InnerNode* inner, const Key& key)
+{
+    std::size_t count = inner->mCount;
+    const Key* base = inner->mKeys;
+    while(count > 1)
+    {
+        std::size_t half = count / 2;
+        base = key < base[half - 1] ? base : base + half;
+        count -= half;
+    }
+    return (std::size_t)(base - inner->mKeys) + !(key < *base);
+}
+
+/**
+* Leaf whose range holds key, or NULL for an empty tree.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::LeafNode* BPlusTree<Key, Value, MaxKeys>::findLeaf(const Key& key) const
+{
+    Node* node = mRoot;
+    for(std::size_t level = mHeight; level > 0; --level)
+    {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        node = inner->mChildren[childIndex(inner, key)];
+    }
+    return static_cast<LeafNode*>(node);
+}
+
+/**
+* Splits the full child at index in two and hangs the upper half to its right. A leaf keeps its lower
+* half and copies the first key of the upper half up as the separator. An inner node moves its middle
+* key up instead. parent must not be full.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+void BPlusTree<Key, Value, MaxKeys>::splitChild(InnerNode* parent, std::size_t index, bool leafChildren)
+{
+    Key separator;
+    Node* upper;
+    if(leafChildren)
+    {
+        LeafNode* leaf = static_cast<LeafNode*>(parent->mChildren[index]);
+        LeafNode* right = new LeafNode();
+        std::size_t keep = MaxKeys / 2;
+        right->mCount = MaxKeys - keep;
+        for(std::size_t i = 0; i < right->mCount; ++i)
+        {
+            right->mItems[i] = leaf->mItems[keep + i];
+        }
+        leaf->mCount = keep;
+        right->mNext = leaf->mNext;
+        leaf->mNext = right;
+        separator = right->mItems[0].first;
+        upper = right;
+    }
+    else
+    {
+        InnerNode* inner = static_cast<InnerNode*>(parent->mChildren[index]);
+        InnerNode* right = new InnerNode();
+        std::size_t keep = MaxKeys / 2;
+        separator = inner->mKeys[keep];
+        right->mCount = MaxKeys - keep - 1;
+        for(std::size_t i = 0; i < right->mCount; ++i)
+        {
+            right->mKeys[i] = inner->mKeys[keep + 1 + i];
+        }
+        for(std::size_t i = 0; i <= right->mCount; ++i)
+        {
+            right->mChildren[i] = inner->mChildren[keep + 1 + i];
+        }
+        inner->mCount = keep;
+        upper = right;
+    }
+    for(std::size_t i = parent->mCount; i > index; --i)
+    {
+        parent->mKeys[i] = parent->mKeys[i - 1];
+        parent->mChildren[i + 1] = parent->mChildren[i];
+    }
+    parent->mKeys[index] = separator;
+    parent->mChildren[index + 1] = upper;
+    ++parent->mCount;
+}
+
+/**
+* Inserts the pair, or replaces the value if the key is already there. A full root is split first,
+* which is the only way the tree grows taller, and every full node on the way down is split before the
+* descent enters it, so the leaf always has room.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+void BPlusTree<Key, Value, MaxKeys>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    if(mRoot == NULL)
+    {
+        LeafNode* leaf = new LeafNode();
+        leaf->mCount = 0;
+        leaf->mNext = NULL;
+        mRoot = leaf;
+    }
+    if(mRoot->mCount == MaxKeys)
+    {
+        InnerNode* root = new InnerNode();
+        root->mCount = 0;
+        root->mChildren[0] = mRoot;
+        splitChild(root, 0, mHeight == 0);
+        mRoot = root;
+        ++mHeight;
+    }
+    Node* node = mRoot;
+    for(std::size_t level = mHeight; level > 0; --level)
+    {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        std::size_t index = childIndex(inner, keyValuePair.first);
+        if(inner->mChildren[index]->mCount == MaxKeys)
+        {
+            splitChild(inner, index, level == 1);
+            //the key may belong to the new upper half
+            index += !(keyValuePair.first < inner->mKeys[index]);
+        }
+        node = inner->mChildren[index];
+    }
+
+    LeafNode* leaf = static_cast<LeafNode*>(node);
+    std::size_t index = lowerIndex(leaf, keyValuePair.first);
+    if(index < leaf->mCount && !(keyValuePair.first < leaf->mItems[index].first))
+    {
+        leaf->mItems[index].second = keyValuePair.second;
+        return;
+    }
+    for(std::size_t i = leaf->mCount; i > index; --i)
+    {
+        leaf->mItems[i] = leaf->mItems[i - 1];
+    }
+    leaf->mItems[index] = keyValuePair;
+    ++leaf->mCount;
+    ++mSize;
+}
+
+/**
+* Makes sure the child at index holds more than the minimum before the descent enters it, by borrowing
+* an entry from a sibling that can spare one or else merging with a sibling. Returns the node that now
+* covers the child's range. The parent holds more than the minimum itself, or is the root.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::Node* BPlusTree<Key, Value, MaxKeys>::topUpChild(InnerNode* parent, std::size_t index, bool leafChildren)
+{
+    Node* child = parent->mChildren[index];
+    if(child->mCount > kMinKeys)
+    {
+        return child;
+    }
+    Node* left = index > 0 ? parent->mChildren[index - 1] : NULL;
+    Node* right = index < parent->mCount ? parent->mChildren[index + 1] : NULL;
+    if(left != NULL && left->mCount > kMinKeys)
+    {
+        //rotate the left sibling's last entry over
+        if(leafChildren)
+        {
+            LeafNode* leaf = static_cast<LeafNode*>(child);
+            LeafNode* from = static_cast<LeafNode*>(left);
+            for(std::size_t i = leaf->mCount; i > 0; --i)
+            {
+                leaf->mItems[i] = leaf->mItems[i - 1];
+            }
+            leaf->mItems[0] = from->mItems[from->mCount - 1];
+            parent->mKeys[index - 1] = leaf->mItems[0].first;
+        }
+        else
+        {
+            InnerNode* inner = static_cast<InnerNode*>(child);
+            InnerNode* from = static_cast<InnerNode*>(left);
+            inner->mChildren[inner->mCount + 1] = inner->mChildren[inner->mCount];
+            for(std::size_t i = inner->mCount; i > 0; --i)
+            {
+                inner->mKeys[i] = inner->mKeys[i - 1];
+                inner->mChildren[i] = inner->mChildren[i - 1];
+            }
+            inner->mKeys[0] = parent->mKeys[index - 1];
+            inner->mChildren[0] = from->mChildren[from->mCount];
+            parent->mKeys[index - 1] = from->mKeys[from->mCount - 1];
+        }
+        ++child->mCount;
+        --left->mCount;
+        return child;
+    }
+    if(right != NULL && right->mCount > kMinKeys)
+    {
+        //rotate the right sibling's first entry over
+        if(leafChildren)
+        {
+            LeafNode* leaf = static_cast<LeafNode*>(child);
+            LeafNode* from = static_cast<LeafNode*>(right);
+            leaf->mItems[leaf->mCount] = from->mItems[0];
+            for(std::size_t i = 0; i + 1 < from->mCount; ++i)
+            {
+                from->mItems[i] = from->mItems[i + 1];
+            }
+            parent->mKeys[index] = from->mItems[0].first;
+        }
+        else
+        {
+            InnerNode* inner = static_cast<InnerNode*>(child);
+            InnerNode* from = static_cast<InnerNode*>(right);
+            inner->mKeys[inner->mCount] = parent->mKeys[index];
+            inner->mChildren[inner->mCount + 1] = from->mChildren[0];
+            parent->mKeys[index] = from->mKeys[0];
+            for(std::size_t i = 0; i + 1 < from->mCount; ++i)
+            {
+                from->mKeys[i] = from->mKeys[i + 1];
+            }
+            for(std::size_t i = 0; i < from->mCount; ++i)
+            {
+                from->mChildren[i] = from->mChildren[i + 1];
+            }
+        }
+        ++child->mCount;
+        --right->mCount;
+        return child;
+    }
+    //neither sibling can spare anything, so the two fit in one node
+    if(left != NULL)
+    {
+        mergeChildren(parent, index - 1, leafChildren);
+        return left;
+    }
+    mergeChildren(parent, index, leafChildren);
+    return child;
+}
+
+/**
+* Moves everything of the child at index + 1 into the child at index and drops the separator between
+* them from the parent. An inner merge pulls the separator down between the two key lists.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+void BPlusTree<Key, Value, MaxKeys>::mergeChildren(InnerNode* parent, std::size_t index, bool leafChildren)
+{
+    if(leafChildren)
+    {
+        LeafNode* into = static_cast<LeafNode*>(parent->mChildren[index]);
+        LeafNode* from = static_cast<LeafNode*>(parent->mChildren[index + 1]);
+        for(std::size_t i = 0; i < from->mCount; ++i)
+        {
+            into->mItems[into->mCount + i] = from->mItems[i];
+        }
+        into->mCount += from->mCount;
+        into->mNext = from->mNext;
+        delete from;
+    }
+    else
+    {
+        InnerNode* into = static_cast<InnerNode*>(parent->mChildren[index]);
+        InnerNode* from = static_cast<InnerNode*>(parent->mChildren[index + 1]);
+        into->mKeys[into->mCount] = parent->mKeys[index];
+        for(std::size_t i = 0; i < from->mCount; ++i)
+        {
+            into->mKeys[into->mCount + 1 + i] = from->mKeys[i];
+        }
+        for(std::size_t i = 0; i <= from->mCount; ++i)
+        {
+            into->mChildren[into->mCount + 1 + i] = from->mChildren[i];
+        }
+        into->mCount += from->mCount + 1;
+        delete from;
+    }
+    for(std::size_t i = index; i + 1 < parent->mCount; ++i)
+    {
+        parent->mKeys[i] = parent->mKeys[i + 1];
+        parent->mChildren[i + 1] = parent->mChildren[i + 2];
+    }
+    --parent->mCount;
+}
+
+/**
+* Removes the key if it is there. Every node the descent enters is topped up first, so the leaf can
+* lose an item without running low. A root left without separators is replaced by its only child,
+* which is the only way the tree gets shorter.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+void BPlusTree<Key, Value, MaxKeys>::remove(const Key& key)
+{
+    if(mRoot == NULL)
+    {
+        return;
+    }
+    Node* node = mRoot;
+    for(std::size_t level = mHeight; level > 0; --level)
+    {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        node = topUpChild(inner, childIndex(inner, key), level == 1);
+        if(inner == mRoot && inner->mCount == 0)
+        {
+            mRoot = node;
+            --mHeight;
+            delete inner;
+        }
+    }
+
+    LeafNode* leaf = static_cast<LeafNode*>(node);
+    std::size_t index = lowerIndex(leaf, key);
+    if(index == leaf->mCount || key < leaf->mItems[index].first)
+    {
+        return;
+    }
+    for(std::size_t i = index; i + 1 < leaf->mCount; ++i)
+    {
+        leaf->mItems[i] = leaf->mItems[i + 1];
+    }
+    --leaf->mCount;
+    --mSize;
+    if(mSize == 0)
+    {
+        clear();
+    }
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::iterator BPlusTree<Key, Value, MaxKeys>::begin() const
+{
+    if(mRoot == NULL)
+    {
+        return end();
+    }
+    Node* node = mRoot;
+    for(std::size_t level = mHeight; level > 0; --level)
+    {
+        node = static_cast<InnerNode*>(node)->mChildren[0];
+    }
+    return iterator(static_cast<LeafNode*>(node), 0);
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::iterator BPlusTree<Key, Value, MaxKeys>::end() const
+{
+    return iterator();
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::iterator BPlusTree<Key, Value, MaxKeys>::find(const Key& key) const
+{
+    if(mRoot == NULL)
+    {
+        return end();
+    }
+    LeafNode* leaf = findLeaf(key);
+    std::size_t index = lowerIndex(leaf, key);
+    if(index == leaf->mCount || key < leaf->mItems[index].first)
+    {
+        return end();
+    }
+    return iterator(leaf, index);
+}
+
+/**
+* Iterator to the first key that is not less than key. It may sit in the next leaf over.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+typename BPlusTree<Key, Value, MaxKeys>::iterator BPlusTree<Key, Value, MaxKeys>::lower_bound(const Key& key) const
+{
+    if(mRoot == NULL)
+    {
+        return end();
+    }
+    LeafNode* leaf = findLeaf(key);
+    return iterator(leaf, lowerIndex(leaf, key));
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+std::size_t BPlusTree<Key, Value, MaxKeys>::size() const
+{
+    return mSize;
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+bool BPlusTree<Key, Value, MaxKeys>::empty() const
+{
+    return mSize == 0;
+}
+
+template<typename Key, typename Value, std::size_t MaxKeys>
+bool BPlusTree<Key, Value, MaxKeys>::isBalanced() const
+{
+    if(mRoot == NULL)
+    {
+        return mSize == 0;
+    }
+    if(!checkNode(mRoot, mHeight, NULL, NULL))
+    {
+        return false;
+    }
+    //the leaf chain has to visit every item in order
+    std::size_t count = 0;
+    const Key* previous = NULL;
+    for(iterator it = begin(); it != end(); ++it)
+    {
+        if(previous != NULL && !(*previous < it->first))
+        {
+            return false;
+        }
+        previous = &it->first;
+        ++count;
+    }
+    return count == mSize;
+}
+
+/**
+* Helper function for isBalanced. Every key under node has to lie in [low, high), and every node but the
+* root has to hold at least the minimum.
+*/
+template<typename Key, typename Value, std::size_t MaxKeys>
+bool BPlusTree<Key, Value, MaxKeys>::checkNode(const Node* node, std::size_t height, const Key* low, const Key* high) const
+{
+    if(node->mCount > MaxKeys || (node != mRoot && node->mCount < kMinKeys))
+    {
+        return false;
+    }
+    if(height == 0)
+    {
+        const LeafNode* leaf = static_cast<const LeafNode*>(node);
+        for(std::size_t i = 0; i < leaf->mCount; ++i)
+        {
+            const Key& key = leaf->mItems[i].first;
+            if((low != NULL && key < *low) || (high != NULL && !(key < *high)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    const InnerNode* inner = static_cast<const InnerNode*>(node);
+    if(inner->mCount == 0)
+    {
+        return false;
+    }
+    for(std::size_t i = 0; i <= inner->mCount; ++i)
+    {
+        const Key* childLow = i == 0 ? low : &inner->mKeys[i - 1];
+        const Key* childHigh = i == inner->mCount ? high : &inner->mKeys[i];
+        if(i > 0 && i < inner->mCount && !(inner->mKeys[i - 1] < inner->mKeys[i]))
+        {
+            return false;
+        }
+        if(!checkNode(inner->mChildren[i], height - 1, childLow, childHigh))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+--------------------------------------------
+End implementations for the BPlusTree class.
+--------------------------------------------
+*/
+
+#endif
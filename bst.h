@@ -5,17 +5,28 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <type_traits>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include "node_allocator.h"
+#include "key_compare.h"
 
 /**
-* A templated class for a Node in a search tree. The getters for parent/left/right are virtual so that they
-* can be overridden for future kinds of search trees, such as Red Black trees, Splay trees, and AVL trees.
+* A templated base class for a Node in a search tree. Each kind of node passes itself in as Derived, so the
+* getters for parent/left/right return the right node type for future kinds of search trees, such as Red Black
+* trees, Splay trees, and AVL trees, without being virtual. Nodes therefore carry no vtable pointer and every
+* link access in the trees is a direct, inlinable load.
 */
-template <typename Key, typename Value>
-class Node
+template <typename Key, typename Value, typename Derived>
+class BasicNode
 {
 public:
-	Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-	virtual ~Node();
+	BasicNode(const Key& key, const Value& value, Derived* parent);
+	// Builds the item in place from args, as std::pair<Key, Value> would be built from them.
+	template<typename... Args>
+	BasicNode(std::in_place_t, Derived* parent, Args&&... args);
+	~BasicNode();
 
 	const std::pair<Key, Value>& getItem() const;
 	std::pair<Key, Value>& getItem();
@@ -24,33 +35,88 @@ public:
 	Key& getKey();
 	Value& getValue();
 
-	virtual Node<Key, Value>* getParent() const;
-	virtual Node<Key, Value>* getLeft() const;
-	virtual Node<Key, Value>* getRight() const;
+	Derived* getParent() const;
+	Derived* getLeft() const;
+	Derived* getRight() const;
 
-	void setParent(Node<Key, Value>* parent);
-	void setLeft(Node<Key, Value>* left);
-	void setRight(Node<Key, Value>* right);
+	void setParent(Derived* parent);
+	void setLeft(Derived* left);
+	void setRight(Derived* right);
 	void setValue(const Value &value);
 
 protected:
 	std::pair<Key, Value> mItem;
-	Node<Key, Value>* mParent;
-	Node<Key, Value>* mLeft;
-	Node<Key, Value>* mRight;
+	Derived* mParent;
+	Derived* mLeft;
+	Derived* mRight;
+};
+
+/**
+* The node of a plain BinarySearchTree, which needs nothing beyond the item and the links.
+*/
+template <typename Key, typename Value>
+class Node : public BasicNode<Key, Value, Node<Key, Value> >
+{
+public:
+	Node(const Key& key, const Value& value, Node<Key, Value>* parent);
+	template<typename... Args>
+	Node(std::in_place_t, Node<Key, Value>* parent, Args&&... args);
+};
+
+/**
+* Tells whether a node type keeps the number of nodes in its subtree, through a getSize() member.
+* Trees use this to turn positional operations into O(log n) descents when the size is there.
+*/
+template <typename NodeType, typename = void>
+struct NodeHasSize : std::false_type
+{
+};
+
+template <typename NodeType>
+struct NodeHasSize<NodeType, std::void_t<decltype(std::declval<const NodeType&>().getSize())> > : std::true_type
+{
+};
+
+/**
+* Tells whether the extra data a node type declares through an AugmentType typedef, if any, can be dropped
+* without running its destructor. Node destructors themselves are user provided and never trivial.
+*/
+template <typename NodeType, typename = void>
+struct NodeAugmentIsTrivial : std::true_type
+{
+};
+
+template <typename NodeType>
+struct NodeAugmentIsTrivial<NodeType, std::void_t<typename NodeType::AugmentType> >
+	: std::is_trivially_destructible<typename NodeType::AugmentType>
+{
+};
+
+/**
+* Tells whether a node type links every node to its in-order neighbours, through getNextLink() and
+* getPrevLink(). Iterators then step along those links instead of walking the tree.
+*/
+template <typename NodeType, typename = void>
+struct NodeHasThreads : std::false_type
+{
+};
+
+template <typename NodeType>
+struct NodeHasThreads<NodeType, std::void_t<decltype(std::declval<const NodeType&>().getNextLink())> > : std::true_type
+{
 };
 
 /*
-	-----------------------------------------
-	Begin implementations for the Node class.
-	-----------------------------------------
+	-------------------------------------------
+	Begin implementations for the node classes.
+	-------------------------------------------
 */
 
 /**
 * Explicit constructor for a node.
 */
-template<typename Key, typename Value>
-Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent)
+template<typename Key, typename Value, typename Derived>
+BasicNode<Key, Value, Derived>::BasicNode(const Key& key, const Value& value, Derived* parent)
 	: mItem(key, value)
 	, mParent(parent)
 	, mLeft(NULL)
@@ -59,21 +125,54 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* Constructor for a node whose item is built in place, so that a key or value can be moved in or made
+* from its own constructor arguments instead of copied.
+*/
+template<typename Key, typename Value, typename Derived>
+template<typename... Args>
+BasicNode<Key, Value, Derived>::BasicNode(std::in_place_t, Derived* parent, Args&&... args)
+	: mItem(std::forward<Args>(args)...)
+	, mParent(parent)
+	, mLeft(NULL)
+	, mRight(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
 * are freed within the deleteAll() helper method in the BinarySearchTree.
 */
+template<typename Key, typename Value, typename Derived>
+BasicNode<Key, Value, Derived>::~BasicNode()
+{
+}
+
+/**
+* Constructor for a plain node.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent)
+	: BasicNode<Key, Value, Node<Key, Value> >(key, value, parent)
+{
+
+}
+
 template<typename Key, typename Value>
-Node<Key, Value>::~Node()
+template<typename... Args>
+Node<Key, Value>::Node(std::in_place_t, Node<Key, Value>* parent, Args&&... args)
+	: BasicNode<Key, Value, Node<Key, Value> >(std::in_place, parent, std::forward<Args>(args)...)
 {
+
 }
 
 /**
 * A const getter for the item.
 */
-template<typename Key, typename Value>
-const std::pair<Key, Value>& Node<Key, Value>::getItem() const
+template<typename Key, typename Value, typename Derived>
+const std::pair<Key, Value>& BasicNode<Key, Value, Derived>::getItem() const
 {
 	return mItem;
 }
@@ -81,8 +180,8 @@ const std::pair<Key, Value>& Node<Key, Value>::getItem() const
 /**
 * A non-const getter for the item.
 */
-template<typename Key, typename Value>
-std::pair<Key, Value>& Node<Key, Value>::getItem()
+template<typename Key, typename Value, typename Derived>
+std::pair<Key, Value>& BasicNode<Key, Value, Derived>::getItem()
 {
 	return mItem;
 }
@@ -90,8 +189,8 @@ std::pair<Key, Value>& Node<Key, Value>::getItem()
 /**
 * A const getter for the key.
 */
-template<typename Key, typename Value>
-const Key& Node<Key, Value>::getKey() const
+template<typename Key, typename Value, typename Derived>
+const Key& BasicNode<Key, Value, Derived>::getKey() const
 {
 	return mItem.first;
 }
@@ -99,8 +198,8 @@ const Key& Node<Key, Value>::getKey() const
 /**
 * A const getter for the value.
 */
-template<typename Key, typename Value>
-const Value& Node<Key, Value>::getValue() const
+template<typename Key, typename Value, typename Derived>
+const Value& BasicNode<Key, Value, Derived>::getValue() const
 {
 	return mItem.second;
 }
@@ -108,8 +207,8 @@ const Value& Node<Key, Value>::getValue() const
 /**
 * A non-const getter for the key.
 */
-template<typename Key, typename Value>
-Key& Node<Key, Value>::getKey()
+template<typename Key, typename Value, typename Derived>
+Key& BasicNode<Key, Value, Derived>::getKey()
 {
 	return mItem.first;
 }
@@ -117,35 +216,35 @@ Key& Node<Key, Value>::getKey()
 /**
 * A non-const getter for the value.
 */
-template<typename Key, typename Value>
-Value& Node<Key, Value>::getValue()
+template<typename Key, typename Value, typename Derived>
+Value& BasicNode<Key, Value, Derived>::getValue()
 {
 	return mItem.second;
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* Node<Key, Value>::getParent() const
+template<typename Key, typename Value, typename Derived>
+Derived* BasicNode<Key, Value, Derived>::getParent() const
 {
 	return mParent;
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* Node<Key, Value>::getLeft() const
+template<typename Key, typename Value, typename Derived>
+Derived* BasicNode<Key, Value, Derived>::getLeft() const
 {
 	return mLeft;
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* Node<Key, Value>::getRight() const
+template<typename Key, typename Value, typename Derived>
+Derived* BasicNode<Key, Value, Derived>::getRight() const
 {
 	return mRight;
 }
@@ -153,8 +252,8 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
 /**
 * A setter for setting the parent of a node.
 */
-template<typename Key, typename Value>
-void Node<Key, Value>::setParent(Node<Key, Value>* parent)
+template<typename Key, typename Value, typename Derived>
+void BasicNode<Key, Value, Derived>::setParent(Derived* parent)
 {
 	mParent = parent;
 }
@@ -162,8 +261,8 @@ void Node<Key, Value>::setParent(Node<Key, Value>* parent)
 /**
 * A setter for setting the left child of a node.
 */
-template<typename Key, typename Value>
-void Node<Key, Value>::setLeft(Node<Key, Value>* left)
+template<typename Key, typename Value, typename Derived>
+void BasicNode<Key, Value, Derived>::setLeft(Derived* left)
 {
 	mLeft = left;
 }
@@ -171,8 +270,8 @@ void Node<Key, Value>::setLeft(Node<Key, Value>* left)
 /**
 * A setter for setting the right child of a node.
 */
-template<typename Key, typename Value>
-void Node<Key, Value>::setRight(Node<Key, Value>* right)
+template<typename Key, typename Value, typename Derived>
+void BasicNode<Key, Value, Derived>::setRight(Derived* right)
 {
 	mRight = right;
 }
@@ -180,75 +279,216 @@ void Node<Key, Value>::setRight(Node<Key, Value>* right)
 /**
 * A setter for the value of a node.
 */
-template<typename Key, typename Value>
-void Node<Key, Value>::setValue(const Value& value)
+template<typename Key, typename Value, typename Derived>
+void BasicNode<Key, Value, Derived>::setValue(const Value& value)
 {
 	mItem.second = value;
 }
 
 /*
-	---------------------------------------
-	End implementations for the Node class.
-	---------------------------------------
+	-----------------------------------------
+	End implementations for the node classes.
+	-----------------------------------------
 */
 
 /**
-* A templated unbalanced binary search tree.
+* A templated unbalanced binary search tree. Keys are ordered by Compare, either a strict weak ordering
+* like the default std::less<Key> or a three way comparison, see key_compare.h.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Alloc = SlabNodeAllocator, typename NodeType = Node<Key, Value>, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 	public:
 		BinarySearchTree(); //TODO
+		explicit BinarySearchTree(const Compare& compare);
+		template<typename Iterator>
+		BinarySearchTree(Iterator first, Iterator last, bool checkSorted = false);
 		virtual ~BinarySearchTree(); //TODO
   		virtual void insert(const std::pair<Key, Value>& keyValuePair); //TODO
         virtual void remove(const Key& key); //TODO
+		template<typename K, typename C = Compare, typename = typename C::is_transparent>
+		void remove(const K& key);
   		void clear(); //TODO
+		template<typename Iterator>
+		void assign_sorted(Iterator first, Iterator last, bool checkSorted = false);
   		void print() const;
   		bool isBalanced() const; //TODO
+		Compare key_comp() const;
 
 	public:
 		/**
-		* An internal iterator class for traversing the contents of the BST.
+		* An internal iterator class for traversing the contents of the BST in either direction. IsConst
+		* picks between iterator, which hands out mutable items, and const_iterator, which is what a const
+		* tree hands out. An iterator remembers its tree, so that end() can be stepped back to the largest item.
 		*/
-		class iterator
+		template<bool IsConst>
+		class basic_iterator
 		{
 			public:
-				iterator(Node<Key,Value>* ptr);
-				iterator();
-
-				std::pair<Key,Value>& operator*() const;
-				std::pair<Key,Value>* operator->() const;
-
-				bool operator==(const iterator& rhs) const;
-				bool operator!=(const iterator& rhs) const;
-				iterator& operator=(const iterator& rhs);
-
-				iterator& operator++();
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef typename std::conditional<IsConst, const value_type&, value_type&>::type reference;
+				typedef typename std::conditional<IsConst, const value_type*, value_type*>::type pointer;
+
+				basic_iterator(NodeType* ptr, const BinarySearchTree<Key, Value, Alloc, NodeType, Compare>* tree);
+				basic_iterator();
+				// An iterator converts to a const_iterator, not the other way around.
+				template<bool OtherConst, typename = typename std::enable_if<IsConst && !OtherConst>::type>
+				basic_iterator(const basic_iterator<OtherConst>& other);
+
+				reference operator*() const;
+				pointer operator->() const;
+
+				// iterators and const_iterators compare with each other.
+				template<bool OtherConst>
+				bool operator==(const basic_iterator<OtherConst>& rhs) const;
+				template<bool OtherConst>
+				bool operator!=(const basic_iterator<OtherConst>& rhs) const;
+
+				basic_iterator& operator++();
+				basic_iterator operator++(int);
+				basic_iterator& operator--();
+				basic_iterator operator--(int);
+				basic_iterator operator+(std::size_t n) const;
+
+				// Number of increments from first to last. O(log n) when the nodes keep subtree sizes.
+				friend std::ptrdiff_t distance(const basic_iterator& first, const basic_iterator& last)
+				{
+					return basic_iterator::between(first, last);
+				}
 
 			protected:
-				Node<Key, Value>* mCurrent;
+				static std::ptrdiff_t between(const basic_iterator& first, const basic_iterator& last);
 
-				friend class BinarySearchTree<Key, Value>;
+				NodeType* mCurrent;
+				const BinarySearchTree<Key, Value, Alloc, NodeType, Compare>* mTree;
+
+				friend class BinarySearchTree<Key, Value, Alloc, NodeType, Compare>;
+				template<bool> friend class basic_iterator;
 		};
 
-	public:
-		iterator begin() const;
-		iterator end() const;
-		iterator find(const Key& key) const;
+		typedef basic_iterator<false> iterator;
+		typedef basic_iterator<true> const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
-		
+	public:
+		iterator begin();
+		const_iterator begin() const;
+		iterator end();
+		const_iterator end() const;
+		const_iterator cbegin() const;
+		const_iterator cend() const;
+
+		// Descending order, starting from the largest item.
+		reverse_iterator rbegin();
+		const_reverse_iterator rbegin() const;
+		reverse_iterator rend();
+		const_reverse_iterator rend() const;
+		const_reverse_iterator crbegin() const;
+		const_reverse_iterator crend() const;
+
+		iterator find(const Key& key);
+		const_iterator find(const Key& key) const;
+
+		// Heterogeneous lookups, only there when Compare is transparent like std::less<>. key can be anything
+		// Compare orders against Key, e.g. a std::string_view for std::string keys, and no Key is built.
+		template<typename K, typename C = Compare, typename = typename C::is_transparent>
+		iterator find(const K& key);
+		template<typename K, typename C = Compare, typename = typename C::is_transparent>
+		const_iterator find(const K& key) const;
+		template<typename K, typename C = Compare, typename = typename C::is_transparent>
+		iterator lower_bound(const K& key);
+		template<typename K, typename C = Compare, typename = typename C::is_transparent>
+		const_iterator lower_bound(const K& key) const;
+
+		// Ordered lookups, each a single descent from the root.
+		iterator lower_bound(const Key& key);
+		const_iterator lower_bound(const Key& key) const;
+		iterator upper_bound(const Key& key);
+		const_iterator upper_bound(const Key& key) const;
+		iterator floor(const Key& key);
+		const_iterator floor(const Key& key) const;
+		iterator ceiling(const Key& key);
+		const_iterator ceiling(const Key& key) const;
+		std::pair<iterator, iterator> equal_range(const Key& key);
+		std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+		std::size_t count_range(const Key& low, const Key& high) const;
+
+		// Inserts that hand back the item's position and whether the key is new, from a single descent.
+		// insert and insert_or_assign replace the value of a key that is already there, emplace and
+		// try_emplace leave it alone. try_emplace only builds the value when the key is new.
+		std::pair<iterator, bool> insert(std::pair<Key, Value>&& keyValuePair);
+		template<typename... Args>
+		std::pair<iterator, bool> emplace(Args&&... args);
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+		template<typename V>
+		std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value);
+		template<typename V>
+		std::pair<iterator, bool> insert_or_assign(Key&& key, V&& value);
+		// Inserts with a hint of where the key goes. If it belongs right before or right after hint the node
+		// is hung there without a descent from the root, which makes ingest in nearly sorted order linear.
+		// Otherwise, or for a bad hint, the insert works as usual. Returns the item's position.
+		iterator insert(const_iterator hint, const std::pair<Key, Value>& keyValuePair);
+		iterator insert(const_iterator hint, std::pair<Key, Value>&& keyValuePair);
 
 	protected:
-		Node<Key, Value>* internalFind(const Key& key) const; //TODO
-		Node<Key, Value>* getSmallestNode() const; //TODO
-		void printRoot (Node<Key, Value>* root) const;
+		template<typename A, typename B>
+		int compareKeys(const A& a, const B& b) const;
+		template<typename A, typename B>
+		bool lessKeys(const A& a, const B& b) const;
+		iterator unconst(const const_iterator& it);
+		template<typename K>
+		NodeType* internalFind(const K& key) const; //TODO
+		NodeType* getSmallestNode() const; //TODO
+		NodeType* getLargestNode() const;
+		NodeType* unlinkNode(NodeType* node, NodeType*& replacement);
+		NodeType* createNode(const Key& key, const Value& value, NodeType* parent);
+		template<typename... Args>
+		NodeType* constructNode(NodeType* parent, Args&&... args);
+		NodeType* findSlot(NodeType* start, const Key& key, NodeType*& parent, int& order) const;
+		NodeType* findSlotNear(NodeType* hint, const Key& key, NodeType*& parent, int& order) const;
+		// Hooks for the inserts, which balanced trees override: linkLeaf hangs a new node where findSlot
+		// said and valueUpdated runs after the value of an existing node is replaced.
+		virtual void linkLeaf(NodeType* leaf, NodeType* parent, int order);
+		virtual void valueUpdated(NodeType* node);
+		template<typename K, typename... Args>
+		std::pair<iterator, bool> tryEmplaceKey(K&& key, Args&&... args);
+		template<typename K, typename V>
+		std::pair<iterator, bool> assignKey(K&& key, V&& value);
+		void destroyNode(NodeType* node);
+		void clearTree(NodeType* position);
+		template<typename Iterator>
+		void checkStrictlySorted(Iterator first, Iterator last) const;
+		template<typename Iterator, typename Finish>
+		NodeType* buildSorted(Iterator& next, std::size_t count, NodeType* parent, Finish finish);
+		template<typename Finish>
+		static NodeType* linkSorted(NodeType* const* nodes, std::size_t count, NodeType* parent, Finish finish);
+		void printRoot (NodeType* root) const;
+		template<typename K>
+		NodeType* lowerBoundNode(const K& key) const;
+		NodeType* upperBoundNode(const Key& key) const;
+		std::size_t countLess(const Key& key) const;
+		static std::size_t sizeOf(const NodeType* node);
+		static std::size_t rankOfNode(const NodeType* node, const NodeType*& root);
+		static NodeType* selectFrom(NodeType* root, std::size_t index);
 
 	private:
-		int isBalancedHelper(Node<Key, Value>* mynode, bool& bal) const;
+		int isBalancedHelper(NodeType* mynode, bool& bal) const;
 
 	protected:
-		Node<Key, Value>* mRoot;
+		NodeType* mRoot;
+		// The largest node, NULL if the tree is empty. Keys that arrive in increasing order hang straight
+		// off it and end() steps back to it. Every operation that rebuilds the tree resets it.
+		NodeType* mRightmost;
+		// The smallest node, kept the same way, for hinted inserts at the front.
+		NodeType* mLeftmost;
+		Alloc mAlloc;
+		Compare mCompare;
 
 	public:
 		void print() {this->printRoot(this->mRoot);}
@@ -256,17 +496,19 @@ class BinarySearchTree
 };
 
 /*
-	---------------------------------------------------------------
-	Begin implementations for the BinarySearchTree::iterator class.
-	---------------------------------------------------------------
+	---------------------------------------------------------------------
+	Begin implementations for the BinarySearchTree::basic_iterator class.
+	---------------------------------------------------------------------
 */
 
 /**
-* Explicit constructor that initializes an iterator with a given node pointer.
+* Explicit constructor that initializes an iterator with a given node pointer in a given tree.
 */
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::basic_iterator(NodeType* ptr, const BinarySearchTree<Key, Value, Alloc, NodeType, Compare>* tree)
 	: mCurrent(ptr)
+	, mTree(tree)
 {
 
 }
@@ -274,9 +516,24 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::iterator::iterator()
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::basic_iterator()
 	: mCurrent(NULL)
+	, mTree(NULL)
+{
+
+}
+
+/**
+* Converts an iterator to a const_iterator at the same position.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+template<bool OtherConst, typename>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::basic_iterator(const basic_iterator<OtherConst>& other)
+	: mCurrent(other.mCurrent)
+	, mTree(other.mTree)
 {
 
 }
@@ -284,8 +541,9 @@ BinarySearchTree<Key, Value>::iterator::iterator()
 /**
 * Provides access to the item.
 */
-template<typename Key, typename Value>
-std::pair<Key, Value>& BinarySearchTree<Key, Value>::iterator::operator*() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst>::reference BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator*() const
 {
 	return mCurrent->getItem();
 }
@@ -293,8 +551,9 @@ std::pair<Key, Value>& BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<typename Key, typename Value>
-std::pair<Key, Value>* BinarySearchTree<Key, Value>::iterator::operator->() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst>::pointer BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator->() const
 {
 	return &(mCurrent->getItem());
 }
@@ -303,8 +562,10 @@ std::pair<Key, Value>* BinarySearchTree<Key, Value>::iterator::operator->() cons
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::iterator::operator==(const BinarySearchTree<Key, Value>::iterator& rhs) const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+template<bool OtherConst>
+bool BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator==(const basic_iterator<OtherConst>& rhs) const
 {
 	return this->mCurrent == rhs.mCurrent;
 }
@@ -313,28 +574,27 @@ bool BinarySearchTree<Key, Value>::iterator::operator==(const BinarySearchTree<K
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::iterator::operator!=(const BinarySearchTree<Key, Value>::iterator& rhs) const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+template<bool OtherConst>
+bool BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator!=(const basic_iterator<OtherConst>& rhs) const
 {
 	return this->mCurrent != rhs.mCurrent;
 }
 
 /**
-* Sets one iterator equal to another iterator.
-*/
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator &BinarySearchTree<Key, Value>::iterator::operator=(const BinarySearchTree<Key, Value>::iterator& rhs)
-{
-	this->mCurrent = rhs.mCurrent;
-	return *this;
-}
-
-/**
-* Advances the iterator's location using an in-order traversal.
+* Advances the iterator's location using an in-order traversal. Threaded nodes hold their successor, so
+* stepping is a single load.
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator++()
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst>& BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator++()
 {
+	if constexpr(NodeHasThreads<NodeType>::value)
+	{
+		mCurrent = static_cast<NodeType*>(mCurrent->getNextLink());
+		return *this;
+	}
 	if(mCurrent->getRight() != NULL)
 	{
 		mCurrent = mCurrent->getRight();
@@ -345,7 +605,7 @@ typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::i
 	}
 	else if(mCurrent->getRight() == NULL)
 	{
-		Node<Key, Value>* parent = mCurrent->getParent();
+		NodeType* parent = mCurrent->getParent();
 		while(parent != NULL && mCurrent == parent->getRight())
 		{
 			mCurrent = parent;
@@ -356,10 +616,136 @@ typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::i
 	return *this;
 }
 
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator++(int)
+{
+	basic_iterator old(*this);
+	++*this;
+	return old;
+}
+
+/**
+* Moves the iterator back to the previous item in order, the mirror image of operator++. Stepping back
+* from end() lands on the largest item.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst>& BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator--()
+{
+	if(mCurrent == NULL)
+	{
+		mCurrent = mTree->mRightmost;
+		return *this;
+	}
+	if constexpr(NodeHasThreads<NodeType>::value)
+	{
+		mCurrent = static_cast<NodeType*>(mCurrent->getPrevLink());
+		return *this;
+	}
+	if(mCurrent->getLeft() != NULL)
+	{
+		mCurrent = mCurrent->getLeft();
+		while(mCurrent->getRight() != NULL)
+		{
+			mCurrent = mCurrent->getRight();
+		}
+	}
+	else
+	{
+		NodeType* parent = mCurrent->getParent();
+		while(parent != NULL && mCurrent == parent->getLeft())
+		{
+			mCurrent = parent;
+			parent = parent->getParent();
+		}
+		mCurrent = parent;
+	}
+	return *this;
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator--(int)
+{
+	basic_iterator old(*this);
+	--*this;
+	return old;
+}
+
+/**
+* Returns an iterator n positions further along, or end() when that runs past the last node. With subtree
+* sizes this climbs to the root to find the current position and descends to the new one, otherwise it
+* steps n times.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::template basic_iterator<IsConst> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::operator+(std::size_t n) const
+{
+	if constexpr(NodeHasSize<NodeType>::value)
+	{
+		if(mCurrent == NULL)
+		{
+			return *this;
+		}
+		const NodeType* root;
+		std::size_t position = rankOfNode(mCurrent, root);
+		return basic_iterator(selectFrom(const_cast<NodeType*>(root), position + n), mTree);
+	}
+	else
+	{
+		basic_iterator it(*this);
+		for(; n > 0 && it.mCurrent != NULL; --n)
+		{
+			++it;
+		}
+		return it;
+	}
+}
+
+/**
+* Helper function for distance. Either iterator may be end(), which sits one past the last node.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<bool IsConst>
+std::ptrdiff_t BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::basic_iterator<IsConst>::between(const basic_iterator& first, const basic_iterator& last)
+{
+	if constexpr(NodeHasSize<NodeType>::value)
+	{
+		if(first.mCurrent == last.mCurrent)
+		{
+			return 0;
+		}
+		const NodeType* root;
+		std::size_t from;
+		std::size_t to;
+		if(first.mCurrent == NULL)
+		{
+			to = rankOfNode(last.mCurrent, root);
+			from = sizeOf(root);
+		}
+		else
+		{
+			from = rankOfNode(first.mCurrent, root);
+			to = last.mCurrent == NULL ? sizeOf(root) : rankOfNode(last.mCurrent, root);
+		}
+		return (std::ptrdiff_t)to - (std::ptrdiff_t)from;
+	}
+	else
+	{
+		std::ptrdiff_t count = 0;
+		for(basic_iterator it(first); it != last; ++it)
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
 /*
-	-------------------------------------------------------------
-	End implementations for the BinarySearchTree::iterator class.
-	-------------------------------------------------------------
+	-------------------------------------------------------------------
+	End implementations for the BinarySearchTree::basic_iterator class.
+	-------------------------------------------------------------------
 */
 
 /*
@@ -371,460 +757,1165 @@ typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::i
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::BinarySearchTree()
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::BinarySearchTree()
 {
 	// TODO
 	mRoot = NULL;
+	mRightmost = NULL;
+	mLeftmost = NULL;
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Constructor for a tree ordered by a given comparator.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::BinarySearchTree(const Compare& compare)
+	: mRoot(NULL)
+	, mRightmost(NULL)
+	, mLeftmost(NULL)
+	, mCompare(compare)
+{
+
+}
+
+/**
+* Builds the tree from a range of key value pairs that is already sorted by key, see assign_sorted().
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Iterator>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::BinarySearchTree(Iterator first, Iterator last, bool checkSorted)
+	: mRoot(NULL)
+	, mRightmost(NULL)
+	, mLeftmost(NULL)
+{
+	assign_sorted(first, last, checkSorted);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::~BinarySearchTree()
 {
 	// TODO
 	clear();
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::print() const
 {
 	printRoot(mRoot);
 	std::cout << "\n";
 }
 
 /**
-* Returns an iterator to the "smallest" item in the tree
+* Returns a copy of the comparator that orders the keys.
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::begin() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+Compare BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::key_comp() const
 {
-	BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-	return begin;
+	return mCompare;
 }
 
 /**
-* Returns an iterator whose value means INVALID
+* Three way comparison of two keys under the tree's comparator, see compareWith().
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::end() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename A, typename B>
+int BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::compareKeys(const A& a, const B& b) const
 {
-	BinarySearchTree<Key, Value>::iterator end(NULL);
-	return end;
+	return compareWith(mCompare, a, b);
 }
 
 /**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
+* Whether a comes before b under the tree's comparator.
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::find(const Key& key) const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename A, typename B>
+bool BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::lessKeys(const A& a, const B& b) const
 {
-	Node<Key, Value>* curr = internalFind(key);
-	BinarySearchTree<Key, Value>::iterator it(curr);
-	return it;
+	return lessWith(mCompare, a, b);
 }
 
 /**
-* An insert method to insert into a Binary Search Tree. The tree will not remain balanced when
-* inserting.
+* Returns an iterator to the "smallest" item in the tree, or end() if the tree is empty
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::begin()
 {
-	// TODO
-	//if the tree is empty
-	if(mRoot == NULL)
-	{
-		mRoot = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-		mRoot->setLeft(NULL);
-		mRoot->setRight(NULL);
-		return;
-	}
-	//if its not empty
-	else
-	{
-		Node<Key, Value>* current;
-		Node<Key, Value>* parent = mRoot;
-		//create a parent and current
-		if(keyValuePair.first < parent->getKey())
-		{
-			current = parent->getLeft();
-		}	
-		else if(keyValuePair.first > parent->getKey())
-		{
-			current = parent->getRight();
-		}
-		else
-		{
-			parent->setValue(keyValuePair.second);
-			return;
-		}
-		//compare the key with each node
-		while(current != NULL)
-		{
-			if(current->getKey() == keyValuePair.first)
-			{
-				current->setValue(keyValuePair.second);
-				return;
-			}
-			else if(keyValuePair.first < current->getKey())
-			{
-				parent = current;
-				current = current->getLeft();
-			}
-			else if(keyValuePair.first > current->getKey())
-			{
-				parent = current;
-				current = current->getRight();
-			}
-		}
-		//create a new node
-		if(keyValuePair.first < parent->getKey())
-		{
-			parent->setLeft(new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent));
-		}
-		else if(keyValuePair.first > parent->getKey())
-		{
-			parent->setRight(new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent));
-		}
-		return;
-	}
+	return iterator(getSmallestNode(), this);
+}
 
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::begin() const
+{
+	return const_iterator(getSmallestNode(), this);
 }
 
 /**
-* An remove method to remove a specific key from a Binary Search Tree. The tree may not remain balanced after
-* removal.
+* Returns an iterator whose value means INVALID
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::end()
 {
-	// TODO
-	//root is null
-	if(mRoot == NULL)
-	{
-		return;
-	}
-	//if you are removing just the root node
-	if(mRoot->getLeft() == NULL && mRoot->getRight() == NULL)
-	{
-		
-		mRoot->setLeft(NULL);
-		mRoot->setRight(NULL);
-		mRoot->setParent(NULL);
-		delete mRoot;
-		mRoot = NULL;
-		return;
-	}
-	//if the key does not exist
-	if(!internalFind(key))
-	{
-		return;
-	}
-	//if the key does exist
-	else
-	{
-		Node<Key, Value>* deleted = internalFind(key);
-		//if the removed node is a leaf
-		if(deleted->getRight() == NULL && deleted->getLeft() == NULL)
-		{
-			Node<Key, Value>* temp = deleted->getParent();
-			if(temp->getRight() == deleted)
-			{
-				temp->setRight(NULL);
-				delete deleted;
-			}
-			else if(temp->getLeft() == deleted)
-			{
-				temp->setLeft(NULL);
-				delete deleted;
-			}
-			deleted = NULL;
-			return;
-		}
-		//if it is an internal node
-		else
-		{
-			//if it has a single child
-			//if the single child is on right
-			Node<Key, Value>* parent = deleted->getParent();
-			if(deleted->getRight() != NULL && deleted->getLeft() == NULL)
-			{
-				//if the removed node is the root node
-				if(deleted == mRoot)
-				{
-					mRoot = mRoot->getRight();
-					mRoot->setParent(NULL);
-					delete deleted;
-					deleted = NULL;
-				}
-				//if the removed node is not the root node
-				else
-				{
-					Node<Key, Value>* child = deleted->getRight();
-					child->setParent(parent);
-					if(parent->getLeft() == deleted)
-					{
-						parent->setLeft(child);
-					}
-					else
-					{
-						parent->setRight(child);
-					}
-					delete deleted;
-					deleted = NULL;
-				}
-			}
-			//if the single child is on the left
-			else if(deleted->getRight() == NULL && deleted->getLeft() != NULL)
-			{
-				//if the removed node is the root node
-				if(deleted == mRoot)
-				{
-					mRoot = mRoot->getLeft();
-					mRoot->setParent(NULL);
-					delete deleted;
-					deleted = NULL;
-				}
-				//if the removed node is not the root node
-				else
-				{
-					Node<Key, Value>* child = deleted->getLeft();
-					child->setParent(parent);
-					if(parent->getLeft() == deleted)
-					{
-						parent->setLeft(child);
-					}
-					else
-					{
-						parent->setRight(child);
-					}
-					delete deleted;
-					deleted = NULL;
-				}
+	return iterator(NULL, this);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::end() const
+{
+	return const_iterator(NULL, this);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::cbegin() const
+{
+	return begin();
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::cend() const
+{
+	return end();
+}
+
+/**
+* Returns a reverse iterator to the "largest" item in the tree. Reverse iterators sit one position after
+* the item they show, so this is end() stepped back on every dereference.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::reverse_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::rbegin()
+{
+	return reverse_iterator(end());
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_reverse_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::rbegin() const
+{
+	return const_reverse_iterator(end());
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::reverse_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::rend()
+{
+	return reverse_iterator(begin());
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_reverse_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::rend() const
+{
+	return const_reverse_iterator(begin());
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_reverse_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::crbegin() const
+{
+	return rbegin();
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_reverse_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::crend() const
+{
+	return rend();
+}
+
+/**
+* Turns a const_iterator into this tree into an iterator, for the non-const overloads of the lookups.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::unconst(const const_iterator& it)
+{
+	return iterator(it.mCurrent, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::find(const Key& key)
+{
+	return unconst(std::as_const(*this).find(key));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::find(const Key& key) const
+{
+	NodeType* curr = internalFind(key);
+	BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator it(curr, this);
+	return it;
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::find(const K& key)
+{
+	return iterator(internalFind(key), this);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::find(const K& key) const
+{
+	return const_iterator(internalFind(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not smaller than key, or end() if there is none.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::lower_bound(const Key& key)
+{
+	return unconst(std::as_const(*this).lower_bound(key));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::lower_bound(const Key& key) const
+{
+	return const_iterator(lowerBoundNode(key), this);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::lower_bound(const K& key)
+{
+	return iterator(lowerBoundNode(key), this);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::lower_bound(const K& key) const
+{
+	return const_iterator(lowerBoundNode(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key, or end() if there is none.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::upper_bound(const Key& key)
+{
+	return unconst(std::as_const(*this).upper_bound(key));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::upper_bound(const Key& key) const
+{
+	return const_iterator(upperBoundNode(key), this);
+}
+
+/**
+* Returns an iterator to the item with the largest key that is not greater than key, or end() if there is none.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::floor(const Key& key)
+{
+	return unconst(std::as_const(*this).floor(key));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::floor(const Key& key) const
+{
+	NodeType* candidate = NULL;
+	NodeType* current = mRoot;
+	while(current != NULL)
+	{
+		int order = compareKeys(key, current->getKey());
+		if(order < 0)
+		{
+			current = current->getLeft();
+		}
+		else
+		{
+			candidate = current;
+			if(order == 0)
+			{
+				break;
 			}
-			//if it has two children
-			else if(deleted->getRight() != NULL && deleted->getLeft() != NULL)
+			current = current->getRight();
+		}
+	}
+	return const_iterator(candidate, this);
+}
+
+/**
+* Returns an iterator to the item with the smallest key that is not smaller than key, which is lower_bound().
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::ceiling(const Key& key)
+{
+	return unconst(std::as_const(*this).ceiling(key));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::ceiling(const Key& key) const
+{
+	return const_iterator(lowerBoundNode(key), this);
+}
+
+/**
+* Returns lower_bound() and upper_bound() together. Keys are unique, so both come out of the same descent:
+* if key is found the upper bound is its in-order successor, otherwise both are the smallest greater key.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::equal_range(const Key& key)
+{
+	std::pair<const_iterator, const_iterator> range = std::as_const(*this).equal_range(key);
+	return std::make_pair(unconst(range.first), unconst(range.second));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator, typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator>
+BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::equal_range(const Key& key) const
+{
+	NodeType* greater = NULL;
+	NodeType* current = mRoot;
+	while(current != NULL)
+	{
+		int order = compareKeys(key, current->getKey());
+		if(order < 0)
+		{
+			greater = current;
+			current = current->getLeft();
+		}
+		else if(order > 0)
+		{
+			current = current->getRight();
+		}
+		else
+		{
+			NodeType* next = current->getRight();
+			if(next != NULL)
 			{
-				//set the predecessor 
-				Node<Key, Value>* predecessor = deleted;
-				if(predecessor->getLeft() != NULL) predecessor = predecessor->getLeft();
-				while(predecessor->getRight() != NULL)
-				{
-					predecessor = predecessor->getRight();
-				}
-				//if the predecessor's parent is the removed node and root node
-				if(predecessor->getParent() == deleted && predecessor->getParent() == mRoot)
-				{
-					Node<Key, Value>* temp = mRoot->getRight();
-					predecessor->setRight(temp);
-					temp->setParent(predecessor);
-					predecessor->setParent(NULL);
-					delete mRoot;
-					mRoot = predecessor;
-					deleted = NULL;
-				}
-				//if the predecessor's parent is the removed node but not the root node
-				else if(predecessor->getParent() == deleted)
-				{
-					//if the removed node is a right child
-					if(parent->getRight() == deleted)
-					{
-						parent->setRight(predecessor);
-						predecessor->setParent(parent);
-						if(deleted->getRight() != NULL)
-						{
-							deleted->getRight()->setParent(predecessor);
-							predecessor->setRight(deleted->getRight());
-						}
-						delete deleted;
-						deleted = NULL;
-					}
-					//if the removed node is a left child
-					else
-					{
-						parent->setLeft(predecessor);
-						predecessor->setParent(parent);
-						if(deleted->getRight() != NULL)
-						{
-							deleted->getRight()->setParent(predecessor);
-							predecessor->setRight(deleted->getRight());
-						}
-						delete deleted;
-						deleted = NULL;
-					}
-					return;
-				}
-				//if the predecessor's parent is not the removed node
-				else
+				while(next->getLeft() != NULL)
 				{
-					//if the removed node is the root node
-                    if(deleted == mRoot)
-                    {
-                        Node<Key, Value>* temp = predecessor->getParent();
-                        //if predecessor has a left child
-                        if(predecessor->getLeft() != NULL)
-                        {
-                            predecessor->getLeft()->setParent(temp);
-                            temp->setRight(predecessor->getLeft());
-                        }
-                        //if predecessor does not have a left child
-                        else
-                        {
-                            temp->setRight(NULL);
-                        }
-                        predecessor->setRight(mRoot->getRight());
-                        predecessor->setLeft(mRoot->getLeft());
-                        mRoot->getRight()->setParent(predecessor);
-                        mRoot->getLeft()->setParent(predecessor);
-                        mRoot = predecessor;
-                        predecessor->setParent(NULL);
-                        delete deleted;
-                        deleted = NULL;
-                    }
-					//if the removed node is a right child
-					else if(parent->getRight() == deleted)
-					{
-						parent->setRight(predecessor);
-						if(predecessor->getLeft() != NULL)
-						{
-							predecessor->getParent()->setRight(predecessor->getLeft());
-							predecessor->getLeft()->setParent(predecessor->getParent());
-						}
-						else
-						{
-							predecessor->getParent()->setRight(NULL);
-						}
-						deleted->getLeft()->setParent(predecessor);
-						if(deleted->getRight() != NULL)
-						{
-							deleted->getRight()->setParent(predecessor);
-							predecessor->setRight(deleted->getRight());
-						}
-						else
-						{
-							predecessor->setRight(NULL);
-						}
-						predecessor->setLeft(deleted->getLeft());
-						predecessor->setParent(parent);
-						delete deleted;
-						deleted = NULL;
-					}
-					//if the removed node is a left child
-					else
-					{
-						parent->setLeft(predecessor);
-						if(predecessor->getLeft() != NULL)
-						{
-							predecessor->getParent()->setRight(predecessor->getLeft());
-							predecessor->getLeft()->setParent(predecessor->getParent());
-						}
-						else
-						{
-							predecessor->getParent()->setRight(NULL);
-						}
-						deleted->getLeft()->setParent(predecessor);
-						if(deleted->getRight() != NULL)
-						{
-							deleted->getRight()->setParent(predecessor);
-							predecessor->setRight(deleted->getRight());
-						}
-						else
-						{
-							predecessor->setRight(NULL);
-						}
-						predecessor->setLeft(deleted->getLeft());
-						predecessor->setParent(parent);
-						delete deleted;
-						deleted = NULL;
-					}
+					next = next->getLeft();
 				}
+				greater = next;
 			}
+			return std::make_pair(const_iterator(current, this), const_iterator(greater, this));
 		}
 	}
+	return std::make_pair(const_iterator(greater, this), const_iterator(greater, this));
 }
 
-//helper function to clear
-template<typename Key, typename Value>
-void clearTree(Node<Key, Value>* position)
+/**
+* Number of keys in the half open range [low, high). O(log n) for node types that keep subtree sizes,
+* otherwise O(log n) plus the number of keys counted.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::count_range(const Key& low, const Key& high) const
+{
+	if(!lessKeys(low, high))
+	{
+		return 0;
+	}
+	if constexpr(NodeHasSize<NodeType>::value)
+	{
+		return countLess(high) - countLess(low);
+	}
+	else
+	{
+		std::size_t count = 0;
+		for(const_iterator it(lowerBoundNode(low), this); it != end() && lessKeys(it->first, high); ++it)
+		{
+			++count;
+		}
+		return count;
+	}
+}
+
+/**
+* An insert method to insert into a Binary Search Tree. The tree will not remain balanced when
+* inserting.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+	// TODO
+	NodeType* parent;
+	int order;
+	NodeType* found = findSlot(mRoot, keyValuePair.first, parent, order);
+	if(found != NULL)
+	{
+		found->setValue(keyValuePair.second);
+		return;
+	}
+	linkLeaf(createNode(keyValuePair.first, keyValuePair.second, parent), parent, order);
+}
+
+/**
+* insert for a pair the caller is done with. The key and value are moved into a new node, or the value
+* into the existing one.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	return assignKey(std::move(keyValuePair.first), std::move(keyValuePair.second));
+}
+
+/**
+* Builds the item from args in a new node and then looks for its key, the way std::map does, so the
+* arguments are used once even when only the key can say where the item goes. If the key is already in
+* the tree the new node is dropped.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::emplace(Args&&... args)
+{
+	NodeType* node = constructNode(NULL, std::forward<Args>(args)...);
+	NodeType* parent;
+	int order;
+	NodeType* found = findSlot(mRoot, node->getKey(), parent, order);
+	if(found != NULL)
+	{
+		destroyNode(node);
+		return std::make_pair(iterator(found, this), false);
+	}
+	linkLeaf(node, parent, order);
+	return std::make_pair(iterator(node, this), true);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::try_emplace(const Key& key, Args&&... args)
+{
+	return tryEmplaceKey(key, std::forward<Args>(args)...);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::try_emplace(Key&& key, Args&&... args)
+{
+	return tryEmplaceKey(std::move(key), std::forward<Args>(args)...);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::insert_or_assign(const Key& key, V&& value)
+{
+	return assignKey(key, std::forward<V>(value));
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::insert_or_assign(Key&& key, V&& value)
+{
+	return assignKey(std::move(key), std::forward<V>(value));
+}
+
+/**
+* Helper function for try_emplace. Only when key is new are the value's arguments touched, to build it
+* next to the key in the new node.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::tryEmplaceKey(K&& key, Args&&... args)
+{
+	NodeType* parent;
+	int order;
+	NodeType* found = findSlot(mRoot, key, parent, order);
+	if(found != NULL)
+	{
+		return std::make_pair(iterator(found, this), false);
+	}
+	NodeType* leaf = constructNode(parent, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	linkLeaf(leaf, parent, order);
+	return std::make_pair(iterator(leaf, this), true);
+}
+
+/**
+* Helper function for insert_or_assign and the rvalue insert. value is assigned to the existing item or
+* forwarded into a new one together with key.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename V>
+std::pair<typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator, bool> BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::assignKey(K&& key, V&& value)
+{
+	NodeType* parent;
+	int order;
+	NodeType* found = findSlot(mRoot, key, parent, order);
+	if(found != NULL)
+	{
+		found->getValue() = std::forward<V>(value);
+		valueUpdated(found);
+		return std::make_pair(iterator(found, this), false);
+	}
+	NodeType* leaf = constructNode(parent, std::forward<K>(key), std::forward<V>(value));
+	linkLeaf(leaf, parent, order);
+	return std::make_pair(iterator(leaf, this), true);
+}
+
+/**
+* Hinted insert, which replaces the value of a key that is already there like insert does.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::insert(const_iterator hint, const std::pair<Key, Value>& keyValuePair)
+{
+	NodeType* parent;
+	int order;
+	NodeType* found = findSlotNear(hint.mCurrent, keyValuePair.first, parent, order);
+	if(found != NULL)
+	{
+		found->setValue(keyValuePair.second);
+		valueUpdated(found);
+		return iterator(found, this);
+	}
+	NodeType* leaf = createNode(keyValuePair.first, keyValuePair.second, parent);
+	linkLeaf(leaf, parent, order);
+	return iterator(leaf, this);
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::iterator BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::insert(const_iterator hint, std::pair<Key, Value>&& keyValuePair)
+{
+	NodeType* parent;
+	int order;
+	NodeType* found = findSlotNear(hint.mCurrent, keyValuePair.first, parent, order);
+	if(found != NULL)
+	{
+		found->getValue() = std::move(keyValuePair.second);
+		valueUpdated(found);
+		return iterator(found, this);
+	}
+	NodeType* leaf = constructNode(parent, std::move(keyValuePair));
+	linkLeaf(leaf, parent, order);
+	return iterator(leaf, this);
+}
+
+/**
+* Helper function for the hinted inserts, findSlot for a key expected next to hint, NULL for end(). A
+* key between hint and its in-order neighbour hangs from whichever of the two has a free child on the
+* side facing the other, which one of them always has. A key beyond the smallest or largest node hangs
+* from it straight away. Otherwise the neighbour costs a walk to it, which for a run of nearly sorted
+* keys is usually a step or two but can go up to the height. Any other key falls back to a descent from
+* the root.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::findSlotNear(NodeType* hint, const Key& key, NodeType*& parent, int& order) const
+{
+	if(hint == NULL)
+	{
+		return findSlot(mRoot, key, parent, order);
+	}
+	int side = compareKeys(key, hint->getKey());
+	if(side == 0)
+	{
+		return hint;
+	}
+	//the ends have no neighbour beyond them, which would take a climb up the whole spine to find out
+	if(side < 0 ? hint == mLeftmost : hint == mRightmost)
+	{
+		parent = hint;
+		order = side;
+		return NULL;
+	}
+	const_iterator neighbour(hint, this);
+	if(side < 0)
+	{
+		--neighbour;
+		int beyond = neighbour.mCurrent == NULL ? 1 : compareKeys(key, neighbour.mCurrent->getKey());
+		if(beyond == 0)
+		{
+			return neighbour.mCurrent;
+		}
+		if(beyond > 0)
+		{
+			parent = hint->getLeft() == NULL ? hint : neighbour.mCurrent;
+			order = hint->getLeft() == NULL ? -1 : 1;
+			return NULL;
+		}
+	}
+	else
+	{
+		++neighbour;
+		int beyond = neighbour.mCurrent == NULL ? -1 : compareKeys(key, neighbour.mCurrent->getKey());
+		if(beyond == 0)
+		{
+			return neighbour.mCurrent;
+		}
+		if(beyond < 0)
+		{
+			parent = hint->getRight() == NULL ? hint : neighbour.mCurrent;
+			order = hint->getRight() == NULL ? 1 : -1;
+			return NULL;
+		}
+	}
+	return findSlot(mRoot, key, parent, order);
+}
+
+/**
+* Helper function for the inserts. Descends from start, with one comparison per level, and returns the
+* node holding key. If there is none it returns NULL and leaves parent at the node a new leaf for key
+* hangs from, NULL if start is, and order negative if the leaf goes on its left. A descent from the root
+* first checks the largest key, so that appends take O(1).
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::findSlot(NodeType* start, const Key& key, NodeType*& parent, int& order) const
+{
+	parent = NULL;
+	order = 0;
+	//a key past the largest one goes right below it, without a descent
+	if(start == mRoot && mRightmost != NULL)
+	{
+		order = compareKeys(key, mRightmost->getKey());
+		if(order > 0)
+		{
+			parent = mRightmost;
+			return NULL;
+		}
+		else if(order == 0)
+		{
+			return mRightmost;
+		}
+	}
+	NodeType* current = start;
+	while(current != NULL)
+	{
+		order = compareKeys(key, current->getKey());
+		if(order < 0)
+		{
+			parent = current;
+			current = current->getLeft();
+		}
+		else if(order > 0)
+		{
+			parent = current;
+			current = current->getRight();
+		}
+		else
+		{
+			return current;
+		}
+	}
+	return NULL;
+}
+
+/**
+* Hangs leaf from parent on the side findSlot picked, or makes it the root if parent is NULL.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::linkLeaf(NodeType* leaf, NodeType* parent, int order)
+{
+	leaf->setParent(parent);
+	if(parent == NULL)
+	{
+		mRoot = leaf;
+		mRightmost = leaf;
+		mLeftmost = leaf;
+	}
+	else if(order < 0)
+	{
+		parent->setLeft(leaf);
+		if(parent == mLeftmost)
+		{
+			mLeftmost = leaf;
+		}
+	}
+	else
+	{
+		parent->setRight(leaf);
+		if(parent == mRightmost)
+		{
+			mRightmost = leaf;
+		}
+	}
+}
+
+/**
+* Nothing depends on the values in a plain tree.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::valueUpdated(NodeType*)
+{
+
+}
+
+/**
+* An remove method to remove a specific key from a Binary Search Tree. The tree may not remain balanced after
+* removal.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::remove(const Key& key)
+{
+	NodeType* deleted = internalFind(key);
+	//if the key does not exist
+	if(deleted == NULL)
+	{
+		return;
+	}
+	NodeType* replacement;
+	unlinkNode(deleted, replacement);
+	destroyNode(deleted);
+}
+
+/**
+* remove for a key of another type that the transparent Compare orders against Key.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K, typename C, typename>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::remove(const K& key)
+{
+	NodeType* deleted = internalFind(key);
+	if(deleted == NULL)
+	{
+		return;
+	}
+	NodeType* replacement;
+	unlinkNode(deleted, replacement);
+	destroyNode(deleted);
+}
+
+/**
+* Detaches a node from the tree without freeing it. A node with two children is replaced by its
+* in-order predecessor, anything else by its only child (or nothing). replacement is set to the node
+* that now occupies the removed node's position. Returns the lowest node whose subtree lost a level,
+* which is where a balanced tree has to start retracing, or NULL if that is the root position itself.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::unlinkNode(NodeType* node, NodeType*& replacement)
+{
+	NodeType* parent = node->getParent();
+	NodeType* start;
+	//if it has two children
+	if(node->getLeft() != NULL && node->getRight() != NULL)
+	{
+		NodeType* predecessor = node->getLeft();
+		while(predecessor->getRight() != NULL)
+		{
+			predecessor = predecessor->getRight();
+		}
+		//if the predecessor's parent is the removed node it keeps its left subtree
+		if(predecessor->getParent() == node)
+		{
+			start = predecessor;
+		}
+		//otherwise splice the predecessor out of its old position first
+		else
+		{
+			start = predecessor->getParent();
+			start->setRight(predecessor->getLeft());
+			if(predecessor->getLeft() != NULL)
+			{
+				predecessor->getLeft()->setParent(start);
+			}
+			predecessor->setLeft(node->getLeft());
+			node->getLeft()->setParent(predecessor);
+		}
+		predecessor->setRight(node->getRight());
+		node->getRight()->setParent(predecessor);
+		replacement = predecessor;
+	}
+	//if it has a single child or is a leaf
+	else
+	{
+		replacement = node->getLeft() != NULL ? node->getLeft() : node->getRight();
+		start = parent;
+	}
+	//hook the replacement into the removed node's position
+	if(replacement != NULL)
+	{
+		replacement->setParent(parent);
+	}
+	if(parent == NULL)
+	{
+		mRoot = replacement;
+	}
+	else if(parent->getLeft() == node)
+	{
+		parent->setLeft(replacement);
+	}
+	else
+	{
+		parent->setRight(replacement);
+	}
+	//the largest node has no right child, so the next largest is below its replacement or is its parent
+	if(node == mRightmost)
+	{
+		mRightmost = replacement != NULL ? replacement : parent;
+		while(mRightmost != NULL && mRightmost->getRight() != NULL)
+		{
+			mRightmost = mRightmost->getRight();
+		}
+	}
+	if(node == mLeftmost)
+	{
+		mLeftmost = replacement != NULL ? replacement : parent;
+		while(mLeftmost != NULL && mLeftmost->getLeft() != NULL)
+		{
+			mLeftmost = mLeftmost->getLeft();
+		}
+	}
+	node->setParent(NULL);
+	node->setLeft(NULL);
+	node->setRight(NULL);
+	return start;
+}
+
+/**
+* Helper function to clear. Runs the destructor of every node in the subtree and hands the node back to
+* the allocator unless the allocator is about to drop all of its memory anyway.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::clearTree(NodeType* position)
 {
 	if(position->getLeft()) clearTree(position->getLeft());
 	if(position->getRight()) clearTree(position->getRight());
-	delete position;
+	position->~NodeType();
+	if(!Alloc::kReleasesAll)
+	{
+		mAlloc.deallocate(position);
+	}
 }
 
 /**
 * A method to remove all contents of the tree and reset the values in the tree
-* for use again.
+* for use again. When the allocator can free everything at once and the items have
+* nothing to destruct, the nodes are not visited at all.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::clear()
 {
-	// TODO
 	if(mRoot == NULL)
 	{
 		return;
 	}
-	Node<Key, Value>* current = mRoot;
-	clearTree(current);
+	if(!Alloc::kReleasesAll || !std::is_trivially_destructible<std::pair<Key, Value> >::value || !NodeAugmentIsTrivial<NodeType>::value)
+	{
+		clearTree(mRoot);
+	}
+	mAlloc.release();
 	mRoot = NULL;
+	mRightmost = NULL;
+	mLeftmost = NULL;
+}
 
+/**
+* Replaces the contents of the tree with a range of key value pairs sorted by strictly increasing key.
+* The result is perfectly height balanced and is built in linear time without comparing any keys,
+* unless checkSorted is set, in which case the range is verified first and std::invalid_argument is
+* thrown (leaving the tree untouched) if it is not sorted. The iterators have to be forward iterators.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Iterator>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::assign_sorted(Iterator first, Iterator last, bool checkSorted)
+{
+	if(checkSorted)
+	{
+		checkStrictlySorted(first, last);
+	}
+	clear();
+	std::size_t count = (std::size_t)std::distance(first, last);
+	mRoot = buildSorted(first, count, (NodeType*)NULL, [](NodeType*) {});
+	mRightmost = getLargestNode();
+	mLeftmost = getSmallestNode();
 }
 
 /**
-* A helper function to find the smallest node in the tree.
+* Throws std::invalid_argument unless every key in the range is smaller than the next one.
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::getSmallestNode() const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Iterator>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::checkStrictlySorted(Iterator first, Iterator last) const
+{
+	if(first == last)
+	{
+		return;
+	}
+	Iterator previous = first;
+	for(++first; first != last; ++first, ++previous)
+	{
+		if(!lessKeys(previous->first, first->first))
+		{
+			throw std::invalid_argument("assign_sorted: keys are not strictly increasing");
+		}
+	}
+}
+
+/**
+* Helper function for assign_sorted. Builds a subtree out of the next count items, in order: the left
+* half, then the middle item as the subtree root, then the right half. finish is called on every node
+* once both of its children are attached, so balanced trees can fill in their extra fields.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Iterator, typename Finish>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::buildSorted(Iterator& next, std::size_t count, NodeType* parent, Finish finish)
+{
+	if(count == 0)
+	{
+		return NULL;
+	}
+	std::size_t leftCount = (count - 1) / 2;
+	NodeType* left = buildSorted(next, leftCount, (NodeType*)NULL, finish);
+	NodeType* node = createNode(next->first, next->second, parent);
+	++next;
+	node->setLeft(left);
+	if(left != NULL)
+	{
+		left->setParent(node);
+	}
+	node->setRight(buildSorted(next, count - leftCount - 1, node, finish));
+	finish(node);
+	return node;
+}
+
+/**
+* Same as buildSorted, but arranges nodes that already exist, in key order, into a balanced subtree.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename Finish>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::linkSorted(NodeType* const* nodes, std::size_t count, NodeType* parent, Finish finish)
+{
+	if(count == 0)
+	{
+		return NULL;
+	}
+	std::size_t leftCount = (count - 1) / 2;
+	NodeType* node = nodes[leftCount];
+	node->setParent(parent);
+	node->setLeft(linkSorted(nodes, leftCount, node, finish));
+	node->setRight(linkSorted(nodes + leftCount + 1, count - leftCount - 1, node, finish));
+	finish(node);
+	return node;
+}
+
+/**
+* Helper function for lower_bound: the first node whose key is not smaller than key, or NULL.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::lowerBoundNode(const K& key) const
+{
+	NodeType* candidate = NULL;
+	NodeType* current = mRoot;
+	while(current != NULL)
+	{
+		int order = compareKeys(key, current->getKey());
+		if(order > 0)
+		{
+			current = current->getRight();
+		}
+		else
+		{
+			candidate = current;
+			if(order == 0)
+			{
+				break;
+			}
+			current = current->getLeft();
+		}
+	}
+	return candidate;
+}
+
+/**
+* Helper function for upper_bound: the first node whose key is greater than key, or NULL.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::upperBoundNode(const Key& key) const
+{
+	NodeType* candidate = NULL;
+	NodeType* current = mRoot;
+	while(current != NULL)
+	{
+		if(lessKeys(key, current->getKey()))
+		{
+			candidate = current;
+			current = current->getLeft();
+		}
+		else
+		{
+			current = current->getRight();
+		}
+	}
+	return candidate;
+}
+
+/**
+* Number of keys smaller than key, whether or not key itself is in the tree, counted with subtree sizes
+* in one descent. Only for node types with NodeHasSize.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::countLess(const Key& key) const
+{
+	std::size_t smaller = 0;
+	NodeType* current = mRoot;
+	while(current != NULL)
+	{
+		int order = compareKeys(key, current->getKey());
+		if(order < 0)
+		{
+			current = current->getLeft();
+		}
+		else if(order > 0)
+		{
+			smaller += sizeOf(current->getLeft()) + 1;
+			current = current->getRight();
+		}
+		else
+		{
+			return smaller + sizeOf(current->getLeft());
+		}
+	}
+	return smaller;
+}
+
+/**
+* Number of nodes in a possibly empty subtree. Only for node types with NodeHasSize.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::sizeOf(const NodeType* node)
+{
+	return node == NULL ? 0 : node->getSize();
+}
+
+/**
+* Position of a node among all nodes of its tree, found by climbing to the root and counting everything
+* that lies to the left of the path. Hands back the root it reached. Only for node types with NodeHasSize.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+std::size_t BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::rankOfNode(const NodeType* node, const NodeType*& root)
+{
+	std::size_t position = sizeOf(node->getLeft());
+	const NodeType* parent = node->getParent();
+	while(parent != NULL)
+	{
+		if(parent->getRight() == node)
+		{
+			position += sizeOf(parent->getLeft()) + 1;
+		}
+		node = parent;
+		parent = parent->getParent();
+	}
+	root = node;
+	return position;
+}
+
+/**
+* The node at a given position in key order under root, or NULL if there are not that many nodes.
+* Only for node types with NodeHasSize.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::selectFrom(NodeType* root, std::size_t index)
+{
+	while(root != NULL)
+	{
+		std::size_t leftSize = sizeOf(root->getLeft());
+		if(index < leftSize)
+		{
+			root = root->getLeft();
+		}
+		else if(index > leftSize)
+		{
+			index -= leftSize + 1;
+			root = root->getRight();
+		}
+		else
+		{
+			return root;
+		}
+	}
+	return NULL;
+}
+
+/**
+* Allocates a node of the given type from the tree's allocator and constructs it in place.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::createNode(const Key& key, const Value& value, NodeType* parent)
+{
+	void* slot = mAlloc.allocate(sizeof(NodeType), alignof(NodeType));
+	return new (slot) NodeType(key, value, parent);
+}
+
+/**
+* Like createNode, but builds the item from args, see BasicNode. A throwing constructor gives the memory back.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename... Args>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::constructNode(NodeType* parent, Args&&... args)
+{
+	void* slot = mAlloc.allocate(sizeof(NodeType), alignof(NodeType));
+	try
+	{
+		return new (slot) NodeType(std::in_place, parent, std::forward<Args>(args)...);
+	}
+	catch(...)
+	{
+		mAlloc.deallocate(slot);
+		throw;
+	}
+}
+
+/**
+* Destructs a node that is no longer linked into the tree and returns it to the allocator.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::destroyNode(NodeType* node)
+{
+	node->~NodeType();
+	mAlloc.deallocate(node);
+}
+
+/**
+* A helper function to find the smallest node in the tree, or NULL if it is empty.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::getSmallestNode() const
 {
 	// TODO
-	Node<Key, Value>* current = mRoot;
-	while(current->getLeft() != NULL)
+	NodeType* current = mRoot;
+	while(current != NULL && current->getLeft() != NULL)
 	{
 		current = current->getLeft();
 	}
 	return current;
 }
 
+/**
+* A helper function to find the largest node in the tree, or NULL if it is empty.
+*/
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::getLargestNode() const
+{
+	NodeType* current = mRoot;
+	while(current != NULL && current->getRight() != NULL)
+	{
+		current = current->getRight();
+	}
+	return current;
+}
+
 /**
 * Helper function to find a node with given key, k and
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+template<typename K>
+NodeType* BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::internalFind(const K& key) const
 {
 	// TODO
 	if(mRoot == NULL)
 	{
 		return mRoot;
 	}
-	Node<Key, Value>* current = mRoot;
-	if(current->getKey() == key)
-	{
-		return current;
-	}
-	//searches through the tree
+	NodeType* current = mRoot;
+	//searches through the tree with one comparison per node
 	while(current != NULL)
 	{
-		if(current->getKey() == key)
+		int order = compareKeys(key, current->getKey());
+		if(order == 0)
 		{
 			return current;
 		}
-		else if(key < current->getKey())
-		{
-			current = current->getLeft();
-		}
-		else if(key > current->getKey())
-		{
-			current = current->getRight();
-		}
+		current = order < 0 ? current->getLeft() : current->getRight();
 	}
 	return NULL;
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* mynode, bool& bal) const{
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+int BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::isBalancedHelper(NodeType* mynode, bool& bal) const{
 	//if the tree is empty
 	if(mynode == NULL)
 	{
@@ -859,10 +1950,10 @@ int BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* mynode, boo
 	}
 }
 
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const{
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+bool BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::isBalanced() const{
 	bool bal = true;
-	Node<Key, Value>* mynode = this->mRoot;
+	NodeType* mynode = this->mRoot;
 	isBalancedHelper(mynode, bal);
 
 	return bal;
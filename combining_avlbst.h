@@ -0,0 +1,270 @@
+#ifndef COMBINING_AVLBST_H
+#define COMBINING_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLTree behind one lock, with flat combining on the write path. Instead of queueing on the lock,
+* a writer posts its insert or remove to a slot of its own and then either waits for its result or, if
+* the lock is free, takes it and becomes the combiner. The combiner collects every posted update, sorts
+* them by key and applies them to the tree with AVLTree::apply_batch, where each descent starts from the
+* previous key's position. It then hands every waiter its result. Under contention many updates go in
+* per lock handoff, and they walk the tree in key order instead of jumping around it.
+*
+* Threads are dealt slots round robin, once per thread, like EpochDomain slots. Threads that share a
+* slot take turns posting to it, which costs some contention but never correctness.
+*
+* Every slot holds an AVLTree::Update record from the start, so Key and Value have to be default
+* constructible and copy assignable. A remove only fills in the key.
+*/
+template <typename Key, typename Value>
+class CombiningAVLTree
+{
+public:
+    typedef AVLTree<Key, Value> TreeType;
+
+    CombiningAVLTree();
+
+    // Return whether the key was added or removed.
+    bool insert(const std::pair<Key, Value>& keyValuePair);
+    bool remove(const Key& key);
+
+    // Reads take the lock directly.
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+
+private:
+    CombiningAVLTree(const CombiningAVLTree&);
+    CombiningAVLTree& operator=(const CombiningAVLTree&);
+
+    // A slot is free, being filled by its poster, waiting for a combiner or done with its result.
+    enum SlotState {kFree, kPosting, kPending, kDone};
+
+    // Each slot has its own cache line so that posting to one does not disturb the others.
+    struct alignas(64) Slot
+    {
+        std::atomic<int> mState;
+        typename TreeType::Update mUpdate;
+    };
+
+    Slot& claimSlot();
+    bool post(Slot& slot);
+    void combine();
+    static std::size_t slotOfThisThread();
+
+    static const std::size_t kSlots = 64;
+
+    Slot mSlots[kSlots];
+    mutable std::mutex mLock;
+    TreeType mTree;
+    // The combiner's scratch lists, only touched with the lock held.
+    std::vector<Slot*> mBatch;
+    std::vector<typename TreeType::Update*> mUpdates;
+    std::atomic<std::size_t> mSize;
+};
+
+/*
+-----------------------------------------------------
+Begin implementations for the CombiningAVLTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+CombiningAVLTree<Key, Value>::CombiningAVLTree()
+    : mSize(0)
+{
+    for(std::size_t i = 0; i < kSlots; ++i)
+    {
+        mSlots[i].mState.store(kFree, std::memory_order_relaxed);
+    }
+    mBatch.reserve(kSlots);
+    mUpdates.reserve(kSlots);
+}
+
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    Slot& slot = claimSlot();
+    slot.mUpdate.item = keyValuePair;
+    slot.mUpdate.remove = false;
+    return post(slot);
+}
+
+/**
+* The slot's value is left as it is, apply_batch never reads it for a remove.
+*/
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::remove(const Key& key)
+{
+    Slot& slot = claimSlot();
+    slot.mUpdate.item.first = key;
+    slot.mUpdate.remove = true;
+    return post(slot);
+}
+
+/**
+* Takes this thread's slot for filling in an update, waiting for a thread sharing the slot to collect
+* its own result first.
+*/
+template<typename Key, typename Value>
+typename CombiningAVLTree<Key, Value>::Slot& CombiningAVLTree<Key, Value>::claimSlot()
+{
+    Slot& slot = mSlots[slotOfThisThread()];
+    int expected = kFree;
+    while(!slot.mState.compare_exchange_weak(expected, kPosting, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        expected = kFree;
+        std::this_thread::yield();
+    }
+    return slot;
+}
+
+/**
+* Posts the update filled into a claimed slot and waits until a combiner, possibly this thread, has
+* applied it. Returns whether it changed the tree.
+*/
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::post(Slot& slot)
+{
+    slot.mState.store(kPending, std::memory_order_release);
+
+    while(slot.mState.load(std::memory_order_acquire) != kDone)
+    {
+        if(mLock.try_lock())
+        {
+            combine();
+            mLock.unlock();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    bool changed = slot.mUpdate.changed;
+    slot.mState.store(kFree, std::memory_order_release);
+    return changed;
+}
+
+/**
+* Applies every pending update as one sorted batch. Called with the lock held. The batch is sorted with
+* the tree's own comparison, the order apply_batch expects. Updates to the same key from different
+* threads are concurrent, so whichever order the sort leaves them in is a valid one.
+*/
+template<typename Key, typename Value>
+void CombiningAVLTree<Key, Value>::combine()
+{
+    mBatch.clear();
+    for(std::size_t i = 0; i < kSlots; ++i)
+    {
+        if(mSlots[i].mState.load(std::memory_order_acquire) == kPending)
+        {
+            mBatch.push_back(&mSlots[i]);
+        }
+    }
+    if(mBatch.empty())
+    {
+        return;
+    }
+    auto compare = mTree.key_comp();
+    std::sort(mBatch.begin(), mBatch.end(),
+        [&compare](const Slot* a, const Slot* b) { return lessWith(compare, a->mUpdate.item.first, b->mUpdate.item.first); });
+    mUpdates.clear();
+    for(std::size_t i = 0; i < mBatch.size(); ++i)
+    {
+        mUpdates.push_back(&mBatch[i]->mUpdate);
+    }
+    mTree.apply_batch(mUpdates.data(), mUpdates.size());
+
+    std::size_t size = mSize.load(std::memory_order_relaxed);
+    for(std::size_t i = 0; i < mBatch.size(); ++i)
+    {
+        const typename TreeType::Update& update = mBatch[i]->mUpdate;
+        if(update.changed && update.remove)
+        {
+            --size;
+        }
+        else if(update.changed)
+        {
+            ++size;
+        }
+    }
+    mSize.store(size, std::memory_order_relaxed);
+    for(std::size_t i = 0; i < mBatch.size(); ++i)
+    {
+        mBatch[i]->mState.store(kDone, std::memory_order_release);
+    }
+}
+
+/**
+* Copies the value stored under key into value. Returns whether the key was found.
+*/
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> guard(mLock);
+    typename TreeType::const_iterator it = mTree.find(key);
+    if(it == mTree.end())
+    {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::contains(const Key& key) const
+{
+    Value value;
+    return find(key, value);
+}
+
+/**
+* Number of keys as of the last completed batch.
+*/
+template<typename Key, typename Value>
+std::size_t CombiningAVLTree<Key, Value>::size() const
+{
+    return mSize.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+template<typename Key, typename Value>
+bool CombiningAVLTree<Key, Value>::isBalanced() const
+{
+    std::lock_guard<std::mutex> guard(mLock);
+    return mTree.isBalanced();
+}
+
+/**
+* Deals slots out to threads round robin, once per thread.
+*/
+template<typename Key, typename Value>
+std::size_t CombiningAVLTree<Key, Value>::slotOfThisThread()
+{
+    static std::atomic<std::size_t> nextSlot(0);
+    static thread_local std::size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % kSlots;
+    return slot;
+}
+
+/*
+---------------------------------------------------
+End implementations for the CombiningAVLTree class.
+---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1189 @@
+#ifndef CONCURRENT_AVLBST_H
+#define CONCURRENT_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "rotateBST.h"
+#include "epoch.h"
+
+/**
+* A node of the concurrent AVL tree. The key never changes. Everything else is atomic because readers
+* walk the tree without locks while writers change it: the links, the height (same convention as AVLNode,
+* a leaf has height 1 and an empty subtree 0), the value and whether the key is present at all. A node
+* whose key is not present is a routing node, it only stays in the tree while it has two children.
+*
+* The version tells readers whether the subtree below the node may have lost keys since they looked at
+* it. A rotation that moves the node down marks it as shrinking for the duration and then bumps the
+* shrink count, and a node that is taken out of the tree is marked unlinked for good. The lock is a
+* small spin lock, writers only hold it for a handful of link and height updates.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLNode
+{
+public:
+    static const std::uint64_t kUnlinked = 1;
+    static const std::uint64_t kShrinking = 2;
+    static const std::uint64_t kShrinkCount = 4;
+
+    ConcurrentAVLNode();
+    ConcurrentAVLNode(const Key& key, const Value& value, ConcurrentAVLNode<Key, Value>* parent);
+
+    const Key& getKey() const;
+    Value getValue() const;
+    void setValue(const Value& value);
+    bool isPresent() const;
+    void setPresent(bool present);
+
+    ConcurrentAVLNode<Key, Value>* getParent() const;
+    ConcurrentAVLNode<Key, Value>* getLeft() const;
+    ConcurrentAVLNode<Key, Value>* getRight() const;
+    ConcurrentAVLNode<Key, Value>* getChild(int direction) const;
+    void setParent(ConcurrentAVLNode<Key, Value>* parent);
+    void setLeft(ConcurrentAVLNode<Key, Value>* left);
+    void setRight(ConcurrentAVLNode<Key, Value>* right);
+
+    int getHeight() const;
+    void setHeight(int height);
+    std::uint64_t getVersion() const;
+    void setVersion(std::uint64_t version);
+
+    void lock();
+    void unlock();
+
+private:
+    ConcurrentAVLNode(const ConcurrentAVLNode&);
+    ConcurrentAVLNode& operator=(const ConcurrentAVLNode&);
+
+    //what a search reads comes first, indexed by direction so that picking a side does not branch
+    const Key mKey;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> mChildren[2];
+    std::atomic<std::uint64_t> mVersion;
+    std::atomic<bool> mPresent;
+    std::atomic<Value> mValue;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> mParent;
+    std::atomic<int> mHeight;
+    std::atomic<bool> mLocked;
+};
+
+/**
+* An AVL tree that many threads can insert into, remove from and search at the same time, after Bronson,
+* Casper, Chafi and Olukotun's relaxed balance tree. Searches take no locks. They descend hand over hand,
+* reading a child's version before moving to it and checking the parent's version again afterwards, and
+* back up one level to retry whenever a rotation or unlink got in the way. Writers lock only the nodes
+* they change.
+*
+* Balance is relaxed: after an update the writer walks up repairing heights and rotating where needed,
+* with the same rotations as rotateBST, while other writers may be doing the same further up. Once no
+* update is running the tree is an AVL tree again (counting routing nodes). Removing a key with two
+* children only clears its value and leaves a routing node behind, which is unlinked once it has lost a
+* child. Unlinked nodes are freed through epoch based reclamation.
+*
+* Values are copied in and out atomically, so they have to be trivially copyable. Key and Value have to
+* be default constructible for the sentinel above the root.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLTree
+{
+public:
+    typedef ConcurrentAVLNode<Key, Value> NodeType;
+
+    ConcurrentAVLTree();
+    ~ConcurrentAVLTree();
+
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+
+    // Only meaningful while no update is running.
+    bool isBalanced() const;
+
+private:
+    static_assert(std::is_trivially_copyable<Value>::value, "ConcurrentAVLTree values must be trivially copyable");
+
+    ConcurrentAVLTree(const ConcurrentAVLTree&);
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&);
+
+    // What an attempt found. kRetry means a concurrent change got in the way and the caller has to look again.
+    enum Result { kRetry, kAbsent, kPresent };
+
+    // nodeCondition() answers with a new height, or with one of these.
+    static const int kUnlinkRequired = -1;
+    static const int kRebalanceRequired = -2;
+    static const int kNothingRequired = -3;
+
+    static int compare(const Key& key, const Key& nodeKey);
+    static int heightOf(const NodeType* node);
+    static void waitUntilShrinkCompleted(NodeType* node, std::uint64_t version);
+    static void destroyNode(NodeType* node);
+    static void destroySubtree(NodeType* node);
+    static int checkSubtree(const NodeType* node, const Key* low, const Key* high);
+    static NodeType* pending(NodeType* next, NodeType* parent, std::vector<NodeType*>& deferred);
+
+    Result attemptGet(const Key& key, NodeType* node, int direction, std::uint64_t nodeVersion, Value& value) const;
+    Result attemptPut(const std::pair<Key, Value>& keyValuePair, NodeType* node, int direction, std::uint64_t nodeVersion);
+    Result attemptNodePut(NodeType* node, const Value& value);
+    Result attemptRemove(const Key& key, NodeType* node, int direction, std::uint64_t nodeVersion);
+    Result attemptRemoveNode(NodeType* parent, NodeType* node);
+    bool attemptUnlinkLocked(NodeType* parent, NodeType* node);
+
+    int nodeCondition(NodeType* node) const;
+    void fixHeightAndRebalance(NodeType* node);
+    void repairFrom(NodeType* node, std::vector<NodeType*>& deferred);
+    NodeType* fixHeightLocked(NodeType* node);
+    NodeType* rebalanceLocked(NodeType* parent, NodeType* node, std::vector<NodeType*>& deferred);
+    NodeType* rebalanceToRightLocked(NodeType* parent, NodeType* node, NodeType* left, int hR0, std::vector<NodeType*>& deferred);
+    NodeType* rebalanceToLeftLocked(NodeType* parent, NodeType* node, NodeType* right, int hL0, std::vector<NodeType*>& deferred);
+    NodeType* rotateRightLocked(NodeType* parent, NodeType* node, NodeType* left, int hR, int hLL, NodeType* leftRight, int hLR, std::vector<NodeType*>& deferred);
+    NodeType* rotateLeftLocked(NodeType* parent, NodeType* node, NodeType* right, int hL, int hRR, NodeType* rightLeft, int hRL, std::vector<NodeType*>& deferred);
+    NodeType* rotateRightOverLeftLocked(NodeType* parent, NodeType* node, NodeType* left, int hR, int hLL, NodeType* leftRight, int hLRL, std::vector<NodeType*>& deferred);
+    NodeType* rotateLeftOverRightLocked(NodeType* parent, NodeType* node, NodeType* right, int hL, int hRR, NodeType* rightLeft, int hRLR, std::vector<NodeType*>& deferred);
+
+    // Sentinel whose right child is the root. It is never rotated, so its version never changes.
+    NodeType mHolder;
+    std::atomic<std::size_t> mSize;
+    mutable EpochDomain<NodeType> mEpochs;
+};
+
+/*
+------------------------------------------------------
+Begin implementations for the ConcurrentAVLNode class.
+------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode()
+    : mKey()
+    , mChildren{ {NULL}, {NULL} }
+    , mVersion(0)
+    , mPresent(true)
+    , mValue(Value())
+    , mParent(NULL)
+    , mHeight(1)
+    , mLocked(false)
+{
+
+}
+
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode(const Key& key, const Value& value, ConcurrentAVLNode<Key, Value>* parent)
+    : mKey(key)
+    , mChildren{ {NULL}, {NULL} }
+    , mVersion(0)
+    , mPresent(true)
+    , mValue(value)
+    , mParent(parent)
+    , mHeight(1)
+    , mLocked(false)
+{
+
+}
+
+template<typename Key, typename Value>
+const Key& ConcurrentAVLNode<Key, Value>::getKey() const
+{
+    return mKey;
+}
+
+template<typename Key, typename Value>
+Value ConcurrentAVLNode<Key, Value>::getValue() const
+{
+    return mValue.load(std::memory_order_acquire);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setValue(const Value& value)
+{
+    mValue.store(value, std::memory_order_release);
+}
+
+template<typename Key, typename Value>
+bool ConcurrentAVLNode<Key, Value>::isPresent() const
+{
+    return mPresent.load(std::memory_order_acquire);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setPresent(bool present)
+{
+    mPresent.store(present, std::memory_order_release);
+}
+
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getParent() const
+{
+    return mParent.load(std::memory_order_acquire);
+}
+
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getLeft() const
+{
+    return mChildren[0].load(std::memory_order_acquire);
+}
+
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getRight() const
+{
+    return mChildren[1].load(std::memory_order_acquire);
+}
+
+/**
+* The left child for a negative direction and the right child otherwise, so a comparison result can be
+* used to pick the side directly.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getChild(int direction) const
+{
+    return mChildren[direction > 0].load(std::memory_order_acquire);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setParent(ConcurrentAVLNode<Key, Value>* parent)
+{
+    mParent.store(parent, std::memory_order_release);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setLeft(ConcurrentAVLNode<Key, Value>* left)
+{
+    mChildren[0].store(left, std::memory_order_release);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setRight(ConcurrentAVLNode<Key, Value>* right)
+{
+    mChildren[1].store(right, std::memory_order_release);
+}
+
+template<typename Key, typename Value>
+int ConcurrentAVLNode<Key, Value>::getHeight() const
+{
+    return mHeight.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setHeight(int height)
+{
+    mHeight.store(height, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value>
+std::uint64_t ConcurrentAVLNode<Key, Value>::getVersion() const
+{
+    return mVersion.load(std::memory_order_seq_cst);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setVersion(std::uint64_t version)
+{
+    mVersion.store(version, std::memory_order_seq_cst);
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::lock()
+{
+    while(mLocked.exchange(true, std::memory_order_acquire))
+    {
+        while(mLocked.load(std::memory_order_relaxed))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::unlock()
+{
+    mLocked.store(false, std::memory_order_release);
+}
+
+/*
+----------------------------------------------------
+End implementations for the ConcurrentAVLNode class.
+----------------------------------------------------
+*/
+
+/*
+------------------------------------------------------
+Begin implementations for the ConcurrentAVLTree class.
+------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree()
+    : mHolder()
+    , mSize(0)
+    , mEpochs(&ConcurrentAVLTree<Key, Value>::destroyNode)
+{
+
+}
+
+/**
+* No other thread may still be using the tree.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::~ConcurrentAVLTree()
+{
+    destroySubtree(mHolder.getRight());
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::destroyNode(NodeType* node)
+{
+    delete node;
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::destroySubtree(NodeType* node)
+{
+    if(node == NULL)
+    {
+        return;
+    }
+    destroySubtree(node->getLeft());
+    destroySubtree(node->getRight());
+    delete node;
+}
+
+/**
+* Three way comparison built from operator<, which is all the rest of the trees ask of a key. Computed
+* without branches so that the only branch a search takes per level is the predictable one for a match.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::compare(const Key& key, const Key& nodeKey)
+{
+    return (int)(nodeKey < key) - (int)(key < nodeKey);
+}
+
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::heightOf(const NodeType* node)
+{
+    return node == NULL ? 0 : node->getHeight();
+}
+
+/**
+* Waits for the rotation that marked node as shrinking to finish. The rotating writer holds the node's
+* lock, so after a short spin it is cheaper to queue for the lock than to keep polling.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::waitUntilShrinkCompleted(NodeType* node, std::uint64_t version)
+{
+    if((version & NodeType::kShrinking) == 0)
+    {
+        return;
+    }
+    for(int i = 0; i < 64; ++i)
+    {
+        if(node->getVersion() != version)
+        {
+            return;
+        }
+    }
+    node->lock();
+    node->unlock();
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    typename EpochDomain<NodeType>::Pin pin = mEpochs.enter();
+    Result result;
+    do
+    {
+        result = attemptPut(keyValuePair, &mHolder, 1, mHolder.getVersion());
+    } while(result == kRetry);
+    mEpochs.leave(pin);
+    if(result == kAbsent)
+    {
+        mSize.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::remove(const Key& key)
+{
+    typename EpochDomain<NodeType>::Pin pin = mEpochs.enter();
+    Result result;
+    do
+    {
+        result = attemptRemove(key, &mHolder, 1, mHolder.getVersion());
+    } while(result == kRetry);
+    mEpochs.leave(pin);
+    if(result == kPresent)
+    {
+        mSize.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Copies the value stored under key into value. Returns whether the key was found.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    typename EpochDomain<NodeType>::Pin pin = mEpochs.enter();
+    Result result;
+    NodeType* holder = const_cast<NodeType*>(&mHolder);
+    do
+    {
+        result = attemptGet(key, holder, 1, holder->getVersion(), value);
+    } while(result == kRetry);
+    mEpochs.leave(pin);
+    return result == kPresent;
+}
+
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::contains(const Key& key) const
+{
+    Value value;
+    return find(key, value);
+}
+
+/**
+* Number of keys once every update that has started has finished.
+*/
+template<typename Key, typename Value>
+std::size_t ConcurrentAVLTree<Key, Value>::size() const
+{
+    return mSize.load(std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Checks the ordering, the stored heights and the AVL balance of every node.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::isBalanced() const
+{
+    return checkSubtree(mHolder.getRight(), NULL, NULL) >= 0;
+}
+
+/**
+* Returns the height of the subtree, or -1 if anything in it is out of order, out of balance or has a
+* stale height.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::checkSubtree(const NodeType* node, const Key* low, const Key* high)
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+    if((low != NULL && !(*low < node->getKey())) || (high != NULL && !(node->getKey() < *high)))
+    {
+        return -1;
+    }
+    int left = checkSubtree(node->getLeft(), low, &node->getKey());
+    int right = checkSubtree(node->getRight(), &node->getKey(), high);
+    if(left < 0 || right < 0 || left - right > 1 || right - left > 1)
+    {
+        return -1;
+    }
+    int height = 1 + std::max(left, right);
+    return height == node->getHeight() ? height : -1;
+}
+
+/**
+* Searches the subtree on the given side of node, which the caller saw at nodeVersion. Gives up with
+* kRetry as soon as node has shrunk or been unlinked, because key may no longer be below it.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptGet(
+    const Key& key, NodeType* node, int direction, std::uint64_t nodeVersion, Value& value) const
+{
+    while(true)
+    {
+        NodeType* child = node->getChild(direction);
+        if(node->getVersion() != nodeVersion)
+        {
+            return kRetry;
+        }
+        if(child == NULL)
+        {
+            return kAbsent;
+        }
+        int childCmp = compare(key, child->getKey());
+        if(childCmp == 0)
+        {
+            if(!child->isPresent())
+            {
+                return kAbsent;
+            }
+            value = child->getValue();
+            return kPresent;
+        }
+        std::uint64_t childVersion = child->getVersion();
+        if((childVersion & (NodeType::kShrinking | NodeType::kUnlinked)) != 0)
+        {
+            waitUntilShrinkCompleted(child, childVersion);
+        }
+        else if(child == node->getChild(direction))
+        {
+            //the child was still ours after its version was read, so descending is safe
+            if(node->getVersion() != nodeVersion)
+            {
+                return kRetry;
+            }
+            Result result = attemptGet(key, child, childCmp, childVersion, value);
+            if(result != kRetry)
+            {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* Same descent as attemptGet. A missing child is filled in with the new node under node's lock, and an
+* existing key is updated under its own lock.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptPut(
+    const std::pair<Key, Value>& keyValuePair, NodeType* node, int direction, std::uint64_t nodeVersion)
+{
+    while(true)
+    {
+        NodeType* child = node->getChild(direction);
+        if(node->getVersion() != nodeVersion)
+        {
+            return kRetry;
+        }
+        if(child == NULL)
+        {
+            node->lock();
+            if(node->getVersion() != nodeVersion)
+            {
+                node->unlock();
+                return kRetry;
+            }
+            if(node->getChild(direction) != NULL)
+            {
+                //someone else inserted here first
+                node->unlock();
+                continue;
+            }
+            NodeType* leaf = new NodeType(keyValuePair.first, keyValuePair.second, node);
+            if(direction < 0)
+            {
+                node->setLeft(leaf);
+            }
+            else
+            {
+                node->setRight(leaf);
+            }
+            node->unlock();
+            fixHeightAndRebalance(node);
+            return kAbsent;
+        }
+        int childCmp = compare(keyValuePair.first, child->getKey());
+        if(childCmp == 0)
+        {
+            Result result = attemptNodePut(child, keyValuePair.second);
+            if(result != kRetry)
+            {
+                return result;
+            }
+            continue;
+        }
+        std::uint64_t childVersion = child->getVersion();
+        if((childVersion & (NodeType::kShrinking | NodeType::kUnlinked)) != 0)
+        {
+            waitUntilShrinkCompleted(child, childVersion);
+        }
+        else if(child == node->getChild(direction))
+        {
+            if(node->getVersion() != nodeVersion)
+            {
+                return kRetry;
+            }
+            Result result = attemptPut(keyValuePair, child, childCmp, childVersion);
+            if(result != kRetry)
+            {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* Stores value in a node that holds the key, turning a routing node back into a real one.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptNodePut(NodeType* node, const Value& value)
+{
+    node->lock();
+    if((node->getVersion() & NodeType::kUnlinked) != 0)
+    {
+        node->unlock();
+        return kRetry;
+    }
+    Result result = node->isPresent() ? kPresent : kAbsent;
+    //the value goes in first so that a reader who sees the key present also sees its value
+    node->setValue(value);
+    node->setPresent(true);
+    node->unlock();
+    return result;
+}
+
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptRemove(
+    const Key& key, NodeType* node, int direction, std::uint64_t nodeVersion)
+{
+    while(true)
+    {
+        NodeType* child = node->getChild(direction);
+        if(node->getVersion() != nodeVersion)
+        {
+            return kRetry;
+        }
+        if(child == NULL)
+        {
+            return kAbsent;
+        }
+        int childCmp = compare(key, child->getKey());
+        if(childCmp == 0)
+        {
+            Result result = attemptRemoveNode(node, child);
+            if(result != kRetry)
+            {
+                return result;
+            }
+            continue;
+        }
+        std::uint64_t childVersion = child->getVersion();
+        if((childVersion & (NodeType::kShrinking | NodeType::kUnlinked)) != 0)
+        {
+            waitUntilShrinkCompleted(child, childVersion);
+        }
+        else if(child == node->getChild(direction))
+        {
+            if(node->getVersion() != nodeVersion)
+            {
+                return kRetry;
+            }
+            Result result = attemptRemove(key, child, childCmp, childVersion);
+            if(result != kRetry)
+            {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* Removes the key held by node, a child of parent. A node with at most one child is unlinked straight
+* away, with parent and node locked in that order. A node with two children becomes a routing node.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptRemoveNode(NodeType* parent, NodeType* node)
+{
+    if(!node->isPresent())
+    {
+        return kAbsent;
+    }
+    if(node->getLeft() == NULL || node->getRight() == NULL)
+    {
+        parent->lock();
+        if((parent->getVersion() & NodeType::kUnlinked) != 0 || node->getParent() != parent)
+        {
+            parent->unlock();
+            return kRetry;
+        }
+        node->lock();
+        if(!node->isPresent())
+        {
+            node->unlock();
+            parent->unlock();
+            return kAbsent;
+        }
+        if(node->getLeft() != NULL && node->getRight() != NULL)
+        {
+            //it gained a second child in the meantime
+            node->unlock();
+            parent->unlock();
+            return kRetry;
+        }
+        node->setPresent(false);
+        attemptUnlinkLocked(parent, node);
+        node->unlock();
+        parent->unlock();
+        fixHeightAndRebalance(parent);
+        return kPresent;
+    }
+    node->lock();
+    if((node->getVersion() & NodeType::kUnlinked) != 0 || node->getLeft() == NULL || node->getRight() == NULL)
+    {
+        node->unlock();
+        return kRetry;
+    }
+    Result result = node->isPresent() ? kPresent : kAbsent;
+    node->setPresent(false);
+    node->unlock();
+    return result;
+}
+
+/**
+* Splices node, which has at most one child, out from under parent and retires it. Both are locked.
+* Returns false if node has two children or is no longer parent's child.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::attemptUnlinkLocked(NodeType* parent, NodeType* node)
+{
+    NodeType* left = node->getLeft();
+    NodeType* right = node->getRight();
+    if(left != NULL && right != NULL)
+    {
+        return false;
+    }
+    NodeType* splice = left != NULL ? left : right;
+    if(parent->getLeft() == node)
+    {
+        parent->setLeft(splice);
+    }
+    else if(parent->getRight() == node)
+    {
+        parent->setRight(splice);
+    }
+    else
+    {
+        return false;
+    }
+    if(splice != NULL)
+    {
+        splice->setParent(parent);
+    }
+    node->setVersion(NodeType::kUnlinked);
+    mEpochs.retire(node);
+    return true;
+}
+
+/**
+* Looks at node without locking it and says what it needs: to be unlinked, to be rotated, a new height,
+* or nothing.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::nodeCondition(NodeType* node) const
+{
+    NodeType* left = node->getLeft();
+    NodeType* right = node->getRight();
+    if((left == NULL || right == NULL) && !node->isPresent())
+    {
+        return kUnlinkRequired;
+    }
+    int hL0 = heightOf(left);
+    int hR0 = heightOf(right);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int balance = hL0 - hR0;
+    if(balance < -1 || balance > 1)
+    {
+        return kRebalanceRequired;
+    }
+    return node->getHeight() != hNRepl ? hNRepl : kNothingRequired;
+}
+
+/**
+* Walks up from node repairing heights, rotating and unlinking routing nodes until nothing changes any
+* more, then does the same from every parent a rotation queued on the way.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::fixHeightAndRebalance(NodeType* node)
+{
+    std::vector<NodeType*> deferred;
+    repairFrom(node, deferred);
+    while(!deferred.empty())
+    {
+        NodeType* next = deferred.back();
+        deferred.pop_back();
+        repairFrom(next, deferred);
+    }
+}
+
+/**
+* One walk up from node. Another writer's repair may be under way above, in which case this one meets it
+* or stops where the heights already agree.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::repairFrom(NodeType* node, std::vector<NodeType*>& deferred)
+{
+    while(node != NULL && node->getParent() != NULL)
+    {
+        int condition = nodeCondition(node);
+        if(condition == kNothingRequired || (node->getVersion() & NodeType::kUnlinked) != 0)
+        {
+            return;
+        }
+        if(condition != kUnlinkRequired && condition != kRebalanceRequired)
+        {
+            node->lock();
+            NodeType* next = fixHeightLocked(node);
+            node->unlock();
+            node = next;
+        }
+        else
+        {
+            NodeType* parent = node->getParent();
+            parent->lock();
+            if((parent->getVersion() & NodeType::kUnlinked) == 0 && node->getParent() == parent)
+            {
+                node->lock();
+                NodeType* next = rebalanceLocked(parent, node, deferred);
+                node->unlock();
+                node = next;
+            }
+            parent->unlock();
+        }
+    }
+}
+
+/**
+* Updates the height of the locked node. Returns the next node to look at: the node itself if it needs
+* more than a height, its parent if the height changed, NULL if it was already right.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::fixHeightLocked(NodeType* node)
+{
+    int condition = nodeCondition(node);
+    if(condition == kRebalanceRequired || condition == kUnlinkRequired)
+    {
+        return node;
+    }
+    if(condition == kNothingRequired)
+    {
+        return NULL;
+    }
+    node->setHeight(condition);
+    return node->getParent();
+}
+
+/**
+* node and its parent are locked. Unlinks node if it is a routing node with a free side, rotates if it is
+* out of balance and otherwise fixes its height. Returns the next node to look at.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rebalanceLocked(NodeType* parent, NodeType* node, std::vector<NodeType*>& deferred)
+{
+    NodeType* left = node->getLeft();
+    NodeType* right = node->getRight();
+    if((left == NULL || right == NULL) && !node->isPresent())
+    {
+        if(attemptUnlinkLocked(parent, node))
+        {
+            return fixHeightLocked(parent);
+        }
+        return node;
+    }
+    int hN = node->getHeight();
+    int hL0 = heightOf(left);
+    int hR0 = heightOf(right);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int balance = hL0 - hR0;
+    if(balance > 1)
+    {
+        return rebalanceToRightLocked(parent, node, left, hR0, deferred);
+    }
+    if(balance < -1)
+    {
+        return rebalanceToLeftLocked(parent, node, right, hL0, deferred);
+    }
+    if(hNRepl != hN)
+    {
+        node->setHeight(hNRepl);
+        return fixHeightLocked(parent);
+    }
+    return NULL;
+}
+
+/**
+* The left side of node is too tall. Locks the left child, and its right child if a double rotation may
+* be needed, and picks the rotation the same way AVLTree::rebalance does. Heights read before the locks
+* were taken are checked again under them.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rebalanceToRightLocked(
+    NodeType* parent, NodeType* node, NodeType* left, int hR0, std::vector<NodeType*>& deferred)
+{
+    NodeType* next;
+    left->lock();
+    int hL = left->getHeight();
+    if(hL - hR0 <= 1)
+    {
+        left->unlock();
+        return node;
+    }
+    NodeType* leftRight = left->getRight();
+    int hLL0 = heightOf(left->getLeft());
+    int hLR0 = heightOf(leftRight);
+    if(hLL0 >= hLR0)
+    {
+        next = rotateRightLocked(parent, node, left, hR0, hLL0, leftRight, hLR0, deferred);
+        left->unlock();
+        return next;
+    }
+    leftRight->lock();
+    int hLR = leftRight->getHeight();
+    if(hLL0 >= hLR)
+    {
+        next = rotateRightLocked(parent, node, left, hR0, hLL0, leftRight, hLR, deferred);
+        leftRight->unlock();
+        left->unlock();
+        return next;
+    }
+    int hLRL = heightOf(leftRight->getLeft());
+    int balance = hLL0 - hLRL;
+    if(balance >= -1 && balance <= 1)
+    {
+        next = rotateRightOverLeftLocked(parent, node, left, hR0, hLL0, leftRight, hLRL, deferred);
+        leftRight->unlock();
+        left->unlock();
+        return next;
+    }
+    leftRight->unlock();
+    //the double rotation would leave left out of balance, so rotate below node first
+    next = rebalanceToLeftLocked(node, left, leftRight, hLL0, deferred);
+    left->unlock();
+    return next;
+}
+
+/**
+* Mirror image of rebalanceToRightLocked.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rebalanceToLeftLocked(
+    NodeType* parent, NodeType* node, NodeType* right, int hL0, std::vector<NodeType*>& deferred)
+{
+    NodeType* next;
+    right->lock();
+    int hR = right->getHeight();
+    if(hL0 - hR >= -1)
+    {
+        right->unlock();
+        return node;
+    }
+    NodeType* rightLeft = right->getLeft();
+    int hRL0 = heightOf(rightLeft);
+    int hRR0 = heightOf(right->getRight());
+    if(hRR0 >= hRL0)
+    {
+        next = rotateLeftLocked(parent, node, right, hL0, hRR0, rightLeft, hRL0, deferred);
+        right->unlock();
+        return next;
+    }
+    rightLeft->lock();
+    int hRL = rightLeft->getHeight();
+    if(hRR0 >= hRL)
+    {
+        next = rotateLeftLocked(parent, node, right, hL0, hRR0, rightLeft, hRL, deferred);
+        rightLeft->unlock();
+        right->unlock();
+        return next;
+    }
+    int hRLR = heightOf(rightLeft->getRight());
+    int balance = hRR0 - hRLR;
+    if(balance >= -1 && balance <= 1)
+    {
+        next = rotateLeftOverRightLocked(parent, node, right, hL0, hRR0, rightLeft, hRLR, deferred);
+        rightLeft->unlock();
+        right->unlock();
+        return next;
+    }
+    rightLeft->unlock();
+    next = rebalanceToRightLocked(node, right, rightLeft, hRR0, deferred);
+    right->unlock();
+    return next;
+}
+
+/**
+* A rotation that leaves work below the new subtree top hands that node back to the repair loop, which
+* then cannot also carry the height change on to the parent. The parent is queued for a second pass so
+* that its height is repaired no matter who finishes the work below.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::pending(NodeType* next, NodeType* parent, std::vector<NodeType*>& deferred)
+{
+    deferred.push_back(parent);
+    return next;
+}
+
+/**
+* Single right rotation around node with parent, node and left locked. node moves down, so it is marked
+* as shrinking while the links change. Returns whichever of the two nodes still needs work, or carries
+* on with the parent's height.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rotateRightLocked(
+    NodeType* parent, NodeType* node, NodeType* left, int hR, int hLL, NodeType* leftRight, int hLR, std::vector<NodeType*>& deferred)
+{
+    std::uint64_t nodeVersion = node->getVersion();
+    node->setVersion(nodeVersion | NodeType::kShrinking);
+    rotateRightLinks(node);
+    int hNRepl = 1 + std::max(hLR, hR);
+    node->setHeight(hNRepl);
+    left->setHeight(1 + std::max(hLL, hNRepl));
+    node->setVersion(nodeVersion + NodeType::kShrinkCount);
+
+    int balanceN = hLR - hR;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return pending(node, parent, deferred);
+    }
+    if((leftRight == NULL || hR == 0) && !node->isPresent())
+    {
+        return pending(node, parent, deferred);
+    }
+    int balanceL = hLL - hNRepl;
+    if(balanceL < -1 || balanceL > 1)
+    {
+        return pending(left, parent, deferred);
+    }
+    if(hLL == 0 && !left->isPresent())
+    {
+        return pending(left, parent, deferred);
+    }
+    return fixHeightLocked(parent);
+}
+
+/**
+* Mirror image of rotateRightLocked.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rotateLeftLocked(
+    NodeType* parent, NodeType* node, NodeType* right, int hL, int hRR, NodeType* rightLeft, int hRL, std::vector<NodeType*>& deferred)
+{
+    std::uint64_t nodeVersion = node->getVersion();
+    node->setVersion(nodeVersion | NodeType::kShrinking);
+    rotateLeftLinks(node);
+    int hNRepl = 1 + std::max(hL, hRL);
+    node->setHeight(hNRepl);
+    right->setHeight(1 + std::max(hRR, hNRepl));
+    node->setVersion(nodeVersion + NodeType::kShrinkCount);
+
+    int balanceN = hRL - hL;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return pending(node, parent, deferred);
+    }
+    if((rightLeft == NULL || hL == 0) && !node->isPresent())
+    {
+        return pending(node, parent, deferred);
+    }
+    int balanceR = hRR - hNRepl;
+    if(balanceR < -1 || balanceR > 1)
+    {
+        return pending(right, parent, deferred);
+    }
+    if(hRR == 0 && !right->isPresent())
+    {
+        return pending(right, parent, deferred);
+    }
+    return fixHeightLocked(parent);
+}
+
+/**
+* Double rotation bringing leftRight up into node's place, with parent, node, left and leftRight locked.
+* Both node and left move down and stay marked as shrinking until both rotations are done.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rotateRightOverLeftLocked(
+    NodeType* parent, NodeType* node, NodeType* left, int hR, int hLL, NodeType* leftRight, int hLRL, std::vector<NodeType*>& deferred)
+{
+    std::uint64_t nodeVersion = node->getVersion();
+    std::uint64_t leftVersion = left->getVersion();
+    NodeType* leftRightRight = leftRight->getRight();
+    int hLRR = heightOf(leftRightRight);
+    node->setVersion(nodeVersion | NodeType::kShrinking);
+    left->setVersion(leftVersion | NodeType::kShrinking);
+    rotateLeftLinks(left);
+    rotateRightLinks(node);
+    int hNRepl = 1 + std::max(hLRR, hR);
+    node->setHeight(hNRepl);
+    int hLRepl = 1 + std::max(hLL, hLRL);
+    left->setHeight(hLRepl);
+    leftRight->setHeight(1 + std::max(hLRepl, hNRepl));
+    node->setVersion(nodeVersion + NodeType::kShrinkCount);
+    left->setVersion(leftVersion + NodeType::kShrinkCount);
+
+    int balanceN = hLRR - hR;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return pending(node, parent, deferred);
+    }
+    if((leftRightRight == NULL || hR == 0) && !node->isPresent())
+    {
+        return pending(node, parent, deferred);
+    }
+    int balanceLR = hLRepl - hNRepl;
+    if(balanceLR < -1 || balanceLR > 1)
+    {
+        return pending(leftRight, parent, deferred);
+    }
+    if((hLL == 0 || hLRL == 0) && !left->isPresent())
+    {
+        return pending(left, parent, deferred);
+    }
+    return fixHeightLocked(parent);
+}
+
+/**
+* Mirror image of rotateRightOverLeftLocked.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::NodeType* ConcurrentAVLTree<Key, Value>::rotateLeftOverRightLocked(
+    NodeType* parent, NodeType* node, NodeType* right, int hL, int hRR, NodeType* rightLeft, int hRLR, std::vector<NodeType*>& deferred)
+{
+    std::uint64_t nodeVersion = node->getVersion();
+    std::uint64_t rightVersion = right->getVersion();
+    NodeType* rightLeftLeft = rightLeft->getLeft();
+    int hRLL = heightOf(rightLeftLeft);
+    node->setVersion(nodeVersion | NodeType::kShrinking);
+    right->setVersion(rightVersion | NodeType::kShrinking);
+    rotateRightLinks(right);
+    rotateLeftLinks(node);
+    int hNRepl = 1 + std::max(hL, hRLL);
+    node->setHeight(hNRepl);
+    int hRRepl = 1 + std::max(hRLR, hRR);
+    right->setHeight(hRRepl);
+    rightLeft->setHeight(1 + std::max(hNRepl, hRRepl));
+    node->setVersion(nodeVersion + NodeType::kShrinkCount);
+    right->setVersion(rightVersion + NodeType::kShrinkCount);
+
+    int balanceN = hRLL - hL;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return pending(node, parent, deferred);
+    }
+    if((rightLeftLeft == NULL || hL == 0) && !node->isPresent())
+    {
+        return pending(node, parent, deferred);
+    }
+    int balanceRL = hRRepl - hNRepl;
+    if(balanceRL < -1 || balanceRL > 1)
+    {
+        return pending(rightLeft, parent, deferred);
+    }
+    if((hRR == 0 || hRLR == 0) && !right->isPresent())
+    {
+        return pending(right, parent, deferred);
+    }
+    return fixHeightLocked(parent);
+}
+
+/*
+----------------------------------------------------
+End implementations for the ConcurrentAVLTree class.
+----------------------------------------------------
+*/
+
+#endif
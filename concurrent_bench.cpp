@@ -0,0 +1,134 @@
+#include "avlbst.h"
+#include "concurrent_avlbst.h"
+#include "sharded_avlmap.h"
+#include "combining_avlbst.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <cstdlib>
+
+using namespace std;
+
+// Scalability benchmark for ConcurrentAVLTree, ShardedAVLMap and CombiningAVLTree against an AVLTree
+// behind one mutex.
+// Usage: ./concurrent_bench [key range] [total operations]
+//
+// Each run prefills half of the key range and then splits a fixed number of random operations over
+// 1 to 64 threads. The mix is given as the percentage of inserts and removes, the rest are lookups.
+// The sharded map starts out as one shard and splits while it is prefilled.
+
+typedef chrono::steady_clock Clock;
+
+// The single lock baseline.
+class LockedAVLTree
+{
+public:
+	void insert(const std::pair<int, int>& keyValuePair)
+	{
+		lock_guard<mutex> guard(mLock);
+		mTree.insert(keyValuePair);
+	}
+
+	void remove(int key)
+	{
+		lock_guard<mutex> guard(mLock);
+		mTree.remove(key);
+	}
+
+	bool find(int key, int& value)
+	{
+		lock_guard<mutex> guard(mLock);
+		AVLTree<int, int>::iterator it = mTree.find(key);
+		if(it == mTree.end())
+		{
+			return false;
+		}
+		value = it->second;
+		return true;
+	}
+
+private:
+	mutex mLock;
+	AVLTree<int, int> mTree;
+};
+
+template<typename Tree>
+double runMix(int threads, int keyRange, long operations, int updatePercent)
+{
+	Tree tree;
+	mt19937 fill(99);
+	for(int i = 0; i < keyRange / 2; ++i)
+	{
+		int key = fill() % keyRange;
+		tree.insert(std::pair<int, int>(key, key));
+	}
+
+	vector<thread> workers;
+	long share = operations / threads;
+	Clock::time_point start = Clock::now();
+	for(int t = 0; t < threads; ++t)
+	{
+		workers.push_back(thread([&tree, t, share, keyRange, updatePercent]() {
+			mt19937 rng(t + 1);
+			int value;
+			long hits = 0;
+			for(long i = 0; i < share; ++i)
+			{
+				int key = rng() % keyRange;
+				int roll = rng() % 100;
+				if(roll < updatePercent / 2)
+				{
+					tree.insert(std::pair<int, int>(key, key));
+				}
+				else if(roll < updatePercent)
+				{
+					tree.remove(key);
+				}
+				else
+				{
+					hits += tree.find(key, value);
+				}
+			}
+			//keeps the lookups from being optimized away
+			if(hits < 0)
+			{
+				cout << hits;
+			}
+		}));
+	}
+	for(size_t t = 0; t < workers.size(); ++t)
+	{
+		workers[t].join();
+	}
+	double seconds = chrono::duration<double>(Clock::now() - start).count();
+	return share * threads / seconds / 1e6;
+}
+
+static void runWorkload(const char* name, int keyRange, long operations, int updatePercent)
+{
+	cout << name << " (" << updatePercent << "% updates), Mops/s" << endl;
+	cout << "  threads  concurrent  sharded  combining  locked" << endl;
+	for(int threads = 1; threads <= 64; threads *= 2)
+	{
+		double concurrent = runMix<ConcurrentAVLTree<int, int> >(threads, keyRange, operations, updatePercent);
+		double sharded = runMix<ShardedAVLMap<int, int> >(threads, keyRange, operations, updatePercent);
+		double combining = runMix<CombiningAVLTree<int, int> >(threads, keyRange, operations, updatePercent);
+		double locked = runMix<LockedAVLTree>(threads, keyRange, operations, updatePercent);
+		cout << "  " << threads << "  " << concurrent << "  " << sharded << "  " << combining << "  " << locked << endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int keyRange = argc > 1 ? atoi(argv[1]) : 100000;
+	long operations = argc > 2 ? atol(argv[2]) : 2000000;
+	cout << "key range " << keyRange << ", " << operations << " operations per run, "
+		<< thread::hardware_concurrency() << " hardware threads" << endl;
+
+	runWorkload("read mostly", keyRange, operations, 10);
+	runWorkload("write heavy", keyRange, operations, 50);
+	return 0;
+}
@@ -0,0 +1,242 @@
+#include "concurrent_avlbst.h"
+#include "sharded_avlmap.h"
+#include "combining_avlbst.h"
+#include "rcu_avlbst.h"
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <set>
+#include <random>
+#include <atomic>
+#include <cstdlib>
+
+using namespace std;
+
+// Multithreaded stress test for the concurrent trees. Usage: ./concurrent_stress [threads] [operations per thread]
+//
+// Every writer owns the keys congruent to its index and mirrors its own updates in a std::set, so the
+// final contents are known exactly. All writers also hammer a small shared range to force contention on
+// the same nodes. Readers keep looking up a set of keys that were inserted up front and never touched
+// again, which must never go missing however the tree is rotated or resharded around them.
+
+static const int kStableKeys = 1000;
+static const int kSharedKeys = 64;
+
+static atomic<bool> failed(false);
+
+static void check(bool condition, const char* what)
+{
+	if(!condition)
+	{
+		cout << "FAILED: " << what << endl;
+		failed.store(true);
+	}
+}
+
+// Stable keys are negative, owned keys are spread over [0, 1 << 20), shared keys sit above that.
+static int stableKey(int i)
+{
+	return -1 - i * 7;
+}
+
+static int sharedKey(int i)
+{
+	return (1 << 20) + i;
+}
+
+// One full ordered scan during the updates. The concurrent and combining trees have no iteration, so there is nothing to do.
+static long scanOnce(ConcurrentAVLTree<int, long>&)
+{
+	return 0;
+}
+
+static long scanOnce(CombiningAVLTree<int, long>&)
+{
+	return 0;
+}
+
+// Keys have to come out strictly increasing across shard boundaries, and every stable key has to be seen.
+static long scanOnce(ShardedAVLMap<int, long>& map)
+{
+	int stableSeen = 0;
+	bool first = true;
+	int previous = 0;
+	for(ShardedAVLMap<int, long>::iterator it = map.begin(); it != map.end(); ++it)
+	{
+		if(!first && !(previous < it->first))
+		{
+			check(false, "a scan returned keys out of order");
+			return 0;
+		}
+		stableSeen += (it->first < 0);
+		previous = it->first;
+		first = false;
+	}
+	check(stableSeen == kStableKeys, "a scan missed stable keys");
+	return 1;
+}
+
+// The same for one consistent version of the RCU tree, which the view keeps alive while writers move on.
+static long scanOnce(RcuAVLTree<int, long>& tree)
+{
+	RcuAVLTree<int, long>::ReadView view = tree.read();
+	int stableSeen = 0;
+	bool first = true;
+	int previous = 0;
+	for(RcuAVLTree<int, long>::iterator it = view.begin(); it != view.end(); ++it)
+	{
+		if(!first && !(previous < it->first))
+		{
+			check(false, "a read view returned keys out of order");
+			return 0;
+		}
+		if(it->first < 0 && it->second != (long)((-1 - it->first) / 7))
+		{
+			check(false, "a read view returned a stable key with the wrong value");
+			return 0;
+		}
+		stableSeen += (it->first < 0);
+		previous = it->first;
+		first = false;
+	}
+	check(stableSeen == kStableKeys, "a read view missed stable keys");
+	return 1;
+}
+
+template<typename Tree>
+void runStress(const char* name, Tree& tree, int threads, int operations)
+{
+	for(int i = 0; i < kStableKeys; ++i)
+	{
+		tree.insert(std::pair<int, long>(stableKey(i), i));
+	}
+
+	vector<set<int> > owned(threads);
+	atomic<bool> writing(true);
+	atomic<long> lookups(0);
+	atomic<long> scans(0);
+	vector<thread> writers;
+	for(int t = 0; t < threads; ++t)
+	{
+		writers.push_back(thread([&, t]() {
+			mt19937 rng(1000 + t);
+			set<int>& mine = owned[t];
+			for(int i = 0; i < operations; ++i)
+			{
+				unsigned r = rng();
+				if(r % 8 == 0)
+				{
+					int key = sharedKey(rng() % kSharedKeys);
+					if(r % 16 == 0)
+					{
+						tree.insert(std::pair<int, long>(key, key));
+					}
+					else
+					{
+						tree.remove(key);
+					}
+					continue;
+				}
+				//owned keys are t, t + threads, t + 2 * threads, ...
+				int key = (int)(rng() % (4096 / threads + 1)) * threads + t;
+				if(r % 3 == 0)
+				{
+					tree.remove(key);
+					mine.erase(key);
+				}
+				else
+				{
+					tree.insert(std::pair<int, long>(key, (long)key * 3));
+					mine.insert(key);
+				}
+			}
+		}));
+	}
+	vector<thread> readers;
+	for(int t = 0; t < 2; ++t)
+	{
+		readers.push_back(thread([&, t]() {
+			mt19937 rng(7 + t);
+			long done = 0;
+			while(writing.load())
+			{
+				int i = rng() % kStableKeys;
+				long value = -1;
+				if(!tree.find(stableKey(i), value) || value != i)
+				{
+					check(false, "a stable key went missing during updates");
+					return;
+				}
+				//shared keys come and go, but a found value has to be the one that was stored
+				int key = sharedKey(rng() % kSharedKeys);
+				if(tree.find(key, value) && value != key)
+				{
+					check(false, "a shared key came back with a torn value");
+					return;
+				}
+				++done;
+			}
+			lookups += done;
+		}));
+	}
+	readers.push_back(thread([&]() {
+		while(writing.load())
+		{
+			scans += scanOnce(tree);
+		}
+	}));
+	for(size_t t = 0; t < writers.size(); ++t)
+	{
+		writers[t].join();
+	}
+	writing.store(false);
+	for(size_t t = 0; t < readers.size(); ++t)
+	{
+		readers[t].join();
+	}
+
+	size_t expected = kStableKeys;
+	for(int t = 0; t < threads; ++t)
+	{
+		expected += owned[t].size();
+		for(int key = t; key < 4096 + threads; key += threads)
+		{
+			long value = 0;
+			bool found = tree.find(key, value);
+			check(found == (owned[t].count(key) != 0), "owned key presence differs from the writer's own record");
+			check(!found || value == (long)key * 3, "owned key has the wrong value");
+		}
+	}
+	for(int i = 0; i < kSharedKeys; ++i)
+	{
+		expected += tree.contains(sharedKey(i));
+	}
+	for(int i = 0; i < kStableKeys; ++i)
+	{
+		check(tree.contains(stableKey(i)), "stable key missing at the end");
+	}
+	check(tree.size() == expected, "size() disagrees with the contents");
+	check(tree.isBalanced(), "tree is not a valid AVL tree once quiescent");
+
+	cout << name << ": " << threads << " writers x " << operations << " operations, " << lookups.load()
+		<< " concurrent lookups, " << scans.load() << " concurrent scans, " << tree.size() << " keys left" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int threads = argc > 1 ? atoi(argv[1]) : 8;
+	int operations = argc > 2 ? atoi(argv[2]) : 200000;
+
+	ConcurrentAVLTree<int, long> concurrent;
+	runStress("ConcurrentAVLTree", concurrent, threads, operations);
+	//small shards so that splits and merges happen all the time
+	ShardedAVLMap<int, long> sharded(64);
+	runStress("ShardedAVLMap", sharded, threads, operations);
+	CombiningAVLTree<int, long> combining;
+	runStress("CombiningAVLTree", combining, threads, operations);
+	RcuAVLTree<int, long> rcu;
+	runStress("RcuAVLTree", rcu, threads, operations);
+
+	cout << (failed ? "FAILED" : "passed") << endl;
+	return failed ? 1 : 0;
+}
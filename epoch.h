@@ -0,0 +1,225 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+* Epoch based reclamation for data that readers walk without locks. Readers pin the current epoch for
+* as long as they may hold pointers into the structure. Writers retire objects after unlinking them, and
+* a retired object is only reclaimed once the global epoch has advanced twice past the epoch it was
+* retired in, which can only happen after every reader that might still see it has unpinned.
+*
+* Readers count themselves into one of two counters per slot, picked by the parity of the epoch they
+* pinned, so pinning is two atomic increments and no registration. Threads share slots round robin, which
+* costs some contention but never correctness. The epoch moves from e to e+1 once no reader is left on
+* the parity of e-1.
+*/
+template <typename T>
+class EpochDomain
+{
+public:
+    // What a reader needs to unpin again.
+    struct Pin
+    {
+        std::size_t slot;
+        unsigned parity;
+    };
+
+    explicit EpochDomain(void (*reclaim)(T*));
+    ~EpochDomain();
+
+    Pin enter();
+    void leave(const Pin& pin);
+
+    void retire(T* object);
+    void collect();
+    void synchronize();
+
+private:
+    EpochDomain(const EpochDomain&);
+    EpochDomain& operator=(const EpochDomain&);
+
+    bool tryAdvance();
+    void reclaimUpTo(std::uint64_t epoch);
+    static std::size_t slotOfThisThread();
+
+    static const std::size_t kSlots = 64;
+
+    // Each slot has its own cache line so that readers on different slots do not share one.
+    struct alignas(64) Slot
+    {
+        std::atomic<std::int64_t> active[2];
+    };
+
+    Slot mSlots[kSlots];
+    std::atomic<std::uint64_t> mEpoch;
+    std::mutex mRetireLock;
+    std::deque<std::pair<std::uint64_t, T*> > mRetired;
+    void (*mReclaim)(T*);
+};
+
+/*
+--------------------------------------------------
+Begin implementations for the EpochDomain class.
+--------------------------------------------------
+*/
+
+template<typename T>
+EpochDomain<T>::EpochDomain(void (*reclaim)(T*))
+    : mEpoch(2)
+    , mReclaim(reclaim)
+{
+    for(std::size_t i = 0; i < kSlots; ++i)
+    {
+        mSlots[i].active[0].store(0, std::memory_order_relaxed);
+        mSlots[i].active[1].store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Reclaims everything still retired. No reader may be pinned any more at this point.
+*/
+template<typename T>
+EpochDomain<T>::~EpochDomain()
+{
+    while(!mRetired.empty())
+    {
+        mReclaim(mRetired.front().second);
+        mRetired.pop_front();
+    }
+}
+
+/**
+* Pins the current epoch. The epoch is read again after counting in, and a reader that raced with an
+* advance retries, so a pinned reader always sits on the parity of an epoch that was current while it
+* was counted in.
+*/
+template<typename T>
+typename EpochDomain<T>::Pin EpochDomain<T>::enter()
+{
+    Pin pin;
+    pin.slot = slotOfThisThread();
+    while(true)
+    {
+        std::uint64_t epoch = mEpoch.load(std::memory_order_seq_cst);
+        pin.parity = (unsigned)(epoch & 1);
+        mSlots[pin.slot].active[pin.parity].fetch_add(1, std::memory_order_seq_cst);
+        if(mEpoch.load(std::memory_order_seq_cst) == epoch)
+        {
+            return pin;
+        }
+        mSlots[pin.slot].active[pin.parity].fetch_sub(1, std::memory_order_release);
+    }
+}
+
+template<typename T>
+void EpochDomain<T>::leave(const Pin& pin)
+{
+    mSlots[pin.slot].active[pin.parity].fetch_sub(1, std::memory_order_release);
+}
+
+/**
+* Hands over an object that readers can no longer reach from the structure, then reclaims whatever
+* has become safe.
+*/
+template<typename T>
+void EpochDomain<T>::retire(T* object)
+{
+    {
+        std::lock_guard<std::mutex> guard(mRetireLock);
+        mRetired.push_back(std::make_pair(mEpoch.load(std::memory_order_seq_cst), object));
+    }
+    collect();
+}
+
+/**
+* Advances the epoch if no reader holds it back and reclaims every object retired two epochs ago or
+* earlier. Never waits for readers.
+*/
+template<typename T>
+void EpochDomain<T>::collect()
+{
+    tryAdvance();
+    reclaimUpTo(mEpoch.load(std::memory_order_seq_cst) - 2);
+}
+
+/**
+* Waits for every reader pinned now to leave and reclaims everything retired so far.
+*/
+template<typename T>
+void EpochDomain<T>::synchronize()
+{
+    for(int advanced = 0; advanced < 2; )
+    {
+        if(tryAdvance())
+        {
+            ++advanced;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    reclaimUpTo(mEpoch.load(std::memory_order_seq_cst) - 2);
+}
+
+/**
+* Moves the epoch from e to e+1 if no reader is still pinned to e-1.
+*/
+template<typename T>
+bool EpochDomain<T>::tryAdvance()
+{
+    std::uint64_t epoch = mEpoch.load(std::memory_order_seq_cst);
+    unsigned previous = (unsigned)((epoch - 1) & 1);
+    for(std::size_t i = 0; i < kSlots; ++i)
+    {
+        if(mSlots[i].active[previous].load(std::memory_order_seq_cst) != 0)
+        {
+            return false;
+        }
+    }
+    return mEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+template<typename T>
+void EpochDomain<T>::reclaimUpTo(std::uint64_t epoch)
+{
+    std::deque<std::pair<std::uint64_t, T*> > ready;
+    {
+        std::lock_guard<std::mutex> guard(mRetireLock);
+        while(!mRetired.empty() && mRetired.front().first <= epoch)
+        {
+            ready.push_back(mRetired.front());
+            mRetired.pop_front();
+        }
+    }
+    for(std::size_t i = 0; i < ready.size(); ++i)
+    {
+        mReclaim(ready[i].second);
+    }
+}
+
+/**
+* Deals slots out to threads round robin, once per thread.
+*/
+template<typename T>
+std::size_t EpochDomain<T>::slotOfThisThread()
+{
+    static std::atomic<std::size_t> nextSlot(0);
+    static thread_local std::size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % kSlots;
+    return slot;
+}
+
+/*
+------------------------------------------------
+End implementations for the EpochDomain class.
+------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef FROZEN_AVLBST_H
+#define FROZEN_AVLBST_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "key_compare.h"
+
+/**
+* An immutable, pointer free copy of an ordered map for trees that are built once and then only read,
+* made with AVLTree::freeze. The keys are laid out in Eytzinger order: the implicit complete binary tree
+* stored breadth first, with the children of position k at 2k and 2k+1. The top levels of every search
+* share the first few cache lines, each step down is an index computation instead of a pointer load,
+* and the next position is picked with a comparison folded into the index, so the loop has no data
+* dependent branch. For arithmetic keys a whole cache line of keys four levels further down is
+* prefetched on every step, which overlaps the misses of consecutive levels.
+*
+* The keys are kept in an array of their own so that a search only touches keys. The pairs are stored
+* alongside in the same order for the iterators. Compare is the order of the tree it was frozen from.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenAVLTree
+{
+public:
+    /**
+    * Forward iterator in key order. It walks the implicit tree, so it holds a position and no path.
+    */
+    class iterator
+    {
+        public:
+            iterator();
+
+            const std::pair<Key, Value>& operator*() const;
+            const std::pair<Key, Value>* operator->() const;
+            bool operator==(const iterator& rhs) const;
+            bool operator!=(const iterator& rhs) const;
+            iterator& operator++();
+
+        private:
+            friend class FrozenAVLTree<Key, Value, Compare>;
+            iterator(const FrozenAVLTree<Key, Value, Compare>* tree, std::size_t position);
+
+            const FrozenAVLTree<Key, Value, Compare>* mTree;
+            // Eytzinger position, 0 past the end.
+            std::size_t mPosition;
+    };
+
+    explicit FrozenAVLTree(const Compare& compare = Compare());
+    // Takes count pairs in strictly increasing key order from first.
+    template<typename Iterator>
+    FrozenAVLTree(Iterator first, std::size_t count, const Compare& compare = Compare());
+
+    std::size_t size() const;
+    bool empty() const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    bool contains(const Key& key) const;
+
+private:
+    template<typename Iterator>
+    void fill(Iterator& next, std::size_t position);
+    std::size_t lowerBoundPosition(const Key& key) const;
+
+    // A cache line of keys: the descendants of a position four levels down for 4 byte keys.
+    static const std::size_t kPrefetchBlock = sizeof(Key) < 64 ? 64 / sizeof(Key) : 1;
+
+    Compare mCompare;
+    std::size_t mSize;
+    // Both indexed by Eytzinger position, slot 0 only holds a default constructed key.
+    std::vector<Key> mKeys;
+    std::vector<std::pair<Key, Value> > mItems;
+};
+
+/*
+------------------------------------------------------------
+Begin implementations for the FrozenAVLTree::iterator class.
+------------------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+FrozenAVLTree<Key, Value, Compare>::iterator::iterator()
+    : mTree(NULL)
+    , mPosition(0)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+FrozenAVLTree<Key, Value, Compare>::iterator::iterator(const FrozenAVLTree<Key, Value, Compare>* tree, std::size_t position)
+    : mTree(tree)
+    , mPosition(position)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+const std::pair<Key, Value>& FrozenAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return mTree->mItems[mPosition];
+}
+
+template<typename Key, typename Value, typename Compare>
+const std::pair<Key, Value>* FrozenAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &mTree->mItems[mPosition];
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return mPosition == rhs.mPosition;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return mPosition != rhs.mPosition;
+}
+
+/**
+* In order successor in the implicit tree: the leftmost position of the right subtree if there is one,
+* otherwise the parent of the highest ancestor reached through right children.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenAVLTree<Key, Value, Compare>::iterator& FrozenAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    std::size_t next = 2 * mPosition + 1;
+    if(next <= mTree->mSize)
+    {
+        while(2 * next <= mTree->mSize)
+        {
+            next = 2 * next;
+        }
+        mPosition = next;
+        return *this;
+    }
+    while(mPosition & 1)
+    {
+        mPosition >>= 1;
+    }
+    mPosition >>= 1;
+    return *this;
+}
+
+/*
+----------------------------------------------------------
+End implementations for the FrozenAVLTree::iterator class.
+----------------------------------------------------------
+*/
+
+/*
+--------------------------------------------------
+Begin implementations for the FrozenAVLTree class.
+--------------------------------------------------
+*/
+
+template<typename Key, typename Value, typename Compare>
+FrozenAVLTree<Key, Value, Compare>::FrozenAVLTree(const Compare& compare)
+    : mCompare(compare)
+    , mSize(0)
+    , mKeys(1)
+    , mItems(1)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+template<typename Iterator>
+FrozenAVLTree<Key, Value, Compare>::FrozenAVLTree(Iterator first, std::size_t count, const Compare& compare)
+    : mCompare(compare)
+    , mSize(count)
+    , mKeys(count + 1)
+    , mItems(count + 1)
+{
+    fill(first, 1);
+}
+
+/**
+* Helper function for the constructor. Hands out the sorted pairs to the positions of the implicit tree
+* under position in order.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename Iterator>
+void FrozenAVLTree<Key, Value, Compare>::fill(Iterator& next, std::size_t position)
+{
+    if(position > mSize)
+    {
+        return;
+    }
+    fill(next, 2 * position);
+    mItems[position] = *next;
+    mKeys[position] = mItems[position].first;
+    ++next;
+    fill(next, 2 * position + 1);
+}
+
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenAVLTree<Key, Value, Compare>::size() const
+{
+    return mSize;
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenAVLTree<Key, Value, Compare>::empty() const
+{
+    return mSize == 0;
+}
+
+/**
+* The leftmost position is the first in key order.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenAVLTree<Key, Value, Compare>::iterator FrozenAVLTree<Key, Value, Compare>::begin() const
+{
+    std::size_t position = mSize == 0 ? 0 : 1;
+    while(position != 0 && 2 * position <= mSize)
+    {
+        position = 2 * position;
+    }
+    return iterator(this, position);
+}
+
+template<typename Key, typename Value, typename Compare>
+typename FrozenAVLTree<Key, Value, Compare>::iterator FrozenAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator(this, 0);
+}
+
+/**
+* Descends the implicit tree all the way to a leaf, going right exactly when the key at the current
+* position comes before key. The bits of the final index record the turns. The lower bound is the last
+* position where the search went left, found by dropping the trailing right turns and the left turn
+* before them. Returns 0 if every key is less than key.
+*/
+template<typename Key, typename Value, typename Compare>
+std::size_t FrozenAVLTree<Key, Value, Compare>::lowerBoundPosition(const Key& key) const
+{
+    const Key* keys = mKeys.data();
+    std::size_t position = 1;
+    while(position <= mSize)
+    {
+#if defined(__GNUC__)
+        if(std::is_arithmetic<Key>::value && kPrefetchBlock * position <= mSize)
+        {
+            __builtin_prefetch(keys + kPrefetchBlock * position);
+        }
+#endif
+        position = 2 * position + lessWith(mCompare, keys[position], key);
+    }
+#if defined(__GNUC__)
+    return position >> (__builtin_ctzll(~(unsigned long long)position) + 1);
+#else
+    while(position & 1)
+    {
+        position >>= 1;
+    }
+    return position >> 1;
+#endif
+}
+
+/**
+* Iterator to the first key that is not less than key.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenAVLTree<Key, Value, Compare>::iterator FrozenAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return iterator(this, lowerBoundPosition(key));
+}
+
+/**
+* Slot 0 always exists, so the key there can be compared even when the lower bound is past the end. A
+* miss masks the position down to 0, the end, which compilers keep free of a branch where they would
+* turn a condition into one.
+*/
+template<typename Key, typename Value, typename Compare>
+typename FrozenAVLTree<Key, Value, Compare>::iterator FrozenAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t position = lowerBoundPosition(key);
+    position &= (std::size_t)0 - (std::size_t)!lessWith(mCompare, key, mKeys[position]);
+    return iterator(this, position);
+}
+
+template<typename Key, typename Value, typename Compare>
+bool FrozenAVLTree<Key, Value, Compare>::contains(const Key& key) const
+{
+    return find(key) != end();
+}
+
+/*
+------------------------------------------------
+End implementations for the FrozenAVLTree class.
+------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef KEY_COMPARE_H
+#define KEY_COMPARE_H
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 202002L
+#include <compare>
+#include <concepts>
+#endif
+
+/**
+* Key comparisons for the search trees. A tree's Compare is either a strict weak ordering that returns a
+* bool, like the default std::less<Key>, or a three way comparison that returns something to test against
+* 0, like std::compare_three_way or a function object returning an int. compareWith() turns either kind
+* into a single negative, zero or positive answer, so a descent can pick left, right or found after one
+* comparison per node. A bool Compare has to be called twice to tell equal from greater, except for
+* std::less on keys that can compare three ways themselves, whose own comparison is used instead, and
+* on arithmetic keys, where a comparison is one instruction.
+*
+* The two sides need not have the same type. A transparent Compare, one with an is_transparent member
+* type like std::less<>, lets a tree be searched with anything comparable to its keys, such as a
+* std::string_view for std::string keys.
+*/
+
+/**
+* Tells whether calling Compare on a Key and an Other gives a three way result rather than a bool.
+*/
+template <typename Compare, typename Key, typename Other = Key>
+struct IsThreeWayCompare
+    : std::integral_constant<bool, !std::is_same<typename std::decay<decltype(std::declval<const Compare&>()(
+        std::declval<const Key&>(), std::declval<const Other&>()))>::type, bool>::value>
+{
+};
+
+/**
+* Tells whether a key type has a compare() member taking an Other that returns an int, like std::string.
+*/
+template <typename Key, typename Other = Key, typename = void>
+struct KeyHasCompareMember : std::false_type
+{
+};
+
+template <typename Key, typename Other>
+struct KeyHasCompareMember<Key, Other, std::void_t<decltype(std::declval<const Key&>().compare(std::declval<const Other&>()))> >
+    : std::is_convertible<decltype(std::declval<const Key&>().compare(std::declval<const Other&>())), int>
+{
+};
+
+/**
+* Tells whether Compare is plain std::less, whose order is the key's own order.
+*/
+template <typename Compare, typename Key>
+struct IsStdLess
+    : std::integral_constant<bool, std::is_same<Compare, std::less<Key> >::value || std::is_same<Compare, std::less<> >::value>
+{
+};
+
+/**
+* Compares a to b under compare. Returns a negative number if a comes first, a positive one if b does and
+* 0 if they are equivalent.
+*/
+template <typename Compare, typename Key, typename Other>
+int compareWith(const Compare& compare, const Key& a, const Other& b)
+{
+    if constexpr(IsThreeWayCompare<Compare, Key, Other>::value)
+    {
+        auto order = compare(a, b);
+        return (order > 0) - (order < 0);
+    }
+    else if constexpr(IsStdLess<Compare, Key>::value && std::is_arithmetic<Key>::value && std::is_arithmetic<Other>::value)
+    {
+        //written so that the compiler folds it back into a single compare whose flags the caller branches on
+        return a == b ? 0 : (a < b ? -1 : 1);
+    }
+#if __cplusplus >= 202002L
+    else if constexpr(IsStdLess<Compare, Key>::value && std::three_way_comparable_with<Key, Other>)
+    {
+        auto order = a <=> b;
+        return (order > 0) - (order < 0);
+    }
+#endif
+    else if constexpr(IsStdLess<Compare, Key>::value && KeyHasCompareMember<Key, Other>::value)
+    {
+        int order = a.compare(b);
+        return (order > 0) - (order < 0);
+    }
+    else if constexpr(IsStdLess<Compare, Key>::value && KeyHasCompareMember<Other, Key>::value)
+    {
+        //a plain C string searched for among std::string keys
+        int order = b.compare(a);
+        return (order < 0) - (order > 0);
+    }
+    else
+    {
+        if(compare(a, b))
+        {
+            return -1;
+        }
+        return compare(b, a) ? 1 : 0;
+    }
+}
+
+/**
+* Whether a comes strictly before b under compare. One call for either kind of Compare.
+*/
+template <typename Compare, typename Key, typename Other>
+bool lessWith(const Compare& compare, const Key& a, const Other& b)
+{
+    if constexpr(IsThreeWayCompare<Compare, Key, Other>::value)
+    {
+        return compare(a, b) < 0;
+    }
+    else
+    {
+        return compare(a, b);
+    }
+}
+
+#endif
@@ -0,0 +1,470 @@
+#ifndef NODE_ALLOCATOR_H
+#define NODE_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <mutex>
+
+/**
+* Allocator policies for the nodes of a BinarySearchTree. A policy hands out raw storage for one node at a
+* time through allocate()/deallocate() and can optionally drop every node it ever handed out in one call to
+* release(). kReleasesAll tells the tree whether release() actually frees outstanding nodes, in which case
+* clear() does not need to visit them one by one, and also whether nodes are tied to the allocator that made
+* them. adopt() takes over everything another allocator of the same type has handed out, so that whole trees
+* can be moved between tree objects without copying their nodes.
+*/
+
+/**
+* The plain policy: every node is its own allocation on the global heap.
+*/
+class HeapNodeAllocator
+{
+public:
+	static const bool kReleasesAll = false;
+
+	void* allocate(std::size_t size, std::size_t alignment);
+	void deallocate(void* ptr);
+	void release();
+	void adopt(HeapNodeAllocator& other);
+};
+
+/**
+* Slab arena for fixed size nodes. Nodes are carved out of large contiguous blocks, removed nodes go onto a
+* free list and are handed out again before the arena grows, and release() frees all of the blocks at once.
+* Blocks start small and double in size so that tiny trees do not pay for a large block up front.
+* An arena only ever serves one node size, which is fixed by the first call to allocate().
+*/
+class SlabNodeAllocator
+{
+public:
+	static const bool kReleasesAll = true;
+
+	SlabNodeAllocator();
+	~SlabNodeAllocator();
+
+	void* allocate(std::size_t size, std::size_t alignment);
+	void deallocate(void* ptr);
+	void release();
+	void adopt(SlabNodeAllocator& other);
+
+private:
+	SlabNodeAllocator(const SlabNodeAllocator&);
+	SlabNodeAllocator& operator=(const SlabNodeAllocator&);
+
+	void grow();
+
+	// Free slots and blocks are both threaded through their own first bytes.
+	struct FreeSlot
+	{
+		FreeSlot* next;
+	};
+	struct BlockHeader
+	{
+		BlockHeader* next;
+	};
+
+	static const std::size_t kFirstBlockSlots = 16;
+	static const std::size_t kMaxBlockSlots = 4096;
+
+	BlockHeader* mBlocks;
+	FreeSlot* mFreeList;
+	FreeSlot* mFreeTail;
+	char* mCursor;
+	char* mEnd;
+	std::size_t mSlotSize;
+	std::size_t mBlockSlots;
+};
+
+/**
+* Number of index bits needed to number the given count of slots.
+*/
+constexpr unsigned nodePoolSlotBits(std::size_t slots, unsigned bits = 0)
+{
+	return (std::size_t(1) << bits) >= slots ? bits : nodePoolSlotBits(slots, bits + 1);
+}
+
+/**
+* A process-wide pool of NodeType slots that are addressed by 32-bit indices instead of pointers, so that
+* nodes can link to each other with 4 bytes per link. Index 0 stands for NULL.
+*
+* Slots live in blocks of kBlockBytes that are aligned to their own size and never move. An index is the
+* block number in the high bits and the slot within the block in the low bits. Going from an index to a
+* pointer is one lookup in a table of slot base addresses, whose entry for block 0 is left at 0 so that
+* index 0 decodes to NULL without a branch. Going from a pointer to an index reads the block number from the
+* header found by masking the pointer. Allocation and deallocation take a lock; converting between pointers
+* and indices does not, since table entries are written once before any slot of their block is handed out.
+*/
+template <typename NodeType>
+class NodePool
+{
+public:
+	static NodePool& instance();
+
+	void* allocate();
+	void deallocate(void* ptr);
+
+	static NodeType* pointerTo(std::uint32_t index);
+	static std::uint32_t indexOf(const NodeType* node);
+
+private:
+	NodePool();
+	NodePool(const NodePool&);
+	NodePool& operator=(const NodePool&);
+
+	static const std::size_t kBlockBytes = std::size_t(1) << 21;
+	static const std::size_t kHeaderBytes = alignof(NodeType) > sizeof(std::uint32_t) ? alignof(NodeType) : sizeof(std::uint32_t);
+	static const std::size_t kBlockSlots = (kBlockBytes - kHeaderBytes) / sizeof(NodeType);
+	static const unsigned kSlotBits = nodePoolSlotBits(kBlockSlots);
+	static const std::size_t kMaxBlocks = std::size_t(1) << (32 - kSlotBits);
+
+	// Address of slot 0 of every block. This is static so that decoding an index does not go
+	// through instance(), and zero-initialized so that its untouched pages are never committed.
+	static std::uintptr_t sSlotBase[kMaxBlocks];
+
+	std::mutex mLock;
+	std::uint32_t mFreeList;
+	std::size_t mBlockCount;
+	std::size_t mNextSlot;
+};
+
+/**
+* Allocator policy that hands out NodePool slots. The pool is shared by every tree using the same node type,
+* so nodes are always returned one at a time.
+*/
+template <typename NodeType>
+class NodePoolAllocator
+{
+public:
+	static const bool kReleasesAll = false;
+
+	void* allocate(std::size_t size, std::size_t alignment);
+	void deallocate(void* ptr);
+	void release();
+	void adopt(NodePoolAllocator& other);
+};
+
+/*
+	---------------------------------------------------
+	Begin implementations for the HeapNodeAllocator class.
+	---------------------------------------------------
+*/
+
+inline void* HeapNodeAllocator::allocate(std::size_t size, std::size_t)
+{
+	return ::operator new(size);
+}
+
+inline void HeapNodeAllocator::deallocate(void* ptr)
+{
+	::operator delete(ptr);
+}
+
+/**
+* Nodes are freed individually, so there is nothing left to drop.
+*/
+inline void HeapNodeAllocator::release()
+{
+}
+
+/**
+* Heap nodes do not belong to any allocator object, so there is nothing to take over.
+*/
+inline void HeapNodeAllocator::adopt(HeapNodeAllocator&)
+{
+}
+
+/*
+	---------------------------------------------------
+	Begin implementations for the SlabNodeAllocator class.
+	---------------------------------------------------
+*/
+
+inline SlabNodeAllocator::SlabNodeAllocator()
+	: mBlocks(NULL)
+	, mFreeList(NULL)
+	, mFreeTail(NULL)
+	, mCursor(NULL)
+	, mEnd(NULL)
+	, mSlotSize(0)
+	, mBlockSlots(kFirstBlockSlots)
+{
+
+}
+
+inline SlabNodeAllocator::~SlabNodeAllocator()
+{
+	release();
+}
+
+/**
+* Returns a slot from the free list if there is one, otherwise the next unused slot of the newest block.
+*/
+inline void* SlabNodeAllocator::allocate(std::size_t size, std::size_t alignment)
+{
+	if(mSlotSize == 0)
+	{
+		//round the slot up so every slot in a block stays aligned, and large enough to hold a free list link
+		if(size < sizeof(FreeSlot))
+		{
+			size = sizeof(FreeSlot);
+		}
+		if(alignment < alignof(FreeSlot))
+		{
+			alignment = alignof(FreeSlot);
+		}
+		mSlotSize = (size + alignment - 1) / alignment * alignment;
+	}
+	if(mFreeList != NULL)
+	{
+		FreeSlot* slot = mFreeList;
+		mFreeList = slot->next;
+		if(mFreeList == NULL)
+		{
+			mFreeTail = NULL;
+		}
+		return slot;
+	}
+	if(mCursor == mEnd)
+	{
+		grow();
+	}
+	void* slot = mCursor;
+	mCursor += mSlotSize;
+	return slot;
+}
+
+/**
+* Pushes the slot onto the free list. The memory stays with the arena until release().
+*/
+inline void SlabNodeAllocator::deallocate(void* ptr)
+{
+	FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+	slot->next = mFreeList;
+	if(mFreeList == NULL)
+	{
+		mFreeTail = slot;
+	}
+	mFreeList = slot;
+}
+
+/**
+* Frees every block in O(blocks). Any node still handed out becomes invalid.
+*/
+inline void SlabNodeAllocator::release()
+{
+	while(mBlocks != NULL)
+	{
+		BlockHeader* next = mBlocks->next;
+		::operator delete(mBlocks);
+		mBlocks = next;
+	}
+	mFreeList = NULL;
+	mFreeTail = NULL;
+	mCursor = NULL;
+	mEnd = NULL;
+	mBlockSlots = kFirstBlockSlots;
+}
+
+/**
+* Splices other's blocks and free list onto this arena, leaving other empty. Both arenas must serve the
+* same node size. Only the larger of the two unused block tails stays available, the other one is lost
+* until release().
+*/
+inline void SlabNodeAllocator::adopt(SlabNodeAllocator& other)
+{
+	if(&other == this || other.mBlocks == NULL)
+	{
+		return;
+	}
+	if(mSlotSize == 0)
+	{
+		mSlotSize = other.mSlotSize;
+	}
+	BlockHeader* last = other.mBlocks;
+	while(last->next != NULL)
+	{
+		last = last->next;
+	}
+	last->next = mBlocks;
+	mBlocks = other.mBlocks;
+	if(other.mFreeList != NULL)
+	{
+		other.mFreeTail->next = mFreeList;
+		if(mFreeList == NULL)
+		{
+			mFreeTail = other.mFreeTail;
+		}
+		mFreeList = other.mFreeList;
+	}
+	if(other.mEnd - other.mCursor > mEnd - mCursor)
+	{
+		mCursor = other.mCursor;
+		mEnd = other.mEnd;
+	}
+	if(other.mBlockSlots > mBlockSlots)
+	{
+		mBlockSlots = other.mBlockSlots;
+	}
+	other.mBlocks = NULL;
+	other.mFreeList = NULL;
+	other.mFreeTail = NULL;
+	other.mCursor = NULL;
+	other.mEnd = NULL;
+	other.mBlockSlots = kFirstBlockSlots;
+}
+
+/**
+* Allocates a new block with room for mBlockSlots slots, after a header padded to keep the slots aligned.
+*/
+inline void SlabNodeAllocator::grow()
+{
+	std::size_t headerSize = (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+	char* raw = static_cast<char*>(::operator new(headerSize + mSlotSize * mBlockSlots));
+	BlockHeader* block = reinterpret_cast<BlockHeader*>(raw);
+	block->next = mBlocks;
+	mBlocks = block;
+	mCursor = raw + headerSize;
+	mEnd = mCursor + mSlotSize * mBlockSlots;
+	if(mBlockSlots < kMaxBlockSlots)
+	{
+		mBlockSlots *= 2;
+	}
+}
+
+/*
+	------------------------------------------
+	Begin implementations for the NodePool class.
+	------------------------------------------
+*/
+
+/**
+* The pool for NodeType, created on first use.
+*/
+template<typename NodeType>
+NodePool<NodeType>& NodePool<NodeType>::instance()
+{
+	static NodePool<NodeType> pool;
+	return pool;
+}
+
+template<typename NodeType>
+std::uintptr_t NodePool<NodeType>::sSlotBase[NodePool<NodeType>::kMaxBlocks];
+
+/**
+* Block number 0 is reserved for NULL, so the first real block is block 1.
+*/
+template<typename NodeType>
+NodePool<NodeType>::NodePool()
+	: mFreeList(0)
+	, mBlockCount(1)
+	, mNextSlot(kBlockSlots)
+{
+
+}
+
+/**
+* Reuses a free slot if there is one, otherwise takes the next slot of the newest block.
+*/
+template<typename NodeType>
+void* NodePool<NodeType>::allocate()
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	if(mFreeList != 0)
+	{
+		NodeType* slot = pointerTo(mFreeList);
+		mFreeList = *reinterpret_cast<std::uint32_t*>(slot);
+		return slot;
+	}
+	if(mNextSlot == kBlockSlots)
+	{
+		if(mBlockCount == kMaxBlocks)
+		{
+			throw std::bad_alloc();
+		}
+		char* block = static_cast<char*>(::operator new(kBlockBytes, std::align_val_t(kBlockBytes)));
+		*reinterpret_cast<std::uint32_t*>(block) = (std::uint32_t)mBlockCount;
+		sSlotBase[mBlockCount] = reinterpret_cast<std::uintptr_t>(block + kHeaderBytes);
+		mNextSlot = 0;
+		++mBlockCount;
+	}
+	return reinterpret_cast<char*>(sSlotBase[mBlockCount - 1]) + sizeof(NodeType) * mNextSlot++;
+}
+
+/**
+* Threads the slot onto the free list by storing the previous head's index in it.
+*/
+template<typename NodeType>
+void NodePool<NodeType>::deallocate(void* ptr)
+{
+	std::lock_guard<std::mutex> guard(mLock);
+	std::uint32_t index = indexOf(static_cast<NodeType*>(ptr));
+	*static_cast<std::uint32_t*>(ptr) = mFreeList;
+	mFreeList = index;
+}
+
+/**
+* Index 0 decodes to NULL through the table entry of block 0, so there is no branch.
+*/
+template<typename NodeType>
+NodeType* NodePool<NodeType>::pointerTo(std::uint32_t index)
+{
+	std::uintptr_t slot = index & ((std::uint32_t(1) << kSlotBits) - 1);
+	return reinterpret_cast<NodeType*>(sSlotBase[index >> kSlotBits] + slot * sizeof(NodeType));
+}
+
+template<typename NodeType>
+std::uint32_t NodePool<NodeType>::indexOf(const NodeType* node)
+{
+	if(node == NULL)
+	{
+		return 0;
+	}
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(node);
+	std::uintptr_t block = address & ~std::uintptr_t(kBlockBytes - 1);
+	std::uint32_t blockNumber = *reinterpret_cast<const std::uint32_t*>(block);
+	std::uintptr_t slot = (address - block - kHeaderBytes) / sizeof(NodeType);
+	return (blockNumber << kSlotBits) | (std::uint32_t)slot;
+}
+
+/*
+	---------------------------------------------------
+	Begin implementations for the NodePoolAllocator class.
+	---------------------------------------------------
+*/
+
+template<typename NodeType>
+void* NodePoolAllocator<NodeType>::allocate(std::size_t, std::size_t)
+{
+	return NodePool<NodeType>::instance().allocate();
+}
+
+template<typename NodeType>
+void NodePoolAllocator<NodeType>::deallocate(void* ptr)
+{
+	NodePool<NodeType>::instance().deallocate(ptr);
+}
+
+/**
+* Nodes are returned to the shared pool individually, so there is nothing left to drop.
+*/
+template<typename NodeType>
+void NodePoolAllocator<NodeType>::release()
+{
+}
+
+/**
+* All trees of a node type already share one pool, so there is nothing to take over.
+*/
+template<typename NodeType>
+void NodePoolAllocator<NodeType>::adopt(NodePoolAllocator&)
+{
+}
+
+/*
+	-------------------------------------------------
+	End implementations for the allocator policies.
+	-------------------------------------------------
+*/
+
+#endif
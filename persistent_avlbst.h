@@ -0,0 +1,718 @@
+#ifndef PERSISTENT_AVLBST_H
+#define PERSISTENT_AVLBST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+* A node of a persistent AVL tree. Nodes never change once they are built and are shared between every
+* version of the tree that contains them, so they have no parent link and are kept alive by a reference
+* count instead of by a single owner. The count is atomic so that versions held by different threads can
+* be dropped independently.
+*/
+template <typename Key, typename Value>
+class PersistentAVLNode
+{
+public:
+    PersistentAVLNode(const std::pair<Key, Value>& item, PersistentAVLNode<Key, Value>* left, PersistentAVLNode<Key, Value>* right);
+
+    const std::pair<Key, Value>& getItem() const;
+    const Key& getKey() const;
+    const Value& getValue() const;
+    PersistentAVLNode<Key, Value>* getLeft() const;
+    PersistentAVLNode<Key, Value>* getRight() const;
+    int getHeight() const;
+
+    void acquire() const;
+    bool drop() const;
+
+protected:
+    std::pair<Key, Value> mItem;
+    PersistentAVLNode<Key, Value>* mLeft;
+    PersistentAVLNode<Key, Value>* mRight;
+    mutable std::atomic<std::uint32_t> mRefs;
+    signed char mHeight;
+};
+
+/**
+* The path copying operations behind the persistent and the copy-on-write trees. Every function takes
+* tree versions by root and builds a new version out of fresh nodes along the search path, sharing all
+* other subtrees with the old version. Rotations build new nodes too instead of relinking existing ones,
+* since a node may belong to other versions. Functions that return a node return a reference that the
+* caller owns; arguments named left/right are references handed over to the function.
+*/
+template <typename Key, typename Value>
+class PathCopyAVL
+{
+public:
+    typedef PersistentAVLNode<Key, Value> NodeType;
+
+    static NodeType* acquire(NodeType* node);
+    static void release(NodeType* node);
+
+    static NodeType* insertCopy(NodeType* node, const std::pair<Key, Value>& keyValuePair, bool& added);
+    static NodeType* removeCopy(NodeType* node, const Key& key, bool& removed);
+
+    static NodeType* findNode(NodeType* node, const Key& key);
+
+private:
+    static int heightOf(const NodeType* node);
+    static NodeType* make(const std::pair<Key, Value>& item, NodeType* left, NodeType* right);
+    static NodeType* balance(const std::pair<Key, Value>& item, NodeType* left, NodeType* right);
+    static NodeType* removeFirstCopy(NodeType* node, const NodeType*& first);
+};
+
+/**
+* An in-order iterator over a version of a persistent AVL tree. Nodes have no parent links, so the
+* iterator keeps the path from the root. It stays valid as long as the version it walks is kept alive.
+*/
+template <typename Key, typename Value>
+class PersistentAVLIterator
+{
+public:
+    typedef PersistentAVLNode<Key, Value> NodeType;
+
+    PersistentAVLIterator();
+
+    const std::pair<Key, Value>& operator*() const;
+    const std::pair<Key, Value>* operator->() const;
+
+    bool operator==(const PersistentAVLIterator<Key, Value>& rhs) const;
+    bool operator!=(const PersistentAVLIterator<Key, Value>& rhs) const;
+
+    PersistentAVLIterator<Key, Value>& operator++();
+
+    // Positions in the version under root.
+    static PersistentAVLIterator<Key, Value> first(NodeType* root);
+    static PersistentAVLIterator<Key, Value> lowerBound(NodeType* root, const Key& key);
+    static PersistentAVLIterator<Key, Value> find(NodeType* root, const Key& key);
+
+protected:
+    void descendLeft(NodeType* node);
+
+    // Ancestors still to be visited, with the current node on top.
+    std::vector<NodeType*> mPath;
+};
+
+/**
+* A read only version of a persistent AVL tree. Copying a view is O(1) and it stays valid and unchanged
+* no matter what happens to the tree it was taken from.
+*/
+template <typename Key, typename Value>
+class PersistentAVLView
+{
+public:
+    typedef PersistentAVLNode<Key, Value> NodeType;
+
+    PersistentAVLView();
+    PersistentAVLView(const PersistentAVLView<Key, Value>& other);
+    PersistentAVLView<Key, Value>& operator=(const PersistentAVLView<Key, Value>& other);
+    ~PersistentAVLView();
+
+    typedef PersistentAVLIterator<Key, Value> iterator;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+
+protected:
+    NodeType* mRoot;
+    std::size_t mSize;
+};
+
+/**
+* A persistent AVL tree. insert and remove copy only the O(log n) nodes on the search path, and
+* snapshot() hands out the current version in O(1), which no later update can change.
+*/
+template <typename Key, typename Value>
+class PersistentAVLTree : public PersistentAVLView<Key, Value>
+{
+public:
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    PersistentAVLView<Key, Value> snapshot() const;
+};
+
+/*
+------------------------------------------------------
+Begin implementations for the PersistentAVLNode class.
+------------------------------------------------------
+*/
+
+/**
+* Builds a node over two subtrees, taking over the caller's references to them. The new node starts out
+* with one reference, owned by the caller.
+*/
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>::PersistentAVLNode(const std::pair<Key, Value>& item, PersistentAVLNode<Key, Value>* left, PersistentAVLNode<Key, Value>* right)
+    : mItem(item)
+    , mLeft(left)
+    , mRight(right)
+    , mRefs(1)
+{
+    int leftHeight = left == NULL ? 0 : left->getHeight();
+    int rightHeight = right == NULL ? 0 : right->getHeight();
+    mHeight = (signed char)((leftHeight > rightHeight ? leftHeight : rightHeight) + 1);
+}
+
+template<typename Key, typename Value>
+const std::pair<Key, Value>& PersistentAVLNode<Key, Value>::getItem() const
+{
+    return mItem;
+}
+
+template<typename Key, typename Value>
+const Key& PersistentAVLNode<Key, Value>::getKey() const
+{
+    return mItem.first;
+}
+
+template<typename Key, typename Value>
+const Value& PersistentAVLNode<Key, Value>::getValue() const
+{
+    return mItem.second;
+}
+
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getLeft() const
+{
+    return mLeft;
+}
+
+template<typename Key, typename Value>
+PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getRight() const
+{
+    return mRight;
+}
+
+template<typename Key, typename Value>
+int PersistentAVLNode<Key, Value>::getHeight() const
+{
+    return mHeight;
+}
+
+template<typename Key, typename Value>
+void PersistentAVLNode<Key, Value>::acquire() const
+{
+    mRefs.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+* Gives up one reference. Returns true if it was the last one, in which case the caller frees the node.
+*/
+template<typename Key, typename Value>
+bool PersistentAVLNode<Key, Value>::drop() const
+{
+    return mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+/*
+----------------------------------------------------
+End implementations for the PersistentAVLNode class.
+----------------------------------------------------
+*/
+
+/*
+------------------------------------------------
+Begin implementations for the PathCopyAVL class.
+------------------------------------------------
+*/
+
+/**
+* Adds a reference to a possibly NULL node and returns it.
+*/
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::acquire(NodeType* node)
+{
+    if(node != NULL)
+    {
+        node->acquire();
+    }
+    return node;
+}
+
+/**
+* Drops a reference to a possibly NULL node, freeing it and releasing its children if it was the last.
+* The walk only continues into subtrees that are no longer shared with any other version.
+*/
+template<typename Key, typename Value>
+void PathCopyAVL<Key, Value>::release(NodeType* node)
+{
+    while(node != NULL && node->drop())
+    {
+        NodeType* left = node->getLeft();
+        NodeType* right = node->getRight();
+        delete node;
+        release(left);
+        node = right;
+    }
+}
+
+template<typename Key, typename Value>
+int PathCopyAVL<Key, Value>::heightOf(const NodeType* node)
+{
+    return node == NULL ? 0 : node->getHeight();
+}
+
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::make(const std::pair<Key, Value>& item, NodeType* left, NodeType* right)
+{
+    return new NodeType(item, left, right);
+}
+
+/**
+* Builds a node over two subtrees whose heights differ by at most two, with a single or double rotation
+* when they differ by two. The rotated nodes are rebuilt and the replaced child is released.
+*/
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::balance(const std::pair<Key, Value>& item, NodeType* left, NodeType* right)
+{
+    int leftHeight = heightOf(left);
+    int rightHeight = heightOf(right);
+    //left heavy
+    if(leftHeight > rightHeight + 1)
+    {
+        NodeType* result;
+        //single rotation to the right
+        if(heightOf(left->getLeft()) >= heightOf(left->getRight()))
+        {
+            result = make(left->getItem(), acquire(left->getLeft()), make(item, acquire(left->getRight()), right));
+        }
+        //zig zag going left
+        else
+        {
+            NodeType* middle = left->getRight();
+            result = make(middle->getItem(),
+                make(left->getItem(), acquire(left->getLeft()), acquire(middle->getLeft())),
+                make(item, acquire(middle->getRight()), right));
+        }
+        release(left);
+        return result;
+    }
+    //right heavy
+    if(rightHeight > leftHeight + 1)
+    {
+        NodeType* result;
+        //single rotation to the left
+        if(heightOf(right->getRight()) >= heightOf(right->getLeft()))
+        {
+            result = make(right->getItem(), make(item, left, acquire(right->getLeft())), acquire(right->getRight()));
+        }
+        //zig zag going right
+        else
+        {
+            NodeType* middle = right->getLeft();
+            result = make(middle->getItem(),
+                make(item, left, acquire(middle->getLeft())),
+                make(right->getItem(), acquire(middle->getRight()), acquire(right->getRight())));
+        }
+        release(right);
+        return result;
+    }
+    return make(item, left, right);
+}
+
+/**
+* Returns a new version of the subtree under node with the pair inserted, or its value replaced if the key
+* is already there. added tells which of the two happened. node itself is only borrowed.
+*/
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::insertCopy(NodeType* node, const std::pair<Key, Value>& keyValuePair, bool& added)
+{
+    if(node == NULL)
+    {
+        added = true;
+        return make(keyValuePair, NULL, NULL);
+    }
+    if(keyValuePair.first < node->getKey())
+    {
+        NodeType* left = insertCopy(node->getLeft(), keyValuePair, added);
+        return balance(node->getItem(), left, acquire(node->getRight()));
+    }
+    else if(node->getKey() < keyValuePair.first)
+    {
+        NodeType* right = insertCopy(node->getRight(), keyValuePair, added);
+        return balance(node->getItem(), acquire(node->getLeft()), right);
+    }
+    added = false;
+    return make(keyValuePair, acquire(node->getLeft()), acquire(node->getRight()));
+}
+
+/**
+* Returns a new version of the subtree under node without key. If key is not there the old version is
+* returned as is and nothing is copied. node itself is only borrowed.
+*/
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::removeCopy(NodeType* node, const Key& key, bool& removed)
+{
+    if(node == NULL)
+    {
+        removed = false;
+        return NULL;
+    }
+    if(key < node->getKey())
+    {
+        NodeType* left = removeCopy(node->getLeft(), key, removed);
+        if(!removed)
+        {
+            release(left);
+            return acquire(node);
+        }
+        return balance(node->getItem(), left, acquire(node->getRight()));
+    }
+    else if(node->getKey() < key)
+    {
+        NodeType* right = removeCopy(node->getRight(), key, removed);
+        if(!removed)
+        {
+            release(right);
+            return acquire(node);
+        }
+        return balance(node->getItem(), acquire(node->getLeft()), right);
+    }
+    removed = true;
+    if(node->getLeft() == NULL)
+    {
+        return acquire(node->getRight());
+    }
+    if(node->getRight() == NULL)
+    {
+        return acquire(node->getLeft());
+    }
+    //the successor takes the removed node's place
+    const NodeType* successor;
+    NodeType* right = removeFirstCopy(node->getRight(), successor);
+    return balance(successor->getItem(), acquire(node->getLeft()), right);
+}
+
+/**
+* Helper function for removeCopy. Returns a new version of a non-empty subtree without its smallest node,
+* which is handed back through first and stays alive as long as the borrowed subtree does.
+*/
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::removeFirstCopy(NodeType* node, const NodeType*& first)
+{
+    if(node->getLeft() == NULL)
+    {
+        first = node;
+        return acquire(node->getRight());
+    }
+    NodeType* left = removeFirstCopy(node->getLeft(), first);
+    return balance(node->getItem(), left, acquire(node->getRight()));
+}
+
+template<typename Key, typename Value>
+typename PathCopyAVL<Key, Value>::NodeType* PathCopyAVL<Key, Value>::findNode(NodeType* node, const Key& key)
+{
+    while(node != NULL)
+    {
+        if(key < node->getKey())
+        {
+            node = node->getLeft();
+        }
+        else if(node->getKey() < key)
+        {
+            node = node->getRight();
+        }
+        else
+        {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/*
+----------------------------------------------
+End implementations for the PathCopyAVL class.
+----------------------------------------------
+*/
+
+/*
+----------------------------------------------------------
+Begin implementations for the PersistentAVLIterator class.
+----------------------------------------------------------
+*/
+
+/**
+* A default iterator is the end iterator of every version.
+*/
+template<typename Key, typename Value>
+PersistentAVLIterator<Key, Value>::PersistentAVLIterator()
+{
+
+}
+
+template<typename Key, typename Value>
+const std::pair<Key, Value>& PersistentAVLIterator<Key, Value>::operator*() const
+{
+    return mPath.back()->getItem();
+}
+
+template<typename Key, typename Value>
+const std::pair<Key, Value>* PersistentAVLIterator<Key, Value>::operator->() const
+{
+    return &(mPath.back()->getItem());
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLIterator<Key, Value>::operator==(const PersistentAVLIterator<Key, Value>& rhs) const
+{
+    if(mPath.empty() || rhs.mPath.empty())
+    {
+        return mPath.empty() && rhs.mPath.empty();
+    }
+    return mPath.back() == rhs.mPath.back();
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLIterator<Key, Value>::operator!=(const PersistentAVLIterator<Key, Value>& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Pushes node and its chain of left children, leaving the smallest node of the subtree on top.
+*/
+template<typename Key, typename Value>
+void PersistentAVLIterator<Key, Value>::descendLeft(NodeType* node)
+{
+    while(node != NULL)
+    {
+        mPath.push_back(node);
+        node = node->getLeft();
+    }
+}
+
+/**
+* Advances the iterator's location using an in-order traversal. The path only keeps the ancestors that
+* come later in order, so the next node is either in the right subtree or the one below the top.
+*/
+template<typename Key, typename Value>
+PersistentAVLIterator<Key, Value>& PersistentAVLIterator<Key, Value>::operator++()
+{
+    NodeType* current = mPath.back();
+    mPath.pop_back();
+    descendLeft(current->getRight());
+    return *this;
+}
+
+template<typename Key, typename Value>
+PersistentAVLIterator<Key, Value> PersistentAVLIterator<Key, Value>::first(NodeType* root)
+{
+    PersistentAVLIterator<Key, Value> it;
+    it.descendLeft(root);
+    return it;
+}
+
+/**
+* The first item whose key is not smaller than key. The descent records every node where it turned left,
+* which are exactly the ancestors the iterator still has to visit.
+*/
+template<typename Key, typename Value>
+PersistentAVLIterator<Key, Value> PersistentAVLIterator<Key, Value>::lowerBound(NodeType* root, const Key& key)
+{
+    PersistentAVLIterator<Key, Value> it;
+    NodeType* node = root;
+    while(node != NULL)
+    {
+        if(node->getKey() < key)
+        {
+            node = node->getRight();
+        }
+        else
+        {
+            it.mPath.push_back(node);
+            if(!(key < node->getKey()))
+            {
+                break;
+            }
+            node = node->getLeft();
+        }
+    }
+    return it;
+}
+
+/**
+* The item with the given key, or the end iterator.
+*/
+template<typename Key, typename Value>
+PersistentAVLIterator<Key, Value> PersistentAVLIterator<Key, Value>::find(NodeType* root, const Key& key)
+{
+    PersistentAVLIterator<Key, Value> it = lowerBound(root, key);
+    if(!it.mPath.empty() && key < it.mPath.back()->getKey())
+    {
+        return PersistentAVLIterator<Key, Value>();
+    }
+    return it;
+}
+
+/*
+--------------------------------------------------------
+End implementations for the PersistentAVLIterator class.
+--------------------------------------------------------
+*/
+
+/*
+------------------------------------------------------
+Begin implementations for the PersistentAVLView class.
+------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+PersistentAVLView<Key, Value>::PersistentAVLView()
+    : mRoot(NULL)
+    , mSize(0)
+{
+
+}
+
+/**
+* Shares the other version, in O(1).
+*/
+template<typename Key, typename Value>
+PersistentAVLView<Key, Value>::PersistentAVLView(const PersistentAVLView<Key, Value>& other)
+    : mRoot(PathCopyAVL<Key, Value>::acquire(other.mRoot))
+    , mSize(other.mSize)
+{
+
+}
+
+template<typename Key, typename Value>
+PersistentAVLView<Key, Value>& PersistentAVLView<Key, Value>::operator=(const PersistentAVLView<Key, Value>& other)
+{
+    NodeType* root = PathCopyAVL<Key, Value>::acquire(other.mRoot);
+    PathCopyAVL<Key, Value>::release(mRoot);
+    mRoot = root;
+    mSize = other.mSize;
+    return *this;
+}
+
+/**
+* Frees the nodes that no other version shares.
+*/
+template<typename Key, typename Value>
+PersistentAVLView<Key, Value>::~PersistentAVLView()
+{
+    PathCopyAVL<Key, Value>::release(mRoot);
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLView<Key, Value>::iterator PersistentAVLView<Key, Value>::begin() const
+{
+    return iterator::first(mRoot);
+}
+
+template<typename Key, typename Value>
+typename PersistentAVLView<Key, Value>::iterator PersistentAVLView<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if it is not in this version.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLView<Key, Value>::iterator PersistentAVLView<Key, Value>::find(const Key& key) const
+{
+    return iterator::find(mRoot, key);
+}
+
+/**
+* Returns an iterator to the first item whose key is not smaller than key.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLView<Key, Value>::iterator PersistentAVLView<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator::lowerBound(mRoot, key);
+}
+
+template<typename Key, typename Value>
+std::size_t PersistentAVLView<Key, Value>::size() const
+{
+    return mSize;
+}
+
+template<typename Key, typename Value>
+bool PersistentAVLView<Key, Value>::empty() const
+{
+    return mRoot == NULL;
+}
+
+/*
+----------------------------------------------------
+End implementations for the PersistentAVLView class.
+----------------------------------------------------
+*/
+
+/*
+------------------------------------------------------
+Begin implementations for the PersistentAVLTree class.
+------------------------------------------------------
+*/
+
+/**
+* Inserts the pair, or replaces the value if the key is already there, by copying the search path.
+* Nodes of the old version are freed unless a snapshot still shares them.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    bool added;
+    typename PersistentAVLView<Key, Value>::NodeType* root = PathCopyAVL<Key, Value>::insertCopy(this->mRoot, keyValuePair, added);
+    PathCopyAVL<Key, Value>::release(this->mRoot);
+    this->mRoot = root;
+    if(added)
+    {
+        ++this->mSize;
+    }
+}
+
+/**
+* Removes the key if it is there, by copying the search path.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+    bool removed;
+    typename PersistentAVLView<Key, Value>::NodeType* root = PathCopyAVL<Key, Value>::removeCopy(this->mRoot, key, removed);
+    PathCopyAVL<Key, Value>::release(this->mRoot);
+    this->mRoot = root;
+    if(removed)
+    {
+        --this->mSize;
+    }
+}
+
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+    PathCopyAVL<Key, Value>::release(this->mRoot);
+    this->mRoot = NULL;
+    this->mSize = 0;
+}
+
+/**
+* Returns the current version as a read only view, in O(1).
+*/
+template<typename Key, typename Value>
+PersistentAVLView<Key, Value> PersistentAVLTree<Key, Value>::snapshot() const
+{
+    return PersistentAVLView<Key, Value>(*this);
+}
+
+/*
+----------------------------------------------------
+End implementations for the PersistentAVLTree class.
+----------------------------------------------------
+*/
+
+#endif
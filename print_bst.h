@@ -17,8 +17,8 @@
 // 1 means that it is the root.
 // Returns -1 (not found) if the distance is more than PPBST_MAX_HEIGHT,
 // or -2 if the tree is inconsistent.
-template<typename Key, typename Value>
-int getNodeDepth(BinarySearchTree<Key, Value> const & tree, Node<Key, Value> * root, Node<Key, Value> * node)
+template<typename Tree, typename NodeType>
+int getNodeDepth(Tree const & tree, NodeType * root, NodeType * node)
 {
 	int dist = 1;
 
@@ -45,8 +45,8 @@ int getNodeDepth(BinarySearchTree<Key, Value> const & tree, Node<Key, Value> * r
 // Uses recursion, not height values, so it is bulletproof
 // against incorrect heights.
 // Stops recursing after PPBST_MAX_HEIGHT calls.
-template<typename Key, typename Value>
-int getSubtreeHeight(Node<Key, Value> * root, int recursionDepth = 1)
+template<typename NodeType>
+int getSubtreeHeight(NodeType * root, int recursionDepth = 1)
 {
 	if(root == nullptr)
 	{
@@ -92,8 +92,8 @@ int getSubtreeHeight(Node<Key, Value> * root, int recursionDepth = 1)
 
     */
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::printRoot (NodeType* root) const
 {
 	// special case for empty trees:
 	if(root == nullptr)
@@ -130,7 +130,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 	std::map<Key, uint8_t> valuePlaceholders;
 
 	uint8_t nextPlaceHolderVal = 1;
-	for(typename BinarySearchTree<Key, Value>::iterator treeIter = this->begin(); treeIter != this->end(); ++treeIter)
+	for(typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator treeIter = this->begin(); treeIter != this->end(); ++treeIter)
 	{
 
 		if(getNodeDepth(*this, root, treeIter.mCurrent) != -1)
@@ -150,7 +150,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
 	uint16_t elementPadding = ((uint16_t)(finalRowWidth - 2));
 
-	std::vector<Node<Key, Value> *> currRowNodes; // contains the 2^levelIndex nodes in this row, or nullptr to mark nonexistant nodes
+	std::vector<NodeType *> currRowNodes; // contains the 2^levelIndex nodes in this row, or nullptr to mark nonexistant nodes
 	currRowNodes.push_back(root);
 
 	for(size_t levelIndex = 0; levelIndex < printedTreeHeight; ++levelIndex)
@@ -184,9 +184,9 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
 		// calculate node lists for next iteration
 		// ---------------------------------------------------------------------
-		std::vector<Node<Key, Value> *> prevRowNodes = currRowNodes;
+		std::vector<NodeType *> prevRowNodes = currRowNodes;
 		currRowNodes.clear();
-		for(typename std::vector<Node<Key, Value> *>::iterator prevRowIter = prevRowNodes.begin(); prevRowIter != prevRowNodes.end() ;++prevRowIter)
+		for(typename std::vector<NodeType *>::iterator prevRowIter = prevRowNodes.begin(); prevRowIter != prevRowNodes.end() ;++prevRowIter)
 		{
 			if(*prevRowIter == nullptr)
 			{
@@ -209,7 +209,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
 			for(size_t prevRowElementIndex = 0; prevRowElementIndex < prevRowNodes.size(); ++prevRowElementIndex)
 			{
-				Node<Key, Value> * currNode = prevRowNodes[prevRowElementIndex];
+				NodeType * currNode = prevRowNodes[prevRowElementIndex];
 
 				// print first branch
 				if(currNode == nullptr || currNode->getLeft() == nullptr)
@@ -222,7 +222,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
 					for(int numLines = 0; numLines < (elementPadding/2 - 1); ++numLines)
 					{
-						std::cout << u8"\u2500";
+						std::cout << "\u2500";
 					}
 
 					std::cout << "\u2518  ";
@@ -239,7 +239,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
 					for(int numLines = 0; numLines < (elementPadding/2 - 1); ++numLines)
 					{
-						std::cout << u8"\u2500";
+						std::cout << "\u2500";
 					}
 
 					std::cout << "\u2510  ";
@@ -273,7 +273,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 			std::cout.flags(origCoutState);
 			std::cout << '(' << placeholdersIter->first << ", ";
 
-			typename BinarySearchTree<Key, Value>::iterator elementIter = this->find(placeholdersIter->first);
+			typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator elementIter = this->find(placeholdersIter->first);
 			if(elementIter == this->end())
 			{
 				std::cout << "<error: lookup failed>";
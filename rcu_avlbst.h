@@ -0,0 +1,305 @@
+#ifndef RCU_AVLBST_H
+#define RCU_AVLBST_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include "persistent_avlbst.h"
+#include "epoch.h"
+
+/**
+* An AVL tree for read mostly workloads. Lookups and scans never lock: they pin an epoch, read the
+* published root and walk an immutable version of the tree. Writers are serialized by a lock and build
+* the next version by copying the search path (see PathCopyAVL), publish it with a single atomic store
+* and retire the old root. The nodes only the old version used are freed through epoch based
+* reclamation once no reader can still be walking them.
+*/
+template <typename Key, typename Value>
+class RcuAVLTree
+{
+public:
+    typedef PersistentAVLNode<Key, Value> NodeType;
+    typedef PersistentAVLIterator<Key, Value> iterator;
+
+    RcuAVLTree();
+    ~RcuAVLTree();
+
+    // Writers. Any number of threads may call these, they take turns.
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    // Lock free point lookups, copying the value out.
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    std::size_t size() const;
+    // Checks the AVL heights of the current version.
+    bool isBalanced() const;
+
+    /**
+    * A consistent read only view of the tree as it was when the view was made. The view keeps its epoch
+    * pinned, which holds back reclamation, so it should be dropped once the scan is done.
+    */
+    class ReadView
+    {
+        public:
+            explicit ReadView(const RcuAVLTree<Key, Value>& tree);
+            ~ReadView();
+
+            iterator begin() const;
+            iterator end() const;
+            iterator find(const Key& key) const;
+            iterator lower_bound(const Key& key) const;
+
+        private:
+            ReadView(const ReadView&);
+            ReadView& operator=(const ReadView&);
+
+            const RcuAVLTree<Key, Value>& mTree;
+            typename EpochDomain<NodeType>::Pin mPin;
+            NodeType* mRoot;
+    };
+
+    ReadView read() const;
+
+private:
+    RcuAVLTree(const RcuAVLTree&);
+    RcuAVLTree& operator=(const RcuAVLTree&);
+
+    void publish(NodeType* root);
+    static void releaseVersion(NodeType* root);
+    static int checkedHeight(const NodeType* node);
+
+    std::atomic<NodeType*> mRoot;
+    std::atomic<std::size_t> mSize;
+    std::mutex mWriteLock;
+    mutable EpochDomain<NodeType> mEpochs;
+};
+
+/*
+------------------------------------------------------------
+Begin implementations for the RcuAVLTree::ReadView class.
+------------------------------------------------------------
+*/
+
+/**
+* Pins an epoch before loading the root, so nothing reachable from it can be reclaimed under the view.
+*/
+template<typename Key, typename Value>
+RcuAVLTree<Key, Value>::ReadView::ReadView(const RcuAVLTree<Key, Value>& tree)
+    : mTree(tree)
+    , mPin(tree.mEpochs.enter())
+    , mRoot(tree.mRoot.load(std::memory_order_acquire))
+{
+
+}
+
+template<typename Key, typename Value>
+RcuAVLTree<Key, Value>::ReadView::~ReadView()
+{
+    mTree.mEpochs.leave(mPin);
+}
+
+template<typename Key, typename Value>
+typename RcuAVLTree<Key, Value>::iterator RcuAVLTree<Key, Value>::ReadView::begin() const
+{
+    return iterator::first(mRoot);
+}
+
+template<typename Key, typename Value>
+typename RcuAVLTree<Key, Value>::iterator RcuAVLTree<Key, Value>::ReadView::end() const
+{
+    return iterator();
+}
+
+template<typename Key, typename Value>
+typename RcuAVLTree<Key, Value>::iterator RcuAVLTree<Key, Value>::ReadView::find(const Key& key) const
+{
+    return iterator::find(mRoot, key);
+}
+
+template<typename Key, typename Value>
+typename RcuAVLTree<Key, Value>::iterator RcuAVLTree<Key, Value>::ReadView::lower_bound(const Key& key) const
+{
+    return iterator::lowerBound(mRoot, key);
+}
+
+/*
+----------------------------------------------------------
+End implementations for the RcuAVLTree::ReadView class.
+----------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------
+Begin implementations for the RcuAVLTree class.
+-----------------------------------------------
+*/
+
+template<typename Key, typename Value>
+RcuAVLTree<Key, Value>::RcuAVLTree()
+    : mRoot(NULL)
+    , mSize(0)
+    , mEpochs(&RcuAVLTree<Key, Value>::releaseVersion)
+{
+
+}
+
+/**
+* No reader may still be using the tree. Retired versions are released by the epoch domain afterwards,
+* which only frees the nodes that the current version does not share.
+*/
+template<typename Key, typename Value>
+RcuAVLTree<Key, Value>::~RcuAVLTree()
+{
+    PathCopyAVL<Key, Value>::release(mRoot.load(std::memory_order_relaxed));
+}
+
+/**
+* Reclamation callback: drops the reference the retired version held on its root.
+*/
+template<typename Key, typename Value>
+void RcuAVLTree<Key, Value>::releaseVersion(NodeType* root)
+{
+    PathCopyAVL<Key, Value>::release(root);
+}
+
+/**
+* Makes root the current version and retires the previous one. Called with the write lock held.
+*/
+template<typename Key, typename Value>
+void RcuAVLTree<Key, Value>::publish(NodeType* root)
+{
+    NodeType* old = mRoot.exchange(root, std::memory_order_seq_cst);
+    if(old != NULL)
+    {
+        mEpochs.retire(old);
+    }
+}
+
+/**
+* Inserts the pair, or replaces the value if the key is already there.
+*/
+template<typename Key, typename Value>
+void RcuAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    std::lock_guard<std::mutex> guard(mWriteLock);
+    bool added;
+    publish(PathCopyAVL<Key, Value>::insertCopy(mRoot.load(std::memory_order_relaxed), keyValuePair, added));
+    if(added)
+    {
+        mSize.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+* Removes the key if it is there. Nothing is copied or published if it is not.
+*/
+template<typename Key, typename Value>
+void RcuAVLTree<Key, Value>::remove(const Key& key)
+{
+    std::lock_guard<std::mutex> guard(mWriteLock);
+    NodeType* root = mRoot.load(std::memory_order_relaxed);
+    bool removed;
+    NodeType* next = PathCopyAVL<Key, Value>::removeCopy(root, key, removed);
+    if(!removed)
+    {
+        PathCopyAVL<Key, Value>::release(next);
+        return;
+    }
+    publish(next);
+    mSize.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template<typename Key, typename Value>
+void RcuAVLTree<Key, Value>::clear()
+{
+    std::lock_guard<std::mutex> guard(mWriteLock);
+    publish(NULL);
+    mSize.store(0, std::memory_order_relaxed);
+}
+
+/**
+* Looks key up in the current version and copies its value into value. Returns whether it was found.
+*/
+template<typename Key, typename Value>
+bool RcuAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    typename EpochDomain<NodeType>::Pin pin = mEpochs.enter();
+    NodeType* node = PathCopyAVL<Key, Value>::findNode(mRoot.load(std::memory_order_acquire), key);
+    if(node != NULL)
+    {
+        value = node->getValue();
+    }
+    mEpochs.leave(pin);
+    return node != NULL;
+}
+
+template<typename Key, typename Value>
+bool RcuAVLTree<Key, Value>::contains(const Key& key) const
+{
+    typename EpochDomain<NodeType>::Pin pin = mEpochs.enter();
+    bool found = PathCopyAVL<Key, Value>::findNode(mRoot.load(std::memory_order_acquire), key) != NULL;
+    mEpochs.leave(pin);
+    return found;
+}
+
+/**
+* Number of keys as of the last completed write.
+*/
+template<typename Key, typename Value>
+std::size_t RcuAVLTree<Key, Value>::size() const
+{
+    return mSize.load(std::memory_order_relaxed);
+}
+
+/**
+* Whether every node of the current version has its children's heights within one of each other and
+* records the right height itself. Lock free like the other reads.
+*/
+template<typename Key, typename Value>
+bool RcuAVLTree<Key, Value>::isBalanced() const
+{
+    typename EpochDomain<NodeType>::Pin pin = mEpochs.enter();
+    bool balanced = checkedHeight(mRoot.load(std::memory_order_acquire)) >= 0;
+    mEpochs.leave(pin);
+    return balanced;
+}
+
+/**
+* Helper function for isBalanced. Returns the height of the subtree under node, or -1 if it is not a
+* valid AVL tree.
+*/
+template<typename Key, typename Value>
+int RcuAVLTree<Key, Value>::checkedHeight(const NodeType* node)
+{
+    if(node == NULL)
+    {
+        return 0;
+    }
+    int left = checkedHeight(node->getLeft());
+    int right = checkedHeight(node->getRight());
+    if(left < 0 || right < 0 || left - right > 1 || right - left > 1)
+    {
+        return -1;
+    }
+    int height = (left > right ? left : right) + 1;
+    return node->getHeight() == height ? height : -1;
+}
+
+/**
+* Returns a pinned view of the current version for scans and repeated lookups.
+*/
+template<typename Key, typename Value>
+typename RcuAVLTree<Key, Value>::ReadView RcuAVLTree<Key, Value>::read() const
+{
+    return ReadView(*this);
+}
+
+/*
+---------------------------------------------
+End implementations for the RcuAVLTree class.
+---------------------------------------------
+*/
+
+#endif
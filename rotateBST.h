@@ -1,147 +1,147 @@
+#ifndef ROTATEBST_H
+#define ROTATEBST_H
+
 #include "bst.h"
 #include <iostream>
 
 
 
-template<typename Key, typename Value>
-class rotateBST: public BinarySearchTree<Key, Value>{
+/**
+* The link changes of a left rotation around r, which has to have a right child. The child takes r's place
+* under r's parent, if r has one, r becomes the child's left child and the child's old left subtree moves
+* over to r. Nothing outside of these nodes is touched, so this works on detached subtrees and on trees
+* that keep their root elsewhere.
+*/
+template<typename NodeType>
+void rotateLeftLinks(NodeType* r){
+	NodeType* child = r->getRight();
+	NodeType* parent = r->getParent();
+	NodeType* inner = child->getLeft();
+	child->setParent(parent);
+	r->setParent(child);
+	r->setRight(inner);
+	//if the child has a left
+	if(inner != NULL)
+	{
+		inner->setParent(r);
+	}
+	child->setLeft(r);
+	//a detached subtree has no parent to relink
+	if(parent == NULL)
+	{
+
+	}
+	else if(parent->getRight() == r)
+	{
+		parent->setRight(child);
+	}
+	else
+	{
+		parent->setLeft(child);
+	}
+}
+
+/**
+* Mirror image of rotateLeftLinks. r has to have a left child.
+*/
+template<typename NodeType>
+void rotateRightLinks(NodeType* r){
+	NodeType* child = r->getLeft();
+	NodeType* parent = r->getParent();
+	NodeType* inner = child->getRight();
+	child->setParent(parent);
+	r->setParent(child);
+	r->setLeft(inner);
+	//if the child has a right
+	if(inner != NULL)
+	{
+		inner->setParent(r);
+	}
+	child->setRight(r);
+	//a detached subtree has no parent to relink
+	if(parent == NULL)
+	{
+
+	}
+	else if(parent->getRight() == r)
+	{
+		parent->setRight(child);
+	}
+	else
+	{
+		parent->setLeft(child);
+	}
+}
+
+template<typename Key, typename Value, typename Alloc = SlabNodeAllocator, typename NodeType = Node<Key, Value>, typename Compare = std::less<Key> >
+class rotateBST: public BinarySearchTree<Key, Value, Alloc, NodeType, Compare>{
 	public:
-		bool sameKeys(const rotateBST<Key, Value>& t2) const;
+		rotateBST();
+		explicit rotateBST(const Compare& compare);
+		bool sameKeys(const rotateBST<Key, Value, Alloc, NodeType, Compare>& t2) const;
 		void transform(rotateBST& t2) const;
 
 	protected:
-		void leftRotate(Node<Key, Value>* r);
-		void rightRotate(Node<Key, Value>* r);
-		void transformLink(rotateBST& t2, Node<Key, Value>* node) const;
-		void finalPart(rotateBST& t2, Node<Key, Value>* node, Node<Key, Value>* comp) const;
+		void leftRotate(NodeType* r);
+		void rightRotate(NodeType* r);
+		void transformLink(rotateBST& t2, NodeType* node) const;
+		void finalPart(rotateBST& t2, NodeType* node, NodeType* comp) const;
 };
 
-template<typename Key, typename Value>
-void rotateBST<Key, Value>::leftRotate(Node<Key, Value>* r){
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+rotateBST<Key, Value, Alloc, NodeType, Compare>::rotateBST()
+{
+
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+rotateBST<Key, Value, Alloc, NodeType, Compare>::rotateBST(const Compare& compare)
+	: BinarySearchTree<Key, Value, Alloc, NodeType, Compare>(compare)
+{
+
+}
+
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void rotateBST<Key, Value, Alloc, NodeType, Compare>::leftRotate(NodeType* r){
 	if(r->getRight() == NULL)
 	{
 		return;
 	}
-	Node<Key, Value>* child = r->getRight();
+	NodeType* child = r->getRight();
+	rotateLeftLinks(r);
 	//if rotating on the root node
 	if(r == this->mRoot)
 	{
-		r->setParent(child);
-		child->setParent(NULL);
 		this->mRoot = child;
-		//if the child has a left
-		if(child->getLeft() != NULL)
-		{
-			r->setRight(child->getLeft());
-			child->getLeft()->setParent(r);
-			child->setLeft(r);
-		}
-		//if the child does not have a left
-		else
-		{
-			r->setRight(NULL);
-			child->setLeft(r);
-		}
-	}
-	//if not rotating on the root node
-	else if(r != this->mRoot)
-	{
-		Node<Key, Value>* parent = r->getParent();
-		child->setParent(parent);
-		r->setParent(child);
-		//if the child has a left
-		if(child->getLeft() != NULL)
-		{
-			r->setRight(child->getLeft());
-			child->getLeft()->setParent(r);
-			child->setLeft(r);
-		}
-		//if the child does not have a left
-		else
-		{
-			r->setRight(NULL);
-			child->setLeft(r);
-		}
-		if(parent->getRight() == r)
-		{
-			parent->setRight(child);
-		}
-		else
-		{
-			parent->setLeft(child);
-		}
 	}
 	return;
 }
 
-template<typename Key, typename Value>
-void rotateBST<Key, Value>::rightRotate(Node<Key, Value>* r){
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void rotateBST<Key, Value, Alloc, NodeType, Compare>::rightRotate(NodeType* r){
 	if(r->getLeft() == NULL)
 	{
 		return;
 	}
-	Node<Key, Value>* child = r->getLeft();
+	NodeType* child = r->getLeft();
+	rotateRightLinks(r);
 	//if rotating on the root node
 	if(r == this->mRoot)
 	{
-		r->setParent(child);
-		child->setParent(NULL);
 		this->mRoot = child;
-		//if the child has a right
-		if(child->getRight() != NULL)
-		{
-			r->setLeft(child->getRight());
-			child->getRight()->setParent(r);
-			child->setRight(r);
-		}
-		//if the child does not have a right
-		else
-		{
-			r->setLeft(NULL);
-			child->setRight(r);
-		}
-	}
-	//if not rotating on the root node
-	else if(r != this->mRoot)
-	{
-		Node<Key, Value>* parent = r->getParent();
-		child->setParent(parent);
-		r->setParent(child);
-		//if the child has a right
-		if(child->getRight() != NULL)
-		{
-			r->setLeft(child->getRight());
-			child->getRight()->setParent(r);
-			child->setRight(r);
-		}
-		//if the child does not have a right
-		else
-		{
-			r->setLeft(NULL);
-			child->setRight(r);
-		}
-		if(parent->getRight() == r)
-		{
-			parent->setRight(child);
-		}
-		else
-		{
-			parent->setLeft(child);
-		}
-		
 	}
 	return;
 }
 
-template<typename Key, typename Value>
-bool rotateBST<Key, Value>::sameKeys(const rotateBST<Key, Value>& t2) const{
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+bool rotateBST<Key, Value, Alloc, NodeType, Compare>::sameKeys(const rotateBST<Key, Value, Alloc, NodeType, Compare>& t2) const{
 
-	typename BinarySearchTree<Key, Value>::iterator it1;
-	typename BinarySearchTree<Key, Value>::iterator it2 = t2.begin();
+	typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator it1;
+	typename BinarySearchTree<Key, Value, Alloc, NodeType, Compare>::const_iterator it2 = t2.begin();
 	//run through the iterator
 	for(it1 = this->begin(); it1 != this->end(); ++it1)
 	{
-		if(it1->first != it2->first)
+		if(this->compareKeys(it1->first, it2->first) != 0)
 		{
 			return 0;
 		}
@@ -151,8 +151,8 @@ bool rotateBST<Key, Value>::sameKeys(const rotateBST<Key, Value>& t2) const{
 }
 
 //helper function for making a linked list
-template<typename Key, typename Value>
-void rotateBST<Key, Value>::transformLink(rotateBST& t2, Node<Key, Value>* node) const{
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void rotateBST<Key, Value, Alloc, NodeType, Compare>::transformLink(rotateBST& t2, NodeType* node) const{
 	if(node == NULL)
 	{
 		return;
@@ -166,28 +166,30 @@ void rotateBST<Key, Value>::transformLink(rotateBST& t2, Node<Key, Value>* node)
 }
 
 //helper function for last part
-template<typename Key, typename Value>
-void rotateBST<Key, Value>::finalPart(rotateBST& t2, Node<Key, Value>* node, Node<Key, Value>* comp) const{
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void rotateBST<Key, Value, Alloc, NodeType, Compare>::finalPart(rotateBST& t2, NodeType* node, NodeType* comp) const{
 	if(!comp) return;
 	//skip if they are the same
-	if(node->getKey() == comp->getKey())
+	int order = this->compareKeys(node->getKey(), comp->getKey());
+	if(order == 0)
 	{
 
 	}
 	else
 	{
 		//if they are not the same then do the correct rotations
-		while(node->getKey() != comp->getKey())
+		while(order != 0)
 		{
-			if(node->getKey() < comp->getKey())
+			if(order < 0)
 			{
 				t2.leftRotate(node);
 			}
-			else if(node->getKey() > comp->getKey())
+			else
 			{
 				t2.rightRotate(node);
 			}
 			node = node->getParent();
+			order = this->compareKeys(node->getKey(), comp->getKey());
 		}
 	}
 	//recursive calls
@@ -195,17 +197,17 @@ void rotateBST<Key, Value>::finalPart(rotateBST& t2, Node<Key, Value>* node, Nod
 	if(node->getRight()) finalPart(t2, node->getRight(), comp->getRight());
 }
 
-template<typename Key, typename Value>
-void rotateBST<Key, Value>::transform(rotateBST& t2) const{
+template<typename Key, typename Value, typename Alloc, typename NodeType, typename Compare>
+void rotateBST<Key, Value, Alloc, NodeType, Compare>::transform(rotateBST& t2) const{
 	if(!sameKeys(t2))
 	{
 		return;
 	}
 	//make t2 a linked list first
-	Node<Key, Value>* current = t2.mRoot;
+	NodeType* current = t2.mRoot;
 	transformLink(t2, current);
 	// //get root nodes the same
-	while(this->mRoot->getKey() != t2.mRoot->getKey())
+	while(this->compareKeys(this->mRoot->getKey(), t2.mRoot->getKey()) != 0)
 	{
 		current = t2.mRoot;
 		t2.leftRotate(current);
@@ -213,6 +215,8 @@ void rotateBST<Key, Value>::transform(rotateBST& t2) const{
 	}
 	//recursively adjust t2
 	current = t2.mRoot;
-	Node<Key, Value>* comp = this->mRoot;
+	NodeType* comp = this->mRoot;
 	finalPart(t2, current, comp);
-}
\ No newline at end of file
+}
+
+#endif
@@ -0,0 +1,845 @@
+#ifndef SHARDED_AVLMAP_H
+#define SHARDED_AVLMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+#include "epoch.h"
+
+/**
+* An ordered map for many writers, made of AVL trees that each own a contiguous range of keys and have a
+* lock of their own. Updates to keys in different ranges never touch the same lock, so writes scale with
+* the number of shards as long as the keys spread over them.
+*
+* Shards adapt to the load. A shard that grows past the size limit, or that takes far more than its share
+* of the operations, is split at its median with AVLTree::split. A shard that shrinks to a fraction of the
+* limit through removals is joined with its smaller neighbour with AVLTree::join unless the two are busy
+* together, so boundaries given up front survive filling the map but not draining it. The ranges are
+* looked up in an immutable directory that is swapped on every split or merge and reclaimed through
+* an EpochDomain, so finding the shard for a key takes no lock. An operation that lands on a shard whose
+* range changed under it looks again.
+*
+* Iteration walks the shards in key order and holds the lock of the shard it is in, so it sees every key
+* that is in the map for the whole scan, and may or may not see keys added or removed while it runs. A
+* thread must not update the map while it holds an iterator into it.
+*/
+template <typename Key, typename Value>
+class ShardedAVLMap
+{
+private:
+    struct Shard;
+    struct Directory;
+
+public:
+    typedef OrderStatisticAVLTree<Key, Value> TreeType;
+
+    explicit ShardedAVLMap(std::size_t maxShardSize = 4096);
+    ShardedAVLMap(const std::vector<Key>& boundaries, std::size_t maxShardSize = 4096);
+    ~ShardedAVLMap();
+
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+    std::size_t shardCount() const;
+
+    // Only meaningful while no update is running.
+    bool isBalanced() const;
+
+    /**
+    * Forward iterator over all shards in key order. It holds the current shard's lock and a pinned
+    * epoch, so it can be moved but not copied and should not be kept around longer than the scan.
+    */
+    class iterator
+    {
+        public:
+            iterator();
+            iterator(iterator&& other);
+            iterator& operator=(iterator&& other);
+            ~iterator();
+
+            const std::pair<Key, Value>& operator*() const;
+            const std::pair<Key, Value>* operator->() const;
+            bool operator==(const iterator& rhs) const;
+            bool operator!=(const iterator& rhs) const;
+            iterator& operator++();
+
+        private:
+            friend class ShardedAVLMap<Key, Value>;
+            iterator(const ShardedAVLMap<Key, Value>* map);
+            iterator(const iterator&);
+            iterator& operator=(const iterator&);
+
+            void enterFrom(const Key* key);
+            void release();
+
+            const ShardedAVLMap<Key, Value>* mMap;
+            typename EpochDomain<Directory>::Pin mPin;
+            Shard* mShard;
+            typename TreeType::iterator mCurrent;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator lower_bound(const Key& key) const;
+
+private:
+    ShardedAVLMap(const ShardedAVLMap&);
+    ShardedAVLMap& operator=(const ShardedAVLMap&);
+
+    // Shards below the size limit only look at merging or being hot every this many operations.
+    static const std::uint64_t kCheckInterval = 256;
+    // Operations a shard has to take before it can count as hot.
+    static const std::uint64_t kHotWindow = 1 << 14;
+    // A shard is hot when it took this many times the average number of operations.
+    static const std::uint64_t kHotFactor = 4;
+    // Hot shards smaller than this are left alone, splitting them would not spread much load.
+    static const std::size_t kMinHotSplit = 64;
+
+    /**
+    * One range of keys, [mLow, mHigh), where the first shard has no lower and the last no upper bound.
+    * The bounds and the tree are guarded by mLock. A retired shard has been merged into its left
+    * neighbour and only waits for reclamation.
+    */
+    struct Shard
+    {
+        Shard();
+
+        bool covers(const Key& key) const;
+
+        std::mutex mLock;
+        TreeType mTree;
+        Key mLow;
+        Key mHigh;
+        bool mHasLow;
+        bool mHasHigh;
+        bool mRetired;
+        // Mirrors of the tree size and the recent operation count that can be read without the lock.
+        std::atomic<std::size_t> mCount;
+        std::atomic<std::uint64_t> mOps;
+    };
+
+    /**
+    * The shards in key order with their lower bounds. Never changed once published. Shards that a merge
+    * dropped are listed in the directory that still referenced them, and freed along with it.
+    */
+    struct Directory
+    {
+        std::vector<Shard*> shards;
+        std::vector<Key> lows;
+        std::vector<Shard*> dropped;
+    };
+
+    static void destroyDirectory(Directory* directory);
+    static std::size_t shardIndex(const Directory* directory, const Key& key);
+
+    Shard* lockShardFor(const Key& key) const;
+    void afterUpdate(Shard* shard, std::size_t count, std::uint64_t ops, bool removal);
+    bool isHot(const Directory* directory, const Shard* shard) const;
+    void splitShard(Shard* shard);
+    void mergeShard(Shard* shard);
+    Shard* mergeWithNeighbourLocked(Shard* shard);
+    void publish(Directory* next);
+
+    std::size_t mMaxShardSize;
+    std::atomic<Directory*> mDirectory;
+    // Serializes splits and merges, which are rare, against each other.
+    std::mutex mReshardLock;
+    mutable EpochDomain<Directory> mEpochs;
+};
+
+/*
+---------------------------------------------------------
+Begin implementations for the ShardedAVLMap::Shard class.
+---------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::Shard::Shard()
+    : mLow()
+    , mHigh()
+    , mHasLow(false)
+    , mHasHigh(false)
+    , mRetired(false)
+    , mCount(0)
+    , mOps(0)
+{
+
+}
+
+/**
+* Whether key belongs to this shard. Called with the shard locked.
+*/
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::Shard::covers(const Key& key) const
+{
+    if(mRetired)
+    {
+        return false;
+    }
+    if(mHasLow && key < mLow)
+    {
+        return false;
+    }
+    return !mHasHigh || key < mHigh;
+}
+
+/*
+-------------------------------------------------------
+End implementations for the ShardedAVLMap::Shard class.
+-------------------------------------------------------
+*/
+
+/*
+------------------------------------------------------------
+Begin implementations for the ShardedAVLMap::iterator class.
+------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::iterator::iterator()
+    : mMap(NULL)
+    , mPin()
+    , mShard(NULL)
+    , mCurrent()
+{
+
+}
+
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::iterator::iterator(const ShardedAVLMap<Key, Value>* map)
+    : mMap(map)
+    , mPin(map->mEpochs.enter())
+    , mShard(NULL)
+    , mCurrent()
+{
+
+}
+
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::iterator::iterator(iterator&& other)
+    : mMap(other.mMap)
+    , mPin(other.mPin)
+    , mShard(other.mShard)
+    , mCurrent(other.mCurrent)
+{
+    other.mMap = NULL;
+    other.mShard = NULL;
+}
+
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::iterator& ShardedAVLMap<Key, Value>::iterator::operator=(iterator&& other)
+{
+    if(this != &other)
+    {
+        release();
+        mMap = other.mMap;
+        mPin = other.mPin;
+        mShard = other.mShard;
+        mCurrent = other.mCurrent;
+        other.mMap = NULL;
+        other.mShard = NULL;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::iterator::~iterator()
+{
+    release();
+}
+
+/**
+* Drops the shard lock and the epoch pin, leaving an end iterator.
+*/
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::iterator::release()
+{
+    if(mShard != NULL)
+    {
+        mShard->mLock.unlock();
+        mShard = NULL;
+    }
+    if(mMap != NULL)
+    {
+        mMap->mEpochs.leave(mPin);
+        mMap = NULL;
+    }
+}
+
+template<typename Key, typename Value>
+const std::pair<Key, Value>& ShardedAVLMap<Key, Value>::iterator::operator*() const
+{
+    return *mCurrent;
+}
+
+template<typename Key, typename Value>
+const std::pair<Key, Value>* ShardedAVLMap<Key, Value>::iterator::operator->() const
+{
+    return &(*mCurrent);
+}
+
+/**
+* Two iterators are equal when both are past the end or both are on the same shard and position.
+*/
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return mShard == rhs.mShard && (mShard == NULL || mCurrent == rhs.mCurrent);
+}
+
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Steps within the shard, and on to the shard holding the next range once this one is used up.
+*/
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::iterator& ShardedAVLMap<Key, Value>::iterator::operator++()
+{
+    ++mCurrent;
+    if(mCurrent == mShard->mTree.end())
+    {
+        if(!mShard->mHasHigh)
+        {
+            release();
+            return *this;
+        }
+        Key high = mShard->mHigh;
+        mShard->mLock.unlock();
+        mShard = NULL;
+        enterFrom(&high);
+    }
+    return *this;
+}
+
+/**
+* Locks the shard holding key, or the first shard if key is NULL, and moves to the first item at or
+* after key, going on through the following shards while they come up empty.
+*/
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::iterator::enterFrom(const Key* key)
+{
+    while(true)
+    {
+        Directory* directory = mMap->mDirectory.load(std::memory_order_acquire);
+        Shard* shard = directory->shards[key == NULL ? 0 : shardIndex(directory, *key)];
+        shard->mLock.lock();
+        bool fits = key == NULL ? !shard->mRetired && !shard->mHasLow : shard->covers(*key);
+        if(!fits)
+        {
+            //the ranges changed since the directory was read
+            shard->mLock.unlock();
+            continue;
+        }
+        mShard = shard;
+        if(shard->mTree.size() == 0)
+        {
+            mCurrent = shard->mTree.end();
+        }
+        else
+        {
+            mCurrent = key == NULL ? shard->mTree.begin() : shard->mTree.lower_bound(*key);
+        }
+        if(mCurrent != shard->mTree.end())
+        {
+            return;
+        }
+        if(!shard->mHasHigh)
+        {
+            release();
+            return;
+        }
+        Key high = shard->mHigh;
+        shard->mLock.unlock();
+        mShard = NULL;
+        enterFrom(&high);
+        return;
+    }
+}
+
+/*
+----------------------------------------------------------
+End implementations for the ShardedAVLMap::iterator class.
+----------------------------------------------------------
+*/
+
+/*
+--------------------------------------------------
+Begin implementations for the ShardedAVLMap class.
+--------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(std::size_t maxShardSize)
+    : mMaxShardSize(maxShardSize < 2 ? 2 : maxShardSize)
+    , mDirectory(NULL)
+    , mEpochs(&ShardedAVLMap<Key, Value>::destroyDirectory)
+{
+    Directory* directory = new Directory();
+    directory->shards.push_back(new Shard());
+    directory->lows.push_back(Key());
+    mDirectory.store(directory, std::memory_order_release);
+}
+
+/**
+* Starts out with one shard per range between consecutive boundaries, which have to be strictly
+* increasing. Useful when the key distribution is known up front, so that writers spread out from the
+* first insert on instead of waiting for splits.
+*/
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::ShardedAVLMap(const std::vector<Key>& boundaries, std::size_t maxShardSize)
+    : mMaxShardSize(maxShardSize < 2 ? 2 : maxShardSize)
+    , mDirectory(NULL)
+    , mEpochs(&ShardedAVLMap<Key, Value>::destroyDirectory)
+{
+    for(std::size_t i = 1; i < boundaries.size(); ++i)
+    {
+        if(!(boundaries[i - 1] < boundaries[i]))
+        {
+            throw std::invalid_argument("ShardedAVLMap: shard boundaries have to be strictly increasing");
+        }
+    }
+    Directory* directory = new Directory();
+    directory->shards.push_back(new Shard());
+    directory->lows.push_back(Key());
+    for(std::size_t i = 0; i < boundaries.size(); ++i)
+    {
+        Shard* previous = directory->shards.back();
+        previous->mHigh = boundaries[i];
+        previous->mHasHigh = true;
+        Shard* shard = new Shard();
+        shard->mLow = boundaries[i];
+        shard->mHasLow = true;
+        directory->shards.push_back(shard);
+        directory->lows.push_back(boundaries[i]);
+    }
+    mDirectory.store(directory, std::memory_order_release);
+}
+
+/**
+* No other thread may still be using the map.
+*/
+template<typename Key, typename Value>
+ShardedAVLMap<Key, Value>::~ShardedAVLMap()
+{
+    Directory* directory = mDirectory.load(std::memory_order_relaxed);
+    for(std::size_t i = 0; i < directory->shards.size(); ++i)
+    {
+        delete directory->shards[i];
+    }
+    destroyDirectory(directory);
+}
+
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::destroyDirectory(Directory* directory)
+{
+    for(std::size_t i = 0; i < directory->dropped.size(); ++i)
+    {
+        delete directory->dropped[i];
+    }
+    delete directory;
+}
+
+/**
+* Index of the last shard whose lower bound is not greater than key. The first shard has no lower
+* bound, so the search starts at the second.
+*/
+template<typename Key, typename Value>
+std::size_t ShardedAVLMap<Key, Value>::shardIndex(const Directory* directory, const Key& key)
+{
+    std::size_t low = 1;
+    std::size_t high = directory->lows.size();
+    while(low < high)
+    {
+        std::size_t middle = low + (high - low) / 2;
+        if(key < directory->lows[middle])
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return low - 1;
+}
+
+/**
+* Returns the shard that owns key, locked. Retries when a split or merge moved the key elsewhere between
+* the directory lookup and the lock. The caller has to have an epoch pinned for as long as it uses the
+* shard, a merge may retire it as soon as the lock is dropped.
+*/
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::Shard* ShardedAVLMap<Key, Value>::lockShardFor(const Key& key) const
+{
+    while(true)
+    {
+        Directory* directory = mDirectory.load(std::memory_order_acquire);
+        Shard* shard = directory->shards[shardIndex(directory, key)];
+        shard->mLock.lock();
+        if(shard->covers(key))
+        {
+            return shard;
+        }
+        shard->mLock.unlock();
+    }
+}
+
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    typename EpochDomain<Directory>::Pin pin = mEpochs.enter();
+    Shard* shard = lockShardFor(keyValuePair.first);
+    shard->mTree.insert(keyValuePair);
+    std::size_t count = shard->mTree.size();
+    shard->mCount.store(count, std::memory_order_relaxed);
+    std::uint64_t ops = shard->mOps.fetch_add(1, std::memory_order_relaxed) + 1;
+    shard->mLock.unlock();
+    afterUpdate(shard, count, ops, false);
+    mEpochs.leave(pin);
+}
+
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::remove(const Key& key)
+{
+    typename EpochDomain<Directory>::Pin pin = mEpochs.enter();
+    Shard* shard = lockShardFor(key);
+    shard->mTree.remove(key);
+    std::size_t count = shard->mTree.size();
+    shard->mCount.store(count, std::memory_order_relaxed);
+    std::uint64_t ops = shard->mOps.fetch_add(1, std::memory_order_relaxed) + 1;
+    shard->mLock.unlock();
+    afterUpdate(shard, count, ops, true);
+    mEpochs.leave(pin);
+}
+
+/**
+* Copies the value stored under key into value. Returns whether the key was found.
+*/
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::find(const Key& key, Value& value) const
+{
+    typename EpochDomain<Directory>::Pin pin = mEpochs.enter();
+    Shard* shard = lockShardFor(key);
+    typename TreeType::iterator it = shard->mTree.find(key);
+    bool found = it != shard->mTree.end();
+    if(found)
+    {
+        value = it->second;
+    }
+    shard->mOps.fetch_add(1, std::memory_order_relaxed);
+    shard->mLock.unlock();
+    mEpochs.leave(pin);
+    return found;
+}
+
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::contains(const Key& key) const
+{
+    Value value;
+    return find(key, value);
+}
+
+/**
+* Sum of the shard sizes, exact once every update that has started has finished.
+*/
+template<typename Key, typename Value>
+std::size_t ShardedAVLMap<Key, Value>::size() const
+{
+    typename EpochDomain<Directory>::Pin pin = mEpochs.enter();
+    Directory* directory = mDirectory.load(std::memory_order_acquire);
+    std::size_t total = 0;
+    for(std::size_t i = 0; i < directory->shards.size(); ++i)
+    {
+        total += directory->shards[i]->mCount.load(std::memory_order_relaxed);
+    }
+    mEpochs.leave(pin);
+    return total;
+}
+
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::empty() const
+{
+    return size() == 0;
+}
+
+template<typename Key, typename Value>
+std::size_t ShardedAVLMap<Key, Value>::shardCount() const
+{
+    typename EpochDomain<Directory>::Pin pin = mEpochs.enter();
+    std::size_t count = mDirectory.load(std::memory_order_acquire)->shards.size();
+    mEpochs.leave(pin);
+    return count;
+}
+
+/**
+* Every shard is a balanced tree holding only keys of its own range, and the ranges line up.
+*/
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::isBalanced() const
+{
+    Directory* directory = mDirectory.load(std::memory_order_acquire);
+    for(std::size_t i = 0; i < directory->shards.size(); ++i)
+    {
+        Shard* shard = directory->shards[i];
+        if(!shard->mTree.isBalanced() || shard->mRetired || shard->mHasLow != (i > 0) || shard->mHasHigh != (i + 1 < directory->shards.size()))
+        {
+            return false;
+        }
+        if(i + 1 < directory->shards.size() && (shard->mHigh < directory->lows[i + 1] || directory->lows[i + 1] < shard->mHigh))
+        {
+            return false;
+        }
+        for(typename TreeType::iterator it = shard->mTree.begin(); it != shard->mTree.end(); ++it)
+        {
+            if(!shard->covers(it->first))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::iterator ShardedAVLMap<Key, Value>::begin() const
+{
+    iterator it(this);
+    it.enterFrom(NULL);
+    return it;
+}
+
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::iterator ShardedAVLMap<Key, Value>::end() const
+{
+    return iterator();
+}
+
+/**
+* Iterator to the first key that is not less than key.
+*/
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::iterator ShardedAVLMap<Key, Value>::lower_bound(const Key& key) const
+{
+    iterator it(this);
+    it.enterFrom(&key);
+    return it;
+}
+
+/**
+* Checks whether the shard that was just updated should be split or merged, given its size and operation
+* count right after the update. Oversized shards are split, and shards emptied by a removal merged,
+* straight away. Otherwise small shards are only looked at after a removal and hot ones only every
+* kCheckInterval operations, so that they do not keep every writer queueing on the reshard lock.
+*/
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::afterUpdate(Shard* shard, std::size_t count, std::uint64_t ops, bool removal)
+{
+    if(count > mMaxShardSize)
+    {
+        splitShard(shard);
+        return;
+    }
+    bool interval = ops % kCheckInterval == 0;
+    if(removal && count < mMaxShardSize / 8 && (interval || count == 0))
+    {
+        if(mDirectory.load(std::memory_order_acquire)->shards.size() > 1)
+        {
+            mergeShard(shard);
+        }
+    }
+    else if(interval && ops >= kHotWindow && count >= kMinHotSplit)
+    {
+        splitShard(shard);
+    }
+}
+
+/**
+* Whether shard took more than kHotFactor times the average number of operations. Every shard's count is
+* halved afterwards so that the counts follow the recent load. Called with the reshard lock held.
+*/
+template<typename Key, typename Value>
+bool ShardedAVLMap<Key, Value>::isHot(const Directory* directory, const Shard* shard) const
+{
+    std::uint64_t total = 0;
+    for(std::size_t i = 0; i < directory->shards.size(); ++i)
+    {
+        total += directory->shards[i]->mOps.load(std::memory_order_relaxed);
+    }
+    bool hot = shard->mOps.load(std::memory_order_relaxed) * directory->shards.size() > kHotFactor * total;
+    for(std::size_t i = 0; i < directory->shards.size(); ++i)
+    {
+        std::atomic<std::uint64_t>& ops = directory->shards[i]->mOps;
+        ops.store(ops.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+    }
+    return hot;
+}
+
+/**
+* Splits shard at its median key if it is still oversized or hot. The new directory is published before
+* the old shard's range shrinks and its lock is released, so an operation that finds its key gone from
+* the old shard finds the new one on its next look.
+*/
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::splitShard(Shard* shard)
+{
+    std::lock_guard<std::mutex> reshard(mReshardLock);
+    Directory* directory = mDirectory.load(std::memory_order_acquire);
+    std::size_t index = 0;
+    while(index < directory->shards.size() && directory->shards[index] != shard)
+    {
+        ++index;
+    }
+    if(index == directory->shards.size())
+    {
+        //merged away in the meantime
+        return;
+    }
+    std::size_t count = shard->mCount.load(std::memory_order_relaxed);
+    if(count <= mMaxShardSize && !(count >= kMinHotSplit && isHot(directory, shard)))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(shard->mLock);
+    if(shard->mTree.size() < 2)
+    {
+        return;
+    }
+    std::pair<Key, Value> median = *shard->mTree.select(shard->mTree.size() / 2);
+    Shard* upper = new Shard();
+    shard->mTree.split(median.first, upper->mTree);
+    upper->mTree.insert(median);
+    upper->mLow = median.first;
+    upper->mHasLow = true;
+    upper->mHigh = shard->mHigh;
+    upper->mHasHigh = shard->mHasHigh;
+    upper->mCount.store(upper->mTree.size(), std::memory_order_relaxed);
+    upper->mOps.store(shard->mOps.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+
+    Directory* next = new Directory();
+    next->shards = directory->shards;
+    next->lows = directory->lows;
+    next->shards.insert(next->shards.begin() + index + 1, upper);
+    next->lows.insert(next->lows.begin() + index + 1, median.first);
+    publish(next);
+
+    shard->mHigh = median.first;
+    shard->mHasHigh = true;
+    shard->mCount.store(shard->mTree.size(), std::memory_order_relaxed);
+    shard->mOps.store(shard->mOps.load(std::memory_order_relaxed) / 2, std::memory_order_relaxed);
+}
+
+/**
+* Merges shard into its neighbours for as long as the result stays small. Shards that were emptied see
+* no more updates, so they have to be swept up by whichever neighbour does.
+*/
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::mergeShard(Shard* shard)
+{
+    std::lock_guard<std::mutex> reshard(mReshardLock);
+    while(shard != NULL)
+    {
+        shard = mergeWithNeighbourLocked(shard);
+    }
+}
+
+/**
+* Joins shard with the smaller of its neighbours if the two are small and would not be hot together.
+* The right one of the pair is retired under its lock, so anyone who still finds it in an old directory
+* looks again. Returns the merged shard if it is still small enough to be merged again, NULL otherwise.
+* Called with the reshard lock held.
+*/
+template<typename Key, typename Value>
+typename ShardedAVLMap<Key, Value>::Shard* ShardedAVLMap<Key, Value>::mergeWithNeighbourLocked(Shard* shard)
+{
+    Directory* directory = mDirectory.load(std::memory_order_acquire);
+    std::size_t index = 0;
+    while(index < directory->shards.size() && directory->shards[index] != shard)
+    {
+        ++index;
+    }
+    if(index == directory->shards.size() || directory->shards.size() < 2)
+    {
+        //merged away in the meantime, or nothing left to merge with
+        return NULL;
+    }
+    //pair up with the smaller neighbour
+    if(index + 1 == directory->shards.size() || (index > 0 && directory->shards[index - 1]->mCount.load(std::memory_order_relaxed)
+        < directory->shards[index + 1]->mCount.load(std::memory_order_relaxed)))
+    {
+        --index;
+    }
+    Shard* left = directory->shards[index];
+    Shard* right = directory->shards[index + 1];
+    std::size_t combined = left->mCount.load(std::memory_order_relaxed) + right->mCount.load(std::memory_order_relaxed);
+    if(combined > mMaxShardSize / 2)
+    {
+        return NULL;
+    }
+    std::uint64_t total = 0;
+    for(std::size_t i = 0; i < directory->shards.size(); ++i)
+    {
+        total += directory->shards[i]->mOps.load(std::memory_order_relaxed);
+    }
+    std::uint64_t ops = left->mOps.load(std::memory_order_relaxed) + right->mOps.load(std::memory_order_relaxed);
+    if(combined >= kMinHotSplit && ops * directory->shards.size() > kHotFactor * total)
+    {
+        //it would only be split again as hot
+        return NULL;
+    }
+
+    //shards are always locked left to right
+    std::lock_guard<std::mutex> leftGuard(left->mLock);
+    std::lock_guard<std::mutex> rightGuard(right->mLock);
+    if(right->mTree.size() > 0)
+    {
+        std::pair<Key, Value> middle = *right->mTree.begin();
+        right->mTree.remove(middle.first);
+        left->mTree.join(left->mTree, middle, right->mTree);
+    }
+    left->mHigh = right->mHigh;
+    left->mHasHigh = right->mHasHigh;
+    left->mCount.store(left->mTree.size(), std::memory_order_relaxed);
+    left->mOps.store(ops, std::memory_order_relaxed);
+    right->mRetired = true;
+    right->mCount.store(0, std::memory_order_relaxed);
+
+    Directory* next = new Directory();
+    next->shards = directory->shards;
+    next->lows = directory->lows;
+    next->shards.erase(next->shards.begin() + index + 1);
+    next->lows.erase(next->lows.begin() + index + 1);
+    directory->dropped.push_back(right);
+    publish(next);
+    return left->mCount.load(std::memory_order_relaxed) < mMaxShardSize / 8 ? left : NULL;
+}
+
+/**
+* Makes next the current directory and retires the old one. Called with the reshard lock held.
+*/
+template<typename Key, typename Value>
+void ShardedAVLMap<Key, Value>::publish(Directory* next)
+{
+    Directory* old = mDirectory.exchange(next, std::memory_order_seq_cst);
+    mEpochs.retire(old);
+}
+
+/*
+------------------------------------------------
+End implementations for the ShardedAVLMap class.
+------------------------------------------------
+*/
+
+#endif
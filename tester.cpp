@@ -1,8 +1,1352 @@
 #include "avlbst.h"
+#include "persistent_avlbst.h"
+#include "frozen_avlbst.h"
+#include "bplustree.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 using namespace std;
 
+// The numbered cases in main print trees to check by eye. The later ones check themselves and only print
+// what went wrong, and the exit code says whether any of them failed.
+
+static bool failed = false;
+
+static void check(bool condition, const char* what)
+{
+	if(!condition)
+	{
+		cout << "FAILED: " << what << endl;
+		failed = true;
+	}
+}
+
+// Whether an in-order walk of tree gives exactly the items of expected.
+template<typename Tree, typename Map>
+bool sameItems(const Tree& tree, const Map& expected)
+{
+	typename Tree::const_iterator it = tree.begin();
+	for(typename Map::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+	{
+		if(it == tree.end() || it->first != e->first || it->second != e->second)
+		{
+			return false;
+		}
+	}
+	return it == tree.end();
+}
+
+// assign_sorted on sizes around powers of two, and checkSorted rejecting bad input without touching the tree.
+static void testBulkLoad()
+{
+	size_t sizes[] = {0, 1, 2, 3, 7, 8, 15, 16, 1023, 1024};
+	for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		vector<std::pair<int,int> > items;
+		map<int,int> expected;
+		for(size_t i = 0; i < sizes[s]; ++i)
+		{
+			items.push_back(std::pair<int,int>((int)i * 3, (int)i));
+			expected[(int)i * 3] = (int)i;
+		}
+		AVLTree<int,int> tree;
+		tree.insert(std::pair<int,int>(-5, 5));
+		tree.assign_sorted(items.begin(), items.end(), true);
+		check(tree.isBalanced(), "assign_sorted built an unbalanced tree");
+		check(sameItems(tree, expected), "assign_sorted built the wrong contents");
+		//the tree has to stay a working AVL tree afterwards
+		tree.insert(std::pair<int,int>(1, 1));
+		tree.remove(0);
+		expected[1] = 1;
+		expected.erase(0);
+		check(tree.isBalanced() && sameItems(tree, expected), "updates after assign_sorted went wrong");
+
+		AVLTree<int,int> constructed(items.begin(), items.end());
+		check(constructed.isBalanced(), "the sorted range constructor built an unbalanced tree");
+	}
+
+	vector<std::pair<int,int> > unsorted;
+	unsorted.push_back(std::pair<int,int>(1, 1));
+	unsorted.push_back(std::pair<int,int>(3, 3));
+	unsorted.push_back(std::pair<int,int>(2, 2));
+	vector<std::pair<int,int> > duplicate;
+	duplicate.push_back(std::pair<int,int>(1, 1));
+	duplicate.push_back(std::pair<int,int>(2, 2));
+	duplicate.push_back(std::pair<int,int>(2, 3));
+	vector<std::pair<int,int> >* bad[] = {&unsorted, &duplicate};
+	for(int b = 0; b < 2; ++b)
+	{
+		AVLTree<int,int> tree;
+		map<int,int> expected;
+		for(int i = 10; i < 20; ++i)
+		{
+			tree.insert(std::pair<int,int>(i, i));
+			expected[i] = i;
+		}
+		bool threw = false;
+		try
+		{
+			tree.assign_sorted(bad[b]->begin(), bad[b]->end(), true);
+		}
+		catch(const std::invalid_argument&)
+		{
+			threw = true;
+		}
+		check(threw, "assign_sorted did not reject a range that is not strictly increasing");
+		check(sameItems(tree, expected) && tree.isBalanced(), "a rejected assign_sorted changed the tree");
+	}
+}
+
+// insert_batch both ways: a small batch into a much bigger tree goes key by key, a batch within 4x of the
+// tree's size is merged and rebuilt. Repeated keys in a batch resolve to the last one given.
+static void testInsertBatch()
+{
+	mt19937 rng(6);
+	size_t batchSizes[] = {0, 1, 10, 300, 5000};
+	for(size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); ++b)
+	{
+		for(int treeSize = 0; treeSize <= 20000; treeSize += 2000)
+		{
+			AVLTree<int,int> tree;
+			map<int,int> expected;
+			for(int i = 0; i < treeSize; ++i)
+			{
+				int key = (int)(rng() % 40000);
+				tree.insert(std::pair<int,int>(key, key));
+				expected[key] = key;
+			}
+			vector<std::pair<int,int> > batch;
+			for(size_t i = 0; i < batchSizes[b]; ++i)
+			{
+				//a narrow key range so that the batch repeats keys and overwrites ones already there
+				int key = (int)(rng() % (batchSizes[b] * 2 + 1)) * 20;
+				batch.push_back(std::pair<int,int>(key, (int)i - 7));
+				expected[key] = (int)i - 7;
+			}
+			tree.insert_batch(batch.data(), batch.size());
+			check(tree.isBalanced(), "insert_batch left the tree unbalanced");
+			check(sameItems(tree, expected), "insert_batch left the wrong contents");
+		}
+	}
+
+	AVLTree<int,int> tree;
+	std::pair<int,int> repeated[] = {std::pair<int,int>(5, 1), std::pair<int,int>(2, 1), std::pair<int,int>(5, 2),
+		std::pair<int,int>(2, 2), std::pair<int,int>(5, 3)};
+	tree.insert_batch(repeated, 5);
+	map<int,int> expected;
+	expected[2] = 2;
+	expected[5] = 3;
+	check(sameItems(tree, expected), "insert_batch did not keep the last of repeated keys");
+	tree.insert_batch(repeated, 0);
+	check(sameItems(tree, expected), "an empty insert_batch changed the tree");
+}
+
+template<typename Tree>
+vector<std::pair<int,int> > itemsOf(const Tree& tree)
+{
+	vector<std::pair<int,int> > items;
+	for(typename Tree::const_iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		items.push_back(*it);
+	}
+	return items;
+}
+
+static bool lessKey(const std::pair<int,int>& a, const std::pair<int,int>& b)
+{
+	return a.first < b.first;
+}
+
+// Fills tree and items with count random keys from [0, range), values tagged with tag.
+template<typename Tree>
+void fillRandom(Tree& tree, map<int,int>& items, size_t count, int range, int tag, mt19937& rng)
+{
+	for(size_t i = 0; i < count; ++i)
+	{
+		int key = (int)(rng() % range);
+		tree.insert(std::pair<int,int>(key, key * 10 + tag));
+		items[key] = key * 10 + tag;
+	}
+}
+
+// union_with, intersect_with and difference_with against the std:: set algorithms, which like the tree keep
+// the first range's value for a key in both. The large sizes are tall enough to fork onto the TaskPool.
+template<typename Tree>
+void testSetOperations()
+{
+	mt19937 rng(8);
+	size_t sizes[][2] = {{0, 0}, {0, 50}, {50, 0}, {1, 1}, {200, 300}, {500, 20}, {30000, 20000}, {40000, 3000}};
+	for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		for(int operation = 0; operation < 3; ++operation)
+		{
+			Tree mine;
+			Tree theirs;
+			map<int,int> mineItems;
+			map<int,int> theirItems;
+			int range = (int)(sizes[s][0] + sizes[s][1]) * 2 + 1;
+			fillRandom(mine, mineItems, sizes[s][0], range, 1, rng);
+			fillRandom(theirs, theirItems, sizes[s][1], range, 2, rng);
+			vector<std::pair<int,int> > a(mineItems.begin(), mineItems.end());
+			vector<std::pair<int,int> > b(theirItems.begin(), theirItems.end());
+			vector<std::pair<int,int> > expected;
+			if(operation == 0)
+			{
+				mine.union_with(theirs);
+				set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected), lessKey);
+			}
+			else if(operation == 1)
+			{
+				mine.intersect_with(theirs);
+				set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected), lessKey);
+			}
+			else
+			{
+				mine.difference_with(theirs);
+				set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected), lessKey);
+			}
+			check(itemsOf(mine) == expected, "a set operation gave the wrong contents");
+			check(mine.isBalanced(), "a set operation left the tree unbalanced");
+			check(itemsOf(theirs) == b, "a set operation changed the other tree");
+		}
+	}
+}
+
+// split on present and absent keys all over the range, which with an arena allocator copies whichever half
+// is shorter, then join the halves back together.
+template<typename Tree>
+void testSplitJoin()
+{
+	mt19937 rng(9);
+	for(int round = 0; round < 40; ++round)
+	{
+		Tree tree;
+		map<int,int> items;
+		fillRandom(tree, items, 1 + rng() % 3000, 6000, 1, rng);
+		int key = (int)(rng() % 6000);
+		if(round % 2 == 0)
+		{
+			//present, at a random rank
+			map<int,int>::iterator it = items.begin();
+			advance(it, rng() % items.size());
+			key = it->first;
+		}
+		bool present = items.count(key) != 0;
+		Tree greater;
+		greater.insert(std::pair<int,int>(-1, -1));
+		check(tree.split(key, greater) == present, "split did not report whether the key was present");
+		map<int,int> lowerItems(items.begin(), items.lower_bound(key));
+		map<int,int> greaterItems(items.upper_bound(key), items.end());
+		check(sameItems(tree, lowerItems) && tree.isBalanced(), "split left the wrong smaller half");
+		check(sameItems(greater, greaterItems) && greater.isBalanced(), "split left the wrong greater half");
+
+		//join back into the smaller half itself
+		lowerItems[key] = 7;
+		lowerItems.insert(greaterItems.begin(), greaterItems.end());
+		tree.join(tree, std::pair<int,int>(key, 7), greater);
+		check(sameItems(tree, lowerItems) && tree.isBalanced(), "join onto its own left tree went wrong");
+		check(greater.begin() == greater.end(), "join did not empty the right tree");
+		//the joined tree still takes updates
+		tree.remove(key);
+		tree.insert(std::pair<int,int>(key, 8));
+		lowerItems[key] = 8;
+		check(sameItems(tree, lowerItems) && tree.isBalanced(), "updates after join went wrong");
+	}
+
+	Tree left;
+	Tree right;
+	map<int,int> leftItems;
+	map<int,int> rightItems;
+	for(int i = 0; i < 10; ++i)
+	{
+		left.insert(std::pair<int,int>(i, i));
+		leftItems[i] = i;
+		right.insert(std::pair<int,int>(i + 20, i));
+		rightItems[i + 20] = i;
+	}
+	int middles[] = {5, 9, 20, 25};
+	for(int m = 0; m < 4; ++m)
+	{
+		Tree joined;
+		bool threw = false;
+		try
+		{
+			joined.join(left, std::pair<int,int>(middles[m], 0), right);
+		}
+		catch(const std::invalid_argument&)
+		{
+			threw = true;
+		}
+		check(threw, "join accepted keys out of order");
+		check(sameItems(left, leftItems) && sameItems(right, rightItems), "a rejected join changed its trees");
+	}
+}
+
+// select, rank, iterator arithmetic and distance against positions in a std::map, end() included.
+static void testOrderStatistics()
+{
+	mt19937 rng(10);
+	OrderStatisticAVLTree<int,int> tree;
+	map<int,int> items;
+	check(tree.size() == 0 && tree.select(0) == tree.end() && tree.rank(5) == 0, "order statistics of an empty tree");
+	check(tree.end() + 3 == tree.end() && distance(tree.begin(), tree.end()) == 0, "iterator arithmetic on an empty tree");
+	for(int round = 0; round < 3000; ++round)
+	{
+		int key = (int)(rng() % 1000);
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			items.erase(key);
+		}
+		else
+		{
+			tree.insert(std::pair<int,int>(key, round));
+			items[key] = round;
+		}
+		if(round % 100 != 0)
+		{
+			continue;
+		}
+		check(tree.size() == items.size(), "size() disagrees with the contents");
+		size_t index = 0;
+		for(map<int,int>::iterator it = items.begin(); it != items.end(); ++it, ++index)
+		{
+			check(tree.select(index)->first == it->first, "select() found the wrong key");
+			check(tree.rank(it->first) == index && tree.rank(it->first + 1) == index + 1, "rank() miscounted");
+		}
+		check(tree.select(items.size()) == tree.end(), "select() past the end is not end()");
+		OrderStatisticAVLTree<int,int>::iterator first = tree.begin();
+		size_t steps[] = {0, 1, 7, items.size() / 2, items.size(), items.size() + 5};
+		for(size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); ++s)
+		{
+			OrderStatisticAVLTree<int,int>::iterator moved = first + steps[s];
+			check(moved == (steps[s] < items.size() ? tree.select(steps[s]) : tree.end()), "operator+ landed in the wrong place");
+			check(tree.end() + steps[s] == tree.end(), "end() + n is not end()");
+			if(steps[s] <= items.size())
+			{
+				check(distance(first, moved) == (ptrdiff_t)steps[s], "distance() from begin() miscounted");
+				check(distance(moved, tree.end()) == (ptrdiff_t)(items.size() - steps[s]), "distance() to end() miscounted");
+			}
+		}
+	}
+}
+
+// The key at it, or -1 for end().
+template<typename Tree>
+int keyAt(const Tree& tree, typename Tree::const_iterator it)
+{
+	return it == tree.end() ? -1 : it->first;
+}
+
+// The ordered lookups on a tree of 10, 20, ... 100 and on an empty tree, probing every key from below the
+// smallest to above the largest, hits and gaps alike, against the same lookups on a std::map.
+template<typename Tree>
+void testBounds()
+{
+	for(int count = 0; count <= 10; count += 10)
+	{
+		Tree tree;
+		map<int,int> items;
+		for(int i = 1; i <= count; ++i)
+		{
+			tree.insert(std::pair<int,int>(i * 10, i));
+			items[i * 10] = i;
+		}
+		const Tree& view = tree;
+		for(int key = 0; key <= 110; ++key)
+		{
+			map<int,int>::iterator lower = items.lower_bound(key);
+			map<int,int>::iterator upper = items.upper_bound(key);
+			int lowerKey = lower == items.end() ? -1 : lower->first;
+			int upperKey = upper == items.end() ? -1 : upper->first;
+			int floorKey = upper == items.begin() ? -1 : prev(upper)->first;
+			check(keyAt(view, view.lower_bound(key)) == lowerKey, "lower_bound() found the wrong key");
+			check(keyAt(view, view.upper_bound(key)) == upperKey, "upper_bound() found the wrong key");
+			check(keyAt(view, view.ceiling(key)) == lowerKey, "ceiling() found the wrong key");
+			check(keyAt(view, view.floor(key)) == floorKey, "floor() found the wrong key");
+			std::pair<typename Tree::const_iterator, typename Tree::const_iterator> range = view.equal_range(key);
+			check(keyAt(view, range.first) == lowerKey && keyAt(view, range.second) == upperKey, "equal_range() found the wrong keys");
+			check(keyAt(view, tree.lower_bound(key)) == lowerKey && keyAt(view, tree.floor(key)) == floorKey, "the mutable lookups disagree with the const ones");
+			for(int high = 0; high <= 110; high += 5)
+			{
+				size_t expected = key < high ? (size_t)distance(items.lower_bound(key), items.lower_bound(high)) : 0;
+				check(view.count_range(key, high) == expected, "count_range() miscounted");
+			}
+		}
+	}
+}
+
+// aggregate() over random windows after interleaved inserts, overwrites and removes, against a brute force
+// pass over a std::map, so that rotations and the path upkeep of the aggregates both get checked.
+static void testAggregates()
+{
+	mt19937 rng(11);
+	AggregateAVLTree<int,int,SumOfValues<long long> > sums;
+	AggregateAVLTree<int,int,MinOfValues<int> > minimums;
+	map<int,int> items;
+	for(int round = 0; round < 20000; ++round)
+	{
+		int key = (int)(rng() % 2000);
+		int value = (int)(rng() % 1000) - 500;
+		if(rng() % 3 == 0)
+		{
+			sums.remove(key);
+			minimums.remove(key);
+			items.erase(key);
+		}
+		else
+		{
+			sums.insert(std::pair<int,int>(key, value));
+			minimums.insert(std::pair<int,int>(key, value));
+			items[key] = value;
+		}
+		if(round % 50 != 0)
+		{
+			continue;
+		}
+		for(int window = 0; window < 20; ++window)
+		{
+			int low = (int)(rng() % 2100) - 50;
+			int high = low + (int)(rng() % 600) - 100;
+			long long sum = 0;
+			int minimum = numeric_limits<int>::max();
+			for(map<int,int>::iterator it = items.lower_bound(low); it != items.end() && it->first < high; ++it)
+			{
+				sum += it->second;
+				minimum = min(minimum, it->second);
+			}
+			check(sums.aggregate(low, high) == sum, "aggregate() got the wrong sum");
+			check(minimums.aggregate(low, high) == minimum, "aggregate() got the wrong minimum");
+		}
+	}
+	check(sums.isBalanced() && sameItems(sums, items), "the aggregate tree has the wrong contents");
+}
+
+// A value that counts its live copies, to tell whether every node holding one has been freed.
+struct CountedValue
+{
+	CountedValue(int v = 0) : value(v) {++live;}
+	CountedValue(const CountedValue& other) : value(other.value) {++live;}
+	CountedValue& operator=(const CountedValue& other) {value = other.value; return *this;}
+	~CountedValue() {--live;}
+
+	int value;
+	static long live;
+};
+
+long CountedValue::live = 0;
+
+// Whether a persistent view holds exactly the items of expected, by walking it and by looking each one up.
+static bool sameVersion(const PersistentAVLView<int,CountedValue>& view, const map<int,int>& expected)
+{
+	if(view.size() != expected.size())
+	{
+		return false;
+	}
+	PersistentAVLView<int,CountedValue>::iterator it = view.begin();
+	for(map<int,int>::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+	{
+		if(it == view.end() || it->first != e->first || it->second.value != e->second)
+		{
+			return false;
+		}
+		PersistentAVLView<int,CountedValue>::iterator found = view.find(e->first);
+		if(found == view.end() || found->second.value != e->second)
+		{
+			return false;
+		}
+	}
+	return it == view.end();
+}
+
+// Snapshots of a persistent tree keep their contents through later updates, and once the tree and every
+// snapshot are gone, dropped in random order, no node is left.
+static void testSnapshots()
+{
+	mt19937 rng(12);
+	{
+		PersistentAVLTree<int,CountedValue> tree;
+		map<int,int> items;
+		vector<PersistentAVLView<int,CountedValue> > snapshots;
+		vector<map<int,int> > snapshotItems;
+		snapshots.push_back(tree.snapshot());
+		snapshotItems.push_back(items);
+		for(int round = 0; round < 6000; ++round)
+		{
+			int key = (int)(rng() % 500);
+			if(rng() % 3 == 0)
+			{
+				tree.remove(key);
+				items.erase(key);
+			}
+			else
+			{
+				tree.insert(std::pair<int,CountedValue>(key, CountedValue(round)));
+				items[key] = round;
+			}
+			if(round % 200 == 0)
+			{
+				snapshots.push_back(tree.snapshot());
+				snapshotItems.push_back(items);
+			}
+			if(round == 3000)
+			{
+				tree.clear();
+				items.clear();
+			}
+		}
+		check(sameVersion(tree, items), "the persistent tree has the wrong contents");
+		for(size_t i = 0; i < snapshots.size(); ++i)
+		{
+			check(sameVersion(snapshots[i], snapshotItems[i]), "a snapshot changed after later updates");
+		}
+		//drop the tree's own version in the middle of dropping snapshots
+		while(!snapshots.empty())
+		{
+			size_t i = rng() % snapshots.size();
+			snapshots.erase(snapshots.begin() + i);
+			snapshotItems.erase(snapshotItems.begin() + i);
+			if(snapshots.size() == 10)
+			{
+				tree.clear();
+			}
+			for(size_t j = 0; j < snapshots.size(); j += 7)
+			{
+				check(sameVersion(snapshots[j], snapshotItems[j]), "dropping a snapshot changed another one");
+			}
+		}
+	}
+	check(CountedValue::live == 0, "nodes were left over after every version was dropped");
+}
+
+// A frozen copy against the tree it came from, for sizes around powers of two where the Eytzinger layout
+// ends in a partly filled level: iteration, and find, contains and lower_bound on every key and every gap.
+template<typename Compare>
+void testFreeze()
+{
+	vector<size_t> sizes;
+	sizes.push_back(0);
+	sizes.push_back(1);
+	for(size_t power = 2; power <= 1024; power *= 2)
+	{
+		sizes.push_back(power - 1);
+		sizes.push_back(power);
+		sizes.push_back(power + 1);
+	}
+	for(size_t s = 0; s < sizes.size(); ++s)
+	{
+		AVLTree<int,int,SlabNodeAllocator,AVLNode<int,int>,Compare> tree;
+		for(size_t i = 0; i < sizes[s]; ++i)
+		{
+			tree.insert(std::pair<int,int>((int)i * 2, (int)i));
+		}
+		FrozenAVLTree<int,int,Compare> frozen = tree.freeze();
+		check(frozen.size() == sizes[s] && frozen.empty() == (sizes[s] == 0), "a frozen copy has the wrong size");
+		typename FrozenAVLTree<int,int,Compare>::iterator it = frozen.begin();
+		for(typename AVLTree<int,int,SlabNodeAllocator,AVLNode<int,int>,Compare>::iterator source = tree.begin(); source != tree.end(); ++source, ++it)
+		{
+			check(it != frozen.end() && *it == *source, "a frozen copy iterates differently from its tree");
+		}
+		check(it == frozen.end(), "a frozen copy iterates past its tree");
+		for(int key = -1; key <= (int)sizes[s] * 2; ++key)
+		{
+			bool present = tree.find(key) != tree.end();
+			check(frozen.contains(key) == present, "contains() differs from the tree");
+			check(present ? frozen.find(key) != frozen.end() && frozen.find(key)->second == tree.find(key)->second
+				: frozen.find(key) == frozen.end(), "find() differs from the tree");
+			bool bounded = tree.lower_bound(key) != tree.end();
+			check(bounded ? frozen.lower_bound(key) != frozen.end() && frozen.lower_bound(key)->first == tree.lower_bound(key)->first
+				: frozen.lower_bound(key) == frozen.end(), "lower_bound() differs from the tree");
+		}
+	}
+}
+
+// BPlusTree against a std::map through random inserts, overwrites and removes, first mostly growing and
+// then mostly shrinking and finally drained, so that nodes split, borrow from siblings and merge.
+template<size_t MaxKeys>
+void testBPlusTree()
+{
+	mt19937 rng(18 + MaxKeys);
+	BPlusTree<int,int,MaxKeys> tree;
+	map<int,int> items;
+	for(int round = 0; round < 40000; ++round)
+	{
+		int key = (int)(rng() % 5000);
+		bool growing = round < 20000;
+		if(rng() % 4 < (growing ? 1u : 3u))
+		{
+			tree.remove(key);
+			items.erase(key);
+		}
+		else
+		{
+			tree.insert(std::pair<int,int>(key, round));
+			items[key] = round;
+		}
+		if(round % 500 != 0 && round != 39999)
+		{
+			continue;
+		}
+		check(tree.size() == items.size() && tree.empty() == items.empty(), "BPlusTree size() disagrees with the contents");
+		check(tree.isBalanced(), "BPlusTree is not a valid B+ tree");
+		typename BPlusTree<int,int,MaxKeys>::iterator it = tree.begin();
+		for(map<int,int>::iterator e = items.begin(); e != items.end(); ++e, ++it)
+		{
+			check(it != tree.end() && it->first == e->first && it->second == e->second, "BPlusTree iterates the wrong items");
+		}
+		check(it == tree.end(), "BPlusTree iterates past its items");
+		for(int probe = -1; probe <= 5000; probe += 1 + (int)(rng() % 20))
+		{
+			map<int,int>::iterator lower = items.lower_bound(probe);
+			typename BPlusTree<int,int,MaxKeys>::iterator found = tree.find(probe);
+			typename BPlusTree<int,int,MaxKeys>::iterator bound = tree.lower_bound(probe);
+			bool present = lower != items.end() && lower->first == probe;
+			check(present ? found != tree.end() && found->second == lower->second : found == tree.end(), "BPlusTree find() is wrong");
+			check(lower == items.end() ? bound == tree.end() : bound != tree.end() && bound->first == lower->first, "BPlusTree lower_bound() is wrong");
+		}
+	}
+	//drain what is left in random order, down to an empty root leaf
+	vector<int> left;
+	for(map<int,int>::iterator e = items.begin(); e != items.end(); ++e)
+	{
+		left.push_back(e->first);
+	}
+	shuffle(left.begin(), left.end(), rng);
+	for(size_t i = 0; i < left.size(); ++i)
+	{
+		tree.remove(left[i]);
+		check(i % 100 != 0 || tree.isBalanced(), "BPlusTree is not a valid B+ tree while draining");
+	}
+	check(tree.empty() && tree.begin() == tree.end() && tree.isBalanced(), "BPlusTree is not empty after removing every key");
+	tree.insert(std::pair<int,int>(1, 1));
+	tree.clear();
+	check(tree.empty() && tree.begin() == tree.end() && tree.isBalanced(), "BPlusTree is not empty after clear()");
+}
+
+// A threaded tree that can also be walked the slow way, through child and parent links.
+class ThreadWalkTree : public ThreadedAVLTree<int,int>
+{
+public:
+	// Keys in order found by climbing parent links, as an unthreaded iterator steps.
+	vector<int> parentWalk(bool forward) const
+	{
+		vector<int> keys;
+		AVLNode<int,int,ThreadedLinks<> >* node = mRoot;
+		while(node != NULL && (forward ? node->getLeft() : node->getRight()) != NULL)
+		{
+			node = forward ? node->getLeft() : node->getRight();
+		}
+		while(node != NULL)
+		{
+			keys.push_back(node->getKey());
+			AVLNode<int,int,ThreadedLinks<> >* next = forward ? node->getRight() : node->getLeft();
+			if(next != NULL)
+			{
+				while((forward ? next->getLeft() : next->getRight()) != NULL)
+				{
+					next = forward ? next->getLeft() : next->getRight();
+				}
+				node = next;
+				continue;
+			}
+			AVLNode<int,int,ThreadedLinks<> >* parent = node->getParent();
+			while(parent != NULL && node == (forward ? parent->getRight() : parent->getLeft()))
+			{
+				node = parent;
+				parent = parent->getParent();
+			}
+			node = parent;
+		}
+		return keys;
+	}
+};
+
+// Walks a threaded tree both ways over the threads and checks the walks against the parent link walks.
+static void checkThreads(const ThreadWalkTree& tree)
+{
+	vector<int> forward;
+	for(ThreadWalkTree::const_iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		forward.push_back(it->first);
+	}
+	vector<int> backward;
+	ThreadWalkTree::const_iterator it = tree.end();
+	while(it != tree.begin())
+	{
+		--it;
+		backward.push_back(it->first);
+	}
+	check(forward == tree.parentWalk(true), "the forward threads disagree with the parent links");
+	check(backward == tree.parentWalk(false), "the backward threads disagree with the parent links");
+	check(tree.isBalanced(), "a threaded tree is unbalanced");
+}
+
+// Threaded trees through every kind of update that relinks nodes: inserts and removes with their
+// rotations, batches, bulk loads, split, join and the set operations.
+static void testThreads()
+{
+	mt19937 rng(19);
+	ThreadWalkTree tree;
+	for(int round = 0; round < 3000; ++round)
+	{
+		int key = (int)(rng() % 2000);
+		unsigned operation = rng() % 20;
+		if(operation < 8)
+		{
+			tree.insert(std::pair<int,int>(key, round));
+		}
+		else if(operation < 15)
+		{
+			tree.remove(key);
+		}
+		else if(operation == 15)
+		{
+			vector<std::pair<int,int> > batch;
+			for(int i = 0; i < 40; ++i)
+			{
+				batch.push_back(std::pair<int,int>((int)(rng() % 2000), i));
+			}
+			tree.insert_batch(batch.data(), batch.size());
+		}
+		else if(operation == 16)
+		{
+			ThreadWalkTree greater;
+			tree.split(key, greater);
+			checkThreads(tree);
+			checkThreads(greater);
+			tree.join(tree, std::pair<int,int>(key, round), greater);
+		}
+		else if(operation == 17)
+		{
+			ThreadWalkTree other;
+			for(int i = 0; i < 50; ++i)
+			{
+				other.insert(std::pair<int,int>((int)(rng() % 2000), i));
+			}
+			if(rng() % 3 == 0)
+			{
+				tree.union_with(other);
+			}
+			else if(rng() % 2 == 0)
+			{
+				tree.intersect_with(other);
+				tree.union_with(other);
+			}
+			else
+			{
+				tree.difference_with(other);
+			}
+		}
+		else if(operation == 18 && rng() % 10 == 0)
+		{
+			vector<std::pair<int,int> > items;
+			for(int i = 0; i < 300; ++i)
+			{
+				items.push_back(std::pair<int,int>(i * 5, i));
+			}
+			tree.assign_sorted(items.begin(), items.end());
+		}
+		else if(operation == 19)
+		{
+			ThreadWalkTree::Finger finger = tree.finger();
+			finger.insert(std::pair<int,int>(key, round));
+			finger.remove(key + 1);
+		}
+		if(round % 10 == 0)
+		{
+			checkThreads(tree);
+		}
+	}
+	checkThreads(tree);
+}
+
+// Iteration in both directions against a std::map: reverse iterators, stepping back from end(), postfix
+// steps, writing through an iterator, and iterators converting to and comparing with const_iterators.
+template<typename Tree>
+void testIterators()
+{
+	static_assert(is_convertible<typename Tree::iterator, typename Tree::const_iterator>::value, "iterator has to convert to const_iterator");
+	static_assert(!is_convertible<typename Tree::const_iterator, typename Tree::iterator>::value, "const_iterator must not convert to iterator");
+	mt19937 rng(20);
+	Tree tree;
+	const Tree& view = tree;
+	map<int,int> items;
+	check(tree.begin() == tree.end() && tree.rbegin() == tree.rend(), "an empty tree has items to iterate");
+	for(int round = 0; round < 2000; ++round)
+	{
+		int key = (int)(rng() % 300);
+		if(rng() % 3 == 0)
+		{
+			tree.remove(key);
+			items.erase(key);
+		}
+		else
+		{
+			tree.insert(std::pair<int,int>(key, round));
+			items[key] = round;
+		}
+		if(round % 50 != 0 || items.empty())
+		{
+			continue;
+		}
+		typename Tree::iterator last = tree.end();
+		--last;
+		check(last->first == items.rbegin()->first, "--end() is not the largest item");
+		typename Tree::const_iterator constLast = view.end();
+		check((constLast--) == view.end() && constLast == last && last == constLast, "postfix -- or mixed comparison is wrong");
+		typename Tree::const_iterator converted = last;
+		check(converted == last && !(converted != last) && converted->first == last->first, "an iterator converted to a const_iterator moved");
+
+		map<int,int>::reverse_iterator expected = items.rbegin();
+		typename Tree::reverse_iterator it = tree.rbegin();
+		for(; expected != items.rend(); ++expected, ++it)
+		{
+			check(it != tree.rend() && it->first == expected->first && it->second == expected->second, "reverse iteration gave the wrong item");
+		}
+		check(it == tree.rend(), "reverse iteration ran past the smallest item");
+		size_t count = 0;
+		for(typename Tree::const_reverse_iterator c = view.crbegin(); c != view.crend(); ++c)
+		{
+			++count;
+		}
+		check(count == items.size(), "const reverse iteration miscounted");
+
+		//step back from end() all the way to begin() with postfix --, then forward again with postfix ++
+		typename Tree::iterator walker = tree.end();
+		for(map<int,int>::reverse_iterator e = items.rbegin(); e != items.rend(); ++e)
+		{
+			walker--;
+			check(walker->first == e->first, "stepping back from end() gave the wrong item");
+		}
+		check(walker == tree.begin(), "stepping back from end() did not reach begin()");
+		for(map<int,int>::iterator e = items.begin(); e != items.end(); ++e)
+		{
+			check((walker++)->first == e->first, "postfix ++ gave the wrong item");
+		}
+		check(walker == tree.end(), "stepping forward did not reach end()");
+	}
+	for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		it->second = -it->first;
+		items[it->first] = -it->first;
+	}
+	check(sameItems(tree, items), "writing through an iterator did not stick");
+}
+
+// Key types and comparisons that take each way through compareWith (see key_compare.h).
+
+// A key with a three way compare() member and operator<, like std::string.
+struct Version
+{
+	int major;
+	int minor;
+
+	int compare(const Version& other) const
+	{
+		return major != other.major ? (major < other.major ? -1 : 1) : (minor < other.minor ? -1 : (minor > other.minor ? 1 : 0));
+	}
+	bool operator<(const Version& other) const {return compare(other) < 0;}
+};
+
+// A three way comparison function object that orders ints from largest to smallest.
+struct DescendingThreeWay
+{
+	int operator()(int a, int b) const {return (b > a) - (b < a);}
+};
+
+#if __cplusplus >= 202002L
+// A key that only compares through a defaulted operator<=>.
+struct Spaceship
+{
+	int value;
+	auto operator<=>(const Spaceship&) const = default;
+};
+#endif
+
+// A tree and a std::map ordered the same way, through random inserts and removes, checking iteration,
+// find, lower_bound and balance. makeKey turns an int into a key, in a way that keeps its order.
+template<typename Tree, typename Map, typename MakeKey>
+void testOrdering(MakeKey makeKey)
+{
+	mt19937 rng(21);
+	Tree tree;
+	Map items;
+	for(int round = 0; round < 4000; ++round)
+	{
+		int raw = (int)(rng() % 1000);
+		if(rng() % 3 == 0)
+		{
+			tree.remove(makeKey(raw));
+			items.erase(makeKey(raw));
+		}
+		else
+		{
+			tree.insert(std::pair<typename Map::key_type, int>(makeKey(raw), round));
+			items[makeKey(raw)] = round;
+		}
+		if(round % 200 != 0)
+		{
+			continue;
+		}
+		typename Tree::const_iterator it = tree.begin();
+		bool same = true;
+		for(typename Map::iterator e = items.begin(); e != items.end(); ++e, ++it)
+		{
+			same = same && it != tree.end() && !items.key_comp()(it->first, e->first) && !items.key_comp()(e->first, it->first) && it->second == e->second;
+		}
+		check(same && it == tree.end(), "a tree with a custom order iterates in the wrong order");
+		for(int probe = 0; probe < 1000; probe += 7)
+		{
+			typename Map::iterator expected = items.lower_bound(makeKey(probe));
+			typename Tree::iterator bound = tree.lower_bound(makeKey(probe));
+			check(expected == items.end() ? bound == tree.end() : bound != tree.end() && bound->second == expected->second, "lower_bound() under a custom order is wrong");
+			check((tree.find(makeKey(probe)) != tree.end()) == (items.count(makeKey(probe)) != 0), "find() under a custom order is wrong");
+		}
+		check(tree.isBalanced(), "a tree with a custom order is unbalanced");
+	}
+}
+
+static int sameInt(int raw)
+{
+	return raw;
+}
+
+static Version versionOf(int raw)
+{
+	Version version = {raw / 10, raw % 10};
+	return version;
+}
+
+static string paddedString(int raw)
+{
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "key%05d", raw);
+	return buffer;
+}
+
+#if __cplusplus >= 202002L
+static Spaceship spaceshipOf(int raw)
+{
+	return Spaceship{raw};
+}
+#endif
+
+static void testCompare()
+{
+	static_assert(IsThreeWayCompare<DescendingThreeWay, int>::value && !IsThreeWayCompare<greater<int>, int>::value, "the comparisons are not the kinds meant");
+	static_assert(KeyHasCompareMember<Version>::value && IsStdLess<less<Version>, Version>::value, "Version has to take the compare() member way");
+	//std::less on ints: one comparison the compiler branches on
+	testOrdering<AVLTree<int,int>, map<int,int> >(sameInt);
+	//a three way function object
+	testOrdering<AVLTree<int,int,SlabNodeAllocator,AVLNode<int,int>,DescendingThreeWay>, map<int,int,greater<int> > >(sameInt);
+	//a bool order other than std::less, called twice when it has to tell equal from greater
+	testOrdering<AVLTree<int,int,SlabNodeAllocator,AVLNode<int,int>,greater<int> >, map<int,int,greater<int> > >(sameInt);
+	//std::less on keys with a compare() member
+	testOrdering<AVLTree<Version,int,SlabNodeAllocator,AVLNode<Version,int> >, map<Version,int> >(versionOf);
+	testOrdering<AVLTree<string,int,SlabNodeAllocator,AVLNode<string,int> >, map<string,int> >(paddedString);
+	testOrdering<IndexedAVLTree<string,int,greater<string> >, map<string,int,greater<string> > >(paddedString);
+#if __cplusplus >= 202002L
+	//std::less on keys that compare with <=>
+	testOrdering<AVLTree<Spaceship,int,SlabNodeAllocator,AVLNode<Spaceship,int> >, map<Spaceship,int> >(spaceshipOf);
+#endif
+	AVLTree<int,int,SlabNodeAllocator,AVLNode<int,int>,greater<int> > descending;
+	check(descending.key_comp()(2, 1), "key_comp() is not the tree's Compare");
+}
+
+// A string key that counts how many times one is built, to show that heterogeneous lookups build none.
+struct Name
+{
+	explicit Name(const string& text) : mText(text) {++built;}
+	Name(const Name& other) : mText(other.mText) {++built;}
+	Name& operator=(const Name& other) {mText = other.mText; return *this;}
+
+	string mText;
+	static long built;
+};
+
+long Name::built = 0;
+
+// A transparent bool order between Names and string_views.
+struct NameLess
+{
+	typedef void is_transparent;
+	bool operator()(const Name& a, const Name& b) const {return a.mText < b.mText;}
+	bool operator()(const Name& a, string_view b) const {return a.mText < b;}
+	bool operator()(string_view a, const Name& b) const {return a < b.mText;}
+};
+
+// find, lower_bound and remove with keys of another type under a transparent Compare: std::less<> over
+// std::string keys searched with string_views, which compare through the key's compare() member, and with
+// C strings, which only compare through the key's compare() with the sides swapped.
+static void testHeterogeneous()
+{
+	typedef AVLTree<string,int,SlabNodeAllocator,AVLNode<string,int>,less<> > Tree;
+	Tree tree;
+	map<string,int> items;
+	for(int i = 0; i < 500; i += 2)
+	{
+		tree.insert(std::pair<string,int>(paddedString(i), i));
+		items[paddedString(i)] = i;
+	}
+	const Tree& view = tree;
+	for(int i = -1; i <= 501; ++i)
+	{
+		string key = paddedString(i);
+		string_view keyView(key);
+		const char* keyChars = key.c_str();
+		map<string,int>::iterator expected = items.lower_bound(key);
+		bool present = expected != items.end() && expected->first == key;
+		check((tree.find(keyView) != tree.end()) == present && (view.find(keyChars) != view.end()) == present, "a heterogeneous find() is wrong");
+		check(!present || (tree.find(keyView)->second == i && view.find(keyChars)->second == i), "a heterogeneous find() found the wrong item");
+		Tree::const_iterator bound = view.lower_bound(keyView);
+		Tree::iterator charBound = tree.lower_bound(keyChars);
+		check(expected == items.end() ? bound == view.end() && charBound == tree.end()
+			: bound != view.end() && bound->first == expected->first && charBound == bound, "a heterogeneous lower_bound() is wrong");
+	}
+	for(int i = 0; i < 500; i += 3)
+	{
+		string key = paddedString(i);
+		if(i % 2 == 0)
+		{
+			tree.remove(string_view(key));
+		}
+		else
+		{
+			tree.remove(key.c_str());
+		}
+		items.erase(key);
+	}
+	check(sameItems(tree, items) && tree.isBalanced(), "heterogeneous remove() left the wrong contents");
+
+	AVLTree<Name,int,SlabNodeAllocator,AVLNode<Name,int>,NameLess> names;
+	for(int i = 0; i < 100; ++i)
+	{
+		names.insert(std::pair<Name,int>(Name(paddedString(i)), i));
+	}
+	string wanted = paddedString(42);
+	string gone = paddedString(7);
+	long before = Name::built;
+	bool found = names.find(string_view(wanted)) != names.end() && names.lower_bound(string_view(wanted))->second == 42;
+	names.remove(string_view(gone));
+	check(found && names.find(string_view(gone)) == names.end(), "lookups of Names by string_view are wrong");
+	check(Name::built == before, "a heterogeneous lookup built a key");
+}
+
+// A value that counts its copies and moves. A moved from value reads -1.
+struct MoveCounter
+{
+	MoveCounter() : value(0) {}
+	explicit MoveCounter(int v) : value(v) {}
+	MoveCounter(const MoveCounter& other) : value(other.value) {++copies;}
+	MoveCounter(MoveCounter&& other) : value(other.value) {other.value = -1; ++moves;}
+	MoveCounter& operator=(const MoveCounter& other) {value = other.value; ++copies; return *this;}
+	MoveCounter& operator=(MoveCounter&& other) {value = other.value; other.value = -1; ++moves; return *this;}
+
+	int value;
+	static long copies;
+	static long moves;
+};
+
+long MoveCounter::copies = 0;
+long MoveCounter::moves = 0;
+
+// The rvalue insert, emplace, try_emplace and insert_or_assign: what they return, that they move instead
+// of copying, and that try_emplace leaves its arguments alone when the key is already there.
+template<typename Tree>
+void testEmplace()
+{
+	Tree tree;
+	MoveCounter::copies = 0;
+	std::pair<typename Tree::iterator, bool> result = tree.insert(std::pair<string,MoveCounter>("b", MoveCounter(1)));
+	check(result.second && result.first->first == "b" && result.first->second.value == 1, "rvalue insert of a new key returned the wrong result");
+	result = tree.insert(std::pair<string,MoveCounter>("b", MoveCounter(2)));
+	check(!result.second && result.first->second.value == 2, "rvalue insert of an existing key did not replace the value");
+
+	result = tree.emplace("a", MoveCounter(3));
+	check(result.second && result.first->first == "a" && result.first->second.value == 3, "emplace of a new key returned the wrong result");
+	result = tree.emplace("a", MoveCounter(4));
+	check(!result.second && result.first->second.value == 3, "emplace of an existing key replaced the value");
+
+	result = tree.try_emplace("c", 5);
+	check(result.second && result.first->first == "c" && result.first->second.value == 5, "try_emplace of a new key returned the wrong result");
+	MoveCounter kept(6);
+	string key = "c";
+	result = tree.try_emplace(std::move(key), std::move(kept));
+	check(!result.second && result.first->second.value == 5, "try_emplace of an existing key replaced the value");
+	check(kept.value == 6 && key == "c", "try_emplace consumed its arguments for an existing key");
+	result = tree.try_emplace(string("d"), std::move(kept));
+	check(result.second && result.first->second.value == 6 && kept.value == -1, "try_emplace of a new key did not move its value in");
+
+	MoveCounter replacement(7);
+	result = tree.insert_or_assign("d", std::move(replacement));
+	check(!result.second && result.first->second.value == 7 && replacement.value == -1, "insert_or_assign did not move into an existing key");
+	result = tree.insert_or_assign("e", MoveCounter(8));
+	check(result.second && result.first->first == "e" && result.first->second.value == 8, "insert_or_assign of a new key returned the wrong result");
+
+	check(MoveCounter::copies == 0, "a move-aware insert copied a value");
+	check(tree.find("d")->second.value == 7 && distance(tree.begin(), tree.end()) == 5, "move-aware inserts left the wrong contents");
+}
+
+// insert_or_assign on an existing key has to refresh the aggregates above it.
+static void testAssignAggregate()
+{
+	AggregateAVLTree<int,int,SumOfValues<long long> > sums;
+	for(int i = 0; i < 100; ++i)
+	{
+		sums.insert(std::pair<int,int>(i, 1));
+	}
+	sums.insert_or_assign(50, 101);
+	sums.insert(std::pair<int,int>(60, 11));
+	check(sums.aggregate(0, 100) == 99 + 101 + 10, "replacing a value did not update the aggregates");
+}
+
+// Whether --end() lands on the largest key of expected, or end() stays put for an empty tree.
+template<typename Tree>
+bool lastIsLargest(Tree& tree, const map<int,int>& expected)
+{
+	typename Tree::iterator last = tree.end();
+	if(expected.empty())
+	{
+		return tree.begin() == tree.end();
+	}
+	--last;
+	return last != tree.end() && last->first == expected.rbegin()->first;
+}
+
+// Hinted inserts with good, bad, end() and begin() hints, and --end() against the true largest key after every
+// kind of update, since the tree keeps its largest node on the side for appends and for end().
+template<typename Tree>
+void testHintsAndLargest()
+{
+	mt19937 rng(24);
+	Tree tree;
+	map<int,int> items;
+	for(int round = 0; round < 6000; ++round)
+	{
+		int key = (int)(rng() % 3000);
+		unsigned operation = rng() % 14;
+		if(operation < 3)
+		{
+			//appends past the largest key and prepends before the smallest, without a hint, with the end()
+			//hint or with the hint at the largest or smallest item itself
+			bool front = operation == 2;
+			int next = items.empty() ? 0 : (front ? items.begin()->first - 1 - (int)(rng() % 3) : items.rbegin()->first + 1 + (int)(rng() % 3));
+			unsigned hinted = rng() % 3;
+			if(hinted == 0)
+			{
+				tree.insert(std::pair<int,int>(next, round));
+			}
+			else
+			{
+				typename Tree::const_iterator hint = front ? tree.cbegin() : tree.cend();
+				if(hinted == 2 && !front && !items.empty())
+				{
+					--hint;
+				}
+				check(tree.insert(hint, std::pair<int,int>(next, round))->first == next, "a hinted insert at either end returned the wrong item");
+			}
+			items[next] = round;
+		}
+		else if(operation < 5)
+		{
+			//a hint at the key's neighbour, or anywhere at all
+			typename Tree::const_iterator hint = operation == 3 ? typename Tree::const_iterator(tree.lower_bound(key)) : typename Tree::const_iterator(tree.begin());
+			typename Tree::iterator placed = tree.insert(hint, std::pair<int,int>(key, round));
+			check(placed != tree.end() && placed->first == key && placed->second == round, "a hinted insert returned the wrong item");
+			items[key] = round;
+		}
+		else if(operation < 7)
+		{
+			//remove the largest key half the time
+			if(operation == 5 && !items.empty())
+			{
+				key = items.rbegin()->first;
+			}
+			tree.remove(key);
+			items.erase(key);
+		}
+		else if(operation == 7)
+		{
+			Tree greater;
+			tree.split(key, greater);
+			map<int,int> greaterItems(items.upper_bound(key), items.end());
+			items.erase(items.lower_bound(key), items.end());
+			check(lastIsLargest(tree, items) && lastIsLargest(greater, greaterItems), "--end() is wrong after split");
+			Tree joined;
+			joined.join(tree, std::pair<int,int>(key, round), greater);
+			items[key] = round;
+			items.insert(greaterItems.begin(), greaterItems.end());
+			check(lastIsLargest(joined, items) && lastIsLargest(tree, map<int,int>()), "--end() is wrong after join");
+			int below = items.begin()->first - 1;
+			tree.join(tree, std::pair<int,int>(below, round), joined);
+			items[below] = round;
+			tree.remove(below);
+			items.erase(below);
+		}
+		else if(operation == 8)
+		{
+			Tree other;
+			map<int,int> otherItems;
+			fillRandom(other, otherItems, 40, 3200, 2, rng);
+			unsigned which = rng() % 3;
+			if(which == 0)
+			{
+				tree.union_with(other);
+				items.insert(otherItems.begin(), otherItems.end());
+			}
+			else if(which == 1)
+			{
+				tree.intersect_with(other);
+				for(map<int,int>::iterator it = items.begin(); it != items.end();)
+				{
+					it = otherItems.count(it->first) ? next(it) : items.erase(it);
+				}
+			}
+			else
+			{
+				tree.difference_with(other);
+				for(map<int,int>::iterator it = otherItems.begin(); it != otherItems.end(); ++it)
+				{
+					items.erase(it->first);
+				}
+			}
+			//top the tree back up when an intersection has all but emptied it
+			if(items.size() < 10)
+			{
+				fillRandom(tree, items, 200, 3000, 1, rng);
+			}
+		}
+		else if(operation == 9)
+		{
+			vector<std::pair<int,int> > batch;
+			for(int i = 0; i < (int)(rng() % 20); ++i)
+			{
+				batch.push_back(std::pair<int,int>((int)(rng() % 3200), i));
+				items[batch.back().first] = i;
+			}
+			tree.insert_batch(batch.data(), batch.size());
+		}
+		else if(operation == 10)
+		{
+			typename Tree::Update insert = {std::pair<int,int>(key, round), false, false};
+			typename Tree::Update remove = {std::pair<int,int>(key + 5000, 0), true, false};
+			typename Tree::Update* updates[] = {&insert, &remove};
+			tree.apply_batch(updates, 2);
+			items[key] = round;
+		}
+		else if(operation == 11)
+		{
+			typename Tree::Finger finger = tree.finger();
+			finger.insert(std::pair<int,int>(key, round));
+			items[key] = round;
+			if(!items.empty() && finger.remove(items.rbegin()->first))
+			{
+				items.erase(prev(items.end()));
+			}
+		}
+		else if(operation == 12 && rng() % 20 == 0)
+		{
+			tree.clear();
+			items.clear();
+			check(lastIsLargest(tree, items), "--end() is wrong after clear");
+		}
+		else if(operation == 13 && rng() % 20 == 0)
+		{
+			vector<std::pair<int,int> > sorted(items.begin(), items.end());
+			sorted.resize(sorted.size() / 2);
+			tree.assign_sorted(sorted.begin(), sorted.end());
+			items = map<int,int>(sorted.begin(), sorted.end());
+		}
+		check(lastIsLargest(tree, items), "--end() is not the largest key after an update");
+		if(round % 100 == 0)
+		{
+			check(sameItems(tree, items) && tree.isBalanced(), "hinted inserts and appends left the wrong contents");
+		}
+	}
+}
+
+// A finger wandering back and forth through a tree, mostly by small steps and sometimes by long jumps,
+// inserting, seeking and removing where it is, including its own key. It has to stay usable throughout,
+// land on the key or a neighbour of it, and keep the tree in step with a std::map.
+template<typename Tree>
+void testFinger()
+{
+	mt19937 rng(25);
+	Tree tree;
+	map<int,int> items;
+	typename Tree::Finger finger = tree.finger();
+	check(!finger.seek(5) && finger.position() == tree.end() && !finger.remove(5), "a finger on an empty tree found something");
+	int key = 1500;
+	for(int round = 0; round < 20000; ++round)
+	{
+		key = rng() % 8 == 0 ? (int)(rng() % 3000) : key + (int)(rng() % 41) - 20;
+		unsigned operation = rng() % 6;
+		if(operation < 2)
+		{
+			std::pair<typename Tree::iterator, bool> result = finger.insert(std::pair<int,int>(key, round));
+			check(result.second == (items.count(key) == 0), "Finger::insert() did not report whether the key was new");
+			check(result.first->first == key && result.first->second == round && finger.position() == result.first, "Finger::insert() left the finger elsewhere");
+			items[key] = round;
+		}
+		else if(operation < 4)
+		{
+			bool found = finger.seek(key);
+			map<int,int>::iterator lower = items.lower_bound(key);
+			check(found == (lower != items.end() && lower->first == key), "Finger::seek() did not report whether the key is there");
+			if(found)
+			{
+				check(finger.position()->first == key, "Finger::seek() did not land on the key");
+			}
+			else if(!items.empty())
+			{
+				//on a miss the finger sits on the key's successor or predecessor
+				int at = finger.position()->first;
+				check((lower != items.end() && lower->first == at) || (lower != items.begin() && prev(lower)->first == at), "Finger::seek() stopped away from the key");
+			}
+		}
+		else if(operation == 4)
+		{
+			check(finger.remove(key) == (items.erase(key) != 0), "Finger::remove() did not report whether the key was there");
+			check(items.empty() ? finger.position() == tree.end() : finger.position() != tree.end(), "Finger::remove() left the finger nowhere");
+		}
+		else if(!items.empty())
+		{
+			//remove the key under the finger itself
+			int own = finger.position()->first;
+			check(finger.remove(own), "Finger::remove() missed the finger's own key");
+			items.erase(own);
+		}
+		if(round % 100 == 0)
+		{
+			check(sameItems(tree, items) && tree.isBalanced(), "finger updates left the wrong contents");
+		}
+	}
+	//walk all the way down seeking backwards, then drain through the finger
+	for(map<int,int>::reverse_iterator e = items.rbegin(); e != items.rend(); ++e)
+	{
+		check(finger.seek(e->first) && finger.position()->second == e->second, "seeking backwards missed a key");
+	}
+	while(!items.empty())
+	{
+		int own = finger.position()->first;
+		check(finger.remove(own), "draining through the finger missed a key");
+		items.erase(own);
+	}
+	check(tree.begin() == tree.end() && finger.position() == tree.end() && tree.isBalanced(), "draining through the finger left keys behind");
+	check(finger.insert(std::pair<int,int>(3, 3)).second && tree.find(3) != tree.end(), "a finger on an emptied tree cannot insert");
+}
+
 int main() {
 
 AVLTree<int,int>* avl = new AVLTree<int,int>;
@@ -179,8 +1523,94 @@ delete yuhyuhyuh;
 
  
 
+cout << "13: Bulk load from a sorted range" << endl;
+testBulkLoad();
+cout << endl;
+
+cout << "14: Batch inserts" << endl;
+testInsertBatch();
+cout << endl;
+
+cout << "15: Set operations, split and join" << endl;
+testSetOperations<AVLTree<int,int> >();
+testSetOperations<AVLTree<int,int,HeapNodeAllocator> >();
+testSplitJoin<AVLTree<int,int> >();
+testSplitJoin<AVLTree<int,int,HeapNodeAllocator> >();
+cout << endl;
+
+cout << "16: Order statistics" << endl;
+testOrderStatistics();
+cout << endl;
+
+cout << "17: Ordered lookups" << endl;
+testBounds<AVLTree<int,int> >();
+testBounds<OrderStatisticAVLTree<int,int> >();
+cout << endl;
+
+cout << "18: Range aggregates" << endl;
+testAggregates();
+cout << endl;
+
+cout << "19: Persistent snapshots" << endl;
+testSnapshots();
+cout << endl;
+
+cout << "20: Frozen copies" << endl;
+testFreeze<less<int> >();
+testFreeze<greater<int> >();
+cout << endl;
+
+cout << "21: B+ tree" << endl;
+testBPlusTree<8>();
+testBPlusTree<10>();
+testBPlusTree<64>();
+cout << endl;
+
+cout << "22: Threaded trees" << endl;
+testThreads();
+cout << endl;
+
+cout << "23: Iterators in both directions" << endl;
+testIterators<BinarySearchTree<int,int> >();
+testIterators<AVLTree<int,int> >();
+testIterators<IndexedAVLTree<int,int> >();
+testIterators<OrderStatisticAVLTree<int,int> >();
+testIterators<ThreadedAVLTree<int,int> >();
+cout << endl;
+
+cout << "24: Key orders" << endl;
+testCompare();
+cout << endl;
+
+cout << "25: Heterogeneous lookups" << endl;
+testHeterogeneous();
+cout << endl;
+
+cout << "26: Move-aware inserts" << endl;
+testEmplace<BinarySearchTree<string,MoveCounter> >();
+testEmplace<AVLTree<string,MoveCounter> >();
+testEmplace<OrderStatisticAVLTree<string,MoveCounter> >();
+testAssignAggregate();
+cout << endl;
+
+cout << "27: Hinted inserts and the largest key" << endl;
+testHintsAndLargest<AVLTree<int,int> >();
+testHintsAndLargest<ThreadedAVLTree<int,int> >();
+testHintsAndLargest<OrderStatisticAVLTree<int,int> >();
+cout << endl;
+
+cout << "28: Fingers" << endl;
+testFinger<AVLTree<int,int> >();
+testFinger<IndexedAVLTree<int,int> >();
+testFinger<ThreadedAVLTree<int,int> >();
+testFinger<OrderStatisticAVLTree<int,int> >();
+cout << endl;
+
+cout << (failed ? "Some checks FAILED" : "All checks passed") << endl;
+cout << endl;
+
 cout << "Test Cases made by John Tanner and Asheesh Chopra" << endl;
 cout << "Good luck everyone, and remember that AVL trees DO NOT define who you are" << endl;
 
-return 0;
+return failed ? 1 : 0;
 }
\ No newline at end of file
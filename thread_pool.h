@@ -0,0 +1,189 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* A small fork-join pool for divide and conquer algorithms. fork() runs two calls that may execute at the
+* same time and returns once both are done. One of them is queued for the workers and the other runs on the
+* calling thread, which then helps with queued work instead of blocking, so forks can nest to any depth
+* without tying up threads that wait on each other. With no worker threads fork() simply runs both calls.
+*/
+class TaskPool
+{
+public:
+	static TaskPool& instance();
+
+	explicit TaskPool(unsigned workers);
+	~TaskPool();
+
+	template<typename Left, typename Right>
+	void fork(Left left, Right right);
+	unsigned workers() const;
+
+private:
+	TaskPool(const TaskPool&);
+	TaskPool& operator=(const TaskPool&);
+
+	bool runPending();
+	void workerLoop();
+
+	std::mutex mLock;
+	std::condition_variable mWake;
+	std::deque<std::function<void()> > mTasks;
+	std::vector<std::thread> mThreads;
+	bool mStopping;
+};
+
+/*
+	------------------------------------------
+	Begin implementations for the TaskPool class.
+	------------------------------------------
+*/
+
+/**
+* The shared pool, with one worker per hardware thread besides the caller, created on first use.
+*/
+inline TaskPool& TaskPool::instance()
+{
+	static TaskPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+	return pool;
+}
+
+inline TaskPool::TaskPool(unsigned workers)
+	: mStopping(false)
+{
+	for(unsigned i = 0; i < workers; ++i)
+	{
+		mThreads.push_back(std::thread(&TaskPool::workerLoop, this));
+	}
+}
+
+inline TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mStopping = true;
+	}
+	mWake.notify_all();
+	for(std::size_t i = 0; i < mThreads.size(); ++i)
+	{
+		mThreads[i].join();
+	}
+}
+
+inline unsigned TaskPool::workers() const
+{
+	return (unsigned)mThreads.size();
+}
+
+/**
+* Queues right, runs left here, then runs queued tasks until right has finished. An exception thrown by
+* either call is rethrown once both are done.
+*/
+template<typename Left, typename Right>
+void TaskPool::fork(Left left, Right right)
+{
+	if(mThreads.empty())
+	{
+		left();
+		right();
+		return;
+	}
+	std::atomic<bool> done(false);
+	std::exception_ptr rightError;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		mTasks.push_back([&right, &done, &rightError]() {
+			try
+			{
+				right();
+			}
+			catch(...)
+			{
+				rightError = std::current_exception();
+			}
+			done.store(true, std::memory_order_release);
+		});
+	}
+	mWake.notify_one();
+	std::exception_ptr leftError;
+	try
+	{
+		left();
+	}
+	catch(...)
+	{
+		leftError = std::current_exception();
+	}
+	while(!done.load(std::memory_order_acquire))
+	{
+		if(!runPending())
+		{
+			std::this_thread::yield();
+		}
+	}
+	if(leftError)
+	{
+		std::rethrow_exception(leftError);
+	}
+	if(rightError)
+	{
+		std::rethrow_exception(rightError);
+	}
+}
+
+/**
+* Runs the most recently queued task, if there is one. Newest first keeps a waiting thread on the
+* subproblems closest to the one it is waiting for.
+*/
+inline bool TaskPool::runPending()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> guard(mLock);
+		if(mTasks.empty())
+		{
+			return false;
+		}
+		task = std::move(mTasks.back());
+		mTasks.pop_back();
+	}
+	task();
+	return true;
+}
+
+inline void TaskPool::workerLoop()
+{
+	while(true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard(mLock);
+			mWake.wait(guard, [this]() { return mStopping || !mTasks.empty(); });
+			if(mTasks.empty())
+			{
+				return;
+			}
+			//workers take the oldest task, which is the largest piece of work still queued
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		task();
+	}
+}
+
+/*
+	------------------------------------------
+	End implementations for the TaskPool class.
+	------------------------------------------
+*/
+
+#endif